@@ -18,6 +18,7 @@
 #include <map>
 #include <math.h>
 #include <set>
+#include <sys/time.h>
 
 #include "GatlasAppUtil.hpp"
 
@@ -59,6 +60,166 @@ int getDeviceIndex(OCLBase& oclBase, const string& device)
     return -1;
 }
 
+bool selectDevice(OCLApp* oclApp,
+                  Journal& journal,
+                  const string& fingerprint,
+                  const bool exactDevice)
+{
+    journal.loadMemo();
+
+    if (oclApp)
+        journal.setFingerprint(DeviceFingerprint(*oclApp), !exactDevice);
+    else if (! fingerprint.empty())
+        journal.setFingerprint(DeviceFingerprint(fingerprint), !exactDevice);
+
+    // merged journal with records from several devices
+    const vector<DeviceFingerprint> devices = journal.fingerprints();
+    if (journal.fingerprint().empty() && devices.size() > 1) {
+        cerr << "error: journal has records for " << devices.size() << " devices, select one with --fingerprint" << endl;
+        for (size_t i = 0; i < devices.size(); i++)
+            cerr << "\t" << devices[i].str() << endl;
+        return false;
+    }
+
+    return true;
+}
+
+int maxWorkGroupSize(OCLApp* oclApp, Journal& journal)
+{
+    const string name = "maxWorkGroupSize";
+
+    journal.loadMemo();
+
+    if (oclApp) {
+        const size_t value = oclApp->maxWorkGroupSize();
+        journal.takeDeviceMemo(name, value);
+        return value;
+    }
+
+    return journal.memoDevice(name);
+}
+
+int localMemorySize(OCLApp* oclApp, Journal& journal)
+{
+    const string name = "localMemSize";
+
+    journal.loadMemo();
+
+    if (oclApp) {
+        const size_t value = oclApp->localMemory();
+        journal.takeDeviceMemo(name, value);
+        return value;
+    }
+
+    return journal.memoDevice(name);
+}
+
+double peakGFLOPS(OCLApp* oclApp, Journal& journal, const bool doublePrecision)
+{
+    const string name = doublePrecision ? "peakMFLOPSdouble" : "peakMFLOPSfloat";
+
+    // without the device, the device records already loaded are enough
+    if (oclApp) journal.loadMemo();
+
+    // a peak measured by bench_device is kept
+    const int memoValue = journal.memoDevice(name);
+    if (! oclApp || -1 != memoValue)
+        return -1 == memoValue ? 0 : static_cast<double>(memoValue) / 1000;
+
+    // no preferred width for double means no double support
+    const size_t width = doublePrecision
+                             ? oclApp->preferredVectorWidthDouble()
+                             : max<size_t>(1, oclApp->preferredVectorWidthFloat());
+    const size_t value = 2 * width * oclApp->maxComputeUnits() * oclApp->maxClockFrequency();
+    journal.takeDeviceMemo(name, value);
+    return static_cast<double>(value) / 1000;
+}
+
+double peakBandwidth(OCLApp* oclApp, Journal& journal)
+{
+    const string name = "peakMBPS";
+
+    // without the device, the device records already loaded are enough
+    if (oclApp) journal.loadMemo();
+
+    // measure only once for each device
+    const int memoValue = journal.memoDevice(name);
+    if (! oclApp || -1 != memoValue)
+        return -1 == memoValue ? 0 : static_cast<double>(memoValue) / 1000;
+
+    // copy between two buffers on the device, large enough to defeat caches
+    const size_t MAX_BYTES = 32 * 1024 * 1024;
+    const size_t REPEAT = 10;
+    const size_t n = min(MAX_BYTES, oclApp->maxMemAlloc() / 2) / sizeof(float);
+
+    const int src = oclApp->createBuffer<float>(n, OCLApp::READWRITE);
+    const int dst = oclApp->createBuffer<float>(n, OCLApp::READWRITE);
+    if (-1 == src || -1 == dst) {
+        if (-1 != src) oclApp->releaseBuffer(src);
+        if (-1 != dst) oclApp->releaseBuffer(dst);
+        return 0;
+    }
+
+    // first copy is not timed
+    int event = oclApp->enqueueCopyBuffer(src, dst);
+    bool rc = -1 != event && oclApp->wait(event);
+
+    struct timeval start_time, stop_time;
+    rc = rc && -1 != gettimeofday(&start_time, 0);
+    for (size_t i = 0; rc && i < REPEAT; i++) {
+        event = oclApp->enqueueCopyBuffer(src, dst);
+        rc = -1 != event;
+    }
+    rc = rc && oclApp->wait();
+    rc = rc && -1 != gettimeofday(&stop_time, 0);
+
+    oclApp->releaseBuffer(src);
+    oclApp->releaseBuffer(dst);
+
+    if (! rc) return 0;
+
+    const size_t microsecs = 1000000 * (stop_time.tv_sec - start_time.tv_sec)
+                           + stop_time.tv_usec - start_time.tv_usec;
+    if (0 == microsecs) return 0;
+
+    // every copy reads and writes the buffer
+    const size_t value = 2 * REPEAT * n * sizeof(float) / microsecs; // MB/s
+    journal.takeDeviceMemo(name, value);
+    return static_cast<double>(value) / 1000;
+}
+
+void printMissing(const Bench& bench)
+{
+    const set< vector<size_t> >& missing = bench.missing();
+
+    if (! bench.replay() || missing.empty()) return;
+
+    cout << "missing from journal: " << missing.size() << endl;
+    for (set< vector<size_t> >::const_iterator iter = missing.begin();
+         iter != missing.end();
+         iter++) {
+        const vector<size_t>& args = *iter;
+        cout << "\t";
+        for (size_t i = 0; i < args.size(); i++) {
+            cout << args[i];
+            if (i != args.size() - 1) cout << " ";
+        }
+        cout << endl;
+    }
+}
+
+KernelTraffic::KernelTraffic()
+    : flops(0),
+      bytes(0),
+      bytesLocal(0)
+{ }
+
+KernelTraffic::KernelTraffic(const KernelInterface& kernel)
+    : flops(kernel.numberFlops()),
+      bytes(kernel.bytesMoved()),
+      bytesLocal(kernel.bytesMovedLocal())
+{ }
+
 void benchInit(const vector< vector<size_t> >& pargs,
                vector<bool>& pargsOk,
                vector<size_t>& pargsTime,
@@ -83,6 +244,40 @@ void benchInit(const vector< vector<size_t> >& pargs,
     }
 }
 
+// candidates from the first on that need building are compiled together in
+// one program, returns the index after the last candidate in the batch, a
+// candidate built alone ends the batch as it replaces the batch program
+static size_t buildAhead(KernelInterface& kernel,
+                         Bench& bench,
+                         Journal* journal,
+                         const vector< vector<size_t> >& pargs,
+                         const vector<bool>& pargsOk,
+                         const size_t first)
+{
+    vector< vector<size_t> > batch;
+    vector<size_t> batchIndex;
+    size_t j = first;
+    for (; j < pargs.size() && batch.size() < bench.batchSize(); j++) {
+        if (! pargsOk[j]) continue;
+
+        // only kernels never attempted, those with records are not built
+        // and any left over from a batch that crashed the compiler are
+        // built alone after the batch
+        if (journal) {
+            const size_t memoState = journal->memoRunState(kernel, pargs[j]);
+            if (Journal::BATCH_IN_PROGRESS == memoState) break;
+            if (Journal::MISSING != memoState) continue;
+        }
+
+        batch.push_back(pargs[j]);
+        batchIndex.push_back(j);
+    }
+
+    const size_t covered = bench.buildBatch(batch);
+
+    return covered < batch.size() ? batchIndex[covered] : j;
+}
+
 size_t benchLoop(const size_t trialNumber,
                  KernelInterface& kernel,
                  Bench& bench,
@@ -98,17 +293,25 @@ size_t benchLoop(const size_t trialNumber,
                  const bool dummyRun,
                  const bool printDebug)
 {
+    OCLTraceScope trace("bench loop");
+
     const bool printStatus = bench.printStatus();
     size_t goodKernelCount = 0;
 
     bool needDummyRun = dummyRun;
+    size_t batchEnd = 0;
 
     // main loop
     for (size_t j = 0; j < pargs.size(); j++) {
         const vector<size_t>& args = pargs[j];
         if (pargsOk[j]) {
+            OCLTraceScope traceCandidate("candidate");
 
-            if (needDummyRun) {
+            // build the next batch of candidates in one program
+            if (bench.batchSize() > 1 && j >= batchEnd && !bench.replay())
+                batchEnd = buildAhead(kernel, bench, NULL, pargs, pargsOk, j);
+
+            if (needDummyRun && !bench.replay()) {
                 cout << "[dummy run] ";
                 bench.run(1, args, busTransferToDevice, busTransferFromDevice, printDebug);
                 cout << endl;
@@ -183,25 +386,43 @@ size_t benchLoop(const size_t trialNumber,
                  vector<double>& pargsAverage,
                  vector<double>& pargsVariance,
                  vector< vector<size_t> >& pargsExtraDetail,
+                 vector<KernelTraffic>& pargsTraffic,
                  const bool busTransferToDevice,
                  const bool busTransferFromDevice,
                  const bool dummyRun,
                  const bool printDebug)
 {
+    OCLTraceScope trace("bench loop");
+
     const bool printStatus = bench.printStatus();
     size_t goodKernelCount = 0;
 
     bool needDummyRun = dummyRun;
+    size_t batchEnd = 0;
 
     // main loop
     for (size_t j = 0; j < pargs.size(); j++) {
         const vector<size_t>& args = pargs[j];
         if (pargsOk[j]) {
+            OCLTraceScope traceCandidate("candidate");
+
+            // build the next batch of candidates in one program
+            if (bench.batchSize() > 1 && j >= batchEnd && !bench.replay())
+                batchEnd = buildAhead(kernel, bench, &journal, pargs, pargsOk, j);
+
+            // check memo, kernels of a batch are built but not run yet
+            size_t memoState = journal.memoRunState(kernel, args);
+            bool memoMissing = Journal::MISSING == memoState ||
+                               Journal::BATCH_IN_PROGRESS == memoState;
+
+            // identical source to a kernel already built shares its records
+            if (memoMissing && bench.alias(args)) {
+                memoState = journal.memoRunState(kernel, args);
+                memoMissing = Journal::MISSING == memoState ||
+                              Journal::BATCH_IN_PROGRESS == memoState;
+            }
 
-            // check memo
-            const size_t memoState = journal.memoRunState(kernel, args);
-
-            if (needDummyRun && Journal::MISSING == memoState) {
+            if (needDummyRun && memoMissing && !bench.replay()) {
                 cout << "[dummy run] ";
                 bench.run(1, args, busTransferToDevice, busTransferFromDevice, printDebug);
                 cout << endl;
@@ -211,7 +432,7 @@ size_t benchLoop(const size_t trialNumber,
             if (printStatus) cout << "[trial " << trialNumber << "] ";
 
             size_t microsecs;
-            if (Journal::MISSING == memoState) {
+            if (memoMissing) {
                 microsecs = bench.run(1, args, busTransferToDevice, busTransferFromDevice, printDebug);
 
             } else if (Journal::RUN_OK == memoState) {
@@ -228,6 +449,7 @@ size_t benchLoop(const size_t trialNumber,
             }
 
             const vector<size_t>& extra = pargsExtraDetail[j] = kernel.extraParamDetail();
+            pargsTraffic[j] = KernelTraffic(kernel);
 
             if (0 == microsecs) {
                 if (printStatus) {
@@ -363,13 +585,17 @@ int rankBench(const size_t nthPlace, // 0th is winner, 1st is runner up, etc
     return -1;
 }
 
-void printBench(const size_t numberTrials,
-                const vector< vector<size_t> >& pargs,
-                const vector<bool>& pargsOk,
-                const vector<size_t>& pargsTime,
-                const vector<double>& pargsAverage,
-                const vector<double>& pargsVariance,
-                const vector< vector<size_t> >& pargsExtraDetail)
+static void printResults(const size_t numberTrials,
+                         const vector<KernelTraffic>& pargsTraffic,
+                         const double peakGFLOPS,
+                         const double peakBandwidth,
+                         const vector< vector<size_t> >& pargs,
+                         const vector<bool>& pargsOk,
+                         const vector<size_t>& pargsTime,
+                         const vector<double>& pargsAverage,
+                         const vector<double>& pargsVariance,
+                         const vector< vector<size_t> >& pargsExtraDetail,
+                         const vector<TimeStats>& pargsStats)
 {
     // sort accumulated trial times, skip any parameters with errors
     map<size_t, size_t> timeToIdx;
@@ -377,6 +603,12 @@ void printBench(const size_t numberTrials,
         if (pargsOk[i])
             timeToIdx[pargsTime[i]] = i;
 
+    // compute bound above the ridge point, bandwidth bound below it
+    if (! pargsTraffic.empty() && 0 != peakGFLOPS && 0 != peakBandwidth && ! timeToIdx.empty())
+        cout << "roofline: " << peakGFLOPS << " GFLOPS"
+             << "\t" << peakBandwidth << " GB/s"
+             << "\tridge: " << (peakGFLOPS / peakBandwidth) << " flops/byte" << endl;
+
     // print results in descending order, so fastest kernels are first
     size_t count = 0;
     for (map<size_t, size_t>::const_iterator iter = timeToIdx.begin();
@@ -411,10 +643,192 @@ void printBench(const size_t numberTrials,
             cout << extra[i];
             if (i != extra.size() -1) cout << " ";
         }
-        cout << ")" << endl;
+        cout << ")";
+
+        // spread of every time in the journal for the kernel, all runs together
+        if (idx < pargsStats.size() && 0 != pargsStats[idx].count())
+            cout << "\tp50: " << pargsStats[idx].median() << " usec"
+                 << "\tp99: " << pargsStats[idx].quantile(0.99) << " usec";
+
+        if (idx < pargsTraffic.size()) {
+            const double flops = pargsTraffic[idx].flops;
+            const double bytes = pargsTraffic[idx].bytes;
+            if (0 != flops && 0 != bytes) {
+                const double intensity = flops / bytes;
+                const double bandwidth = gflops / intensity;
+                cout << "\tAI: " << intensity
+                     << "\tGB/s: " << bandwidth;
+                if (0 != pargsTraffic[idx].bytesLocal)
+                    cout << "\tlocal GB/s: " << (gflops * pargsTraffic[idx].bytesLocal / flops);
+                if (0 != peakGFLOPS && 0 != peakBandwidth) {
+                    const bool computeBound = intensity * peakBandwidth >= peakGFLOPS;
+                    cout << "\tcompute: " << (100 * gflops / peakGFLOPS) << "%"
+                         << "\tbandwidth: " << (100 * bandwidth / peakBandwidth) << "%"
+                         << "\t" << (computeBound ? "compute" : "memory") << " bound";
+                }
+            }
+        }
+
+        cout << endl;
     }
 }
 
+void printBench(const size_t numberTrials,
+                const vector< vector<size_t> >& pargs,
+                const vector<bool>& pargsOk,
+                const vector<size_t>& pargsTime,
+                const vector<double>& pargsAverage,
+                const vector<double>& pargsVariance,
+                const vector< vector<size_t> >& pargsExtraDetail)
+{
+    printResults(numberTrials,
+                 vector<KernelTraffic>(), 0, 0,
+                 pargs,
+                 pargsOk,
+                 pargsTime,
+                 pargsAverage,
+                 pargsVariance,
+                 pargsExtraDetail,
+                 vector<TimeStats>());
+}
+
+void printBench(const size_t numberTrials,
+                KernelInterface& kernel,
+                Journal& journal,
+                const vector< vector<size_t> >& pargs,
+                const vector<bool>& pargsOk,
+                const vector<size_t>& pargsTime,
+                const vector<double>& pargsAverage,
+                const vector<double>& pargsVariance,
+                const vector< vector<size_t> >& pargsExtraDetail,
+                const vector<KernelTraffic>& pargsTraffic)
+{
+    vector<TimeStats> pargsStats;
+    for (size_t i = 0; i < pargs.size(); i++)
+        pargsStats.push_back(journal.memoStats(kernel, pargs[i]));
+
+    printResults(numberTrials,
+                 pargsTraffic,
+                 peakGFLOPS(NULL, journal, sizeof(double) == kernel.elementSize()),
+                 peakBandwidth(NULL, journal),
+                 pargs,
+                 pargsOk,
+                 pargsTime,
+                 pargsAverage,
+                 pargsVariance,
+                 pargsExtraDetail,
+                 pargsStats);
+}
+
+void latencySweep(KernelInterface& kernel,
+                  Bench& bench,
+                  Journal& journal,
+                  const vector<size_t>& sizes,
+                  const vector< vector< vector<size_t> > >& pargsBySize,
+                  const size_t numberCalls,
+                  const bool busTransferToDevice,
+                  const bool busTransferFromDevice,
+                  const bool printDebug,
+                  const bool paranoidCheck)
+{
+    vector<bool> sizeOk;
+    vector< vector<size_t> > sizeArgs;
+    vector<CallLatency> sizeLatency(sizes.size());
+
+    for (size_t i = 0; i < sizes.size(); i++) {
+        const vector< vector<size_t> >& pargs = pargsBySize[i];
+
+        vector<bool> pargsOk;
+        vector<size_t> pargsTime;
+        vector<size_t> pargsFlops;
+        vector<double> pargsAverage;
+        vector<double> pargsVariance;
+        vector< vector<size_t> > pargsExtraDetail;
+        benchInit(pargs, pargsOk, pargsTime, pargsFlops, pargsAverage, pargsVariance, pargsExtraDetail);
+        vector<KernelTraffic> pargsTraffic(pargs.size());
+
+        // paranoid check memory depends on the problem size
+        if (paranoidCheck && ! pargs.empty()) {
+            kernel.setParams(pargs[0]);
+            kernel.paranoidCheck();
+        }
+
+        // one trial is enough to pick a kernel for latency
+        journal.refreshMemo();
+        benchLoop(0,
+                  kernel,
+                  bench,
+                  journal,
+                  pargs,
+                  pargsOk,
+                  pargsTime,
+                  pargsFlops,
+                  pargsAverage,
+                  pargsVariance,
+                  pargsExtraDetail,
+                  pargsTraffic,
+                  busTransferToDevice,
+                  busTransferFromDevice,
+                  true,
+                  printDebug);
+
+        const int bestIndex = rankBench(0, pargsOk, pargsAverage);
+        sizeArgs.push_back(-1 == bestIndex ? vector<size_t>() : pargs[bestIndex]);
+        sizeOk.push_back(-1 != bestIndex &&
+                         bench.latency(numberCalls, sizeArgs[i], sizeLatency[i], printDebug));
+    }
+
+    // microseconds are easier to read than nanoseconds
+    cout << "latency:\tsize\tp50\tp99\tenqueue\tqueued\texecute\thost\t"
+            "(microseconds, enqueue/queued/execute/host are p50)" << endl;
+
+    size_t crossover = 0;
+    bool compared = false;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        cout << "\t" << sizes[i];
+
+        compared = false;
+        if (! sizeOk[i]) {
+            cout << "\tfail" << endl;
+            crossover = 0;
+            continue;
+        }
+
+        const CallLatency& lat = sizeLatency[i];
+        cout << "\t" << lat.endToEnd.median() / 1000
+             << "\t" << lat.endToEnd.quantile(0.99) / 1000
+             << "\t" << lat.enqueue.median() / 1000
+             << "\t" << lat.queued.median() / 1000
+             << "\t" << lat.execute.median() / 1000
+             << "\t";
+        if (0 == lat.host.count())
+            cout << "-";
+        else
+            cout << lat.host.median() / 1000;
+        cout << "\t";
+        for (size_t j = 0; j < sizeArgs[i].size(); j++) {
+            cout << sizeArgs[i][j];
+            if (j != sizeArgs[i].size() - 1) cout << " ";
+        }
+        cout << endl;
+
+        // smallest size from which the device stays faster
+        compared = 0 != lat.host.count();
+        const bool deviceFaster = 0 != lat.host.count() && lat.endToEnd.median() < lat.host.median();
+        if (! deviceFaster)
+            crossover = 0;
+        else if (0 == crossover)
+            crossover = sizes[i];
+    }
+
+    if (! compared)
+        cout << "crossover: unknown, no host comparison at the largest size" << endl;
+    else if (0 == crossover)
+        cout << "crossover: host reference is faster at the largest size" << endl;
+    else
+        cout << "crossover: device is faster from size " << crossover << endl;
+}
+
 }; // namespace AppUtil
 
 }; // namespace
@@ -31,6 +31,45 @@ namespace AppUtil
     // device may be: cpu, gpu, acc or cpuN, gpuN, accN where N = 0, 1,...
     int getDeviceIndex(OCLBase& oclBase, const std::string& device);
 
+    // select journal records for this device (or the fingerprint named on
+    // the command line when replaying), false if the journal is ambiguous
+    bool selectDevice(OCLApp* oclApp,
+                      Journal& journal,
+                      const std::string& fingerprint,
+                      const bool exactDevice);
+
+    // maximum work group size from the device, recorded in the journal so
+    // it may be replayed later without the device (NULL oclApp), -1 if unknown
+    int maxWorkGroupSize(OCLApp* oclApp, Journal& journal);
+
+    // local memory bytes of the device, recorded in the journal like the
+    // maximum work group size, -1 if unknown
+    int localMemorySize(OCLApp* oclApp, Journal& journal);
+
+    // nominal peak GFLOPS from compute units, clock and preferred vector
+    // width (a multiply-add is two flops), recorded in the journal unless
+    // bench_device already measured it, 0 if unknown
+    double peakGFLOPS(OCLApp* oclApp, Journal& journal, const bool doublePrecision);
+
+    // global memory bandwidth in GB/s, measured once with buffer copies on
+    // the device and recorded in the journal unless bench_device already
+    // measured it, 0 if unknown
+    double peakBandwidth(OCLApp* oclApp, Journal& journal);
+
+    // print parameters that could not be replayed from the journal
+    void printMissing(const Bench& bench);
+
+    // work of one kernel call, saved while benchmarking for the roofline report
+    struct KernelTraffic
+    {
+        size_t flops;
+        size_t bytes;
+        size_t bytesLocal;
+
+        KernelTraffic();
+        KernelTraffic(const KernelInterface& kernel); // for the parameters last set
+    };
+
     // initialize benchmark vectors
     void benchInit(const std::vector< std::vector<size_t> >& pargs,
                    std::vector<bool>& pargsOk,
@@ -68,6 +107,7 @@ namespace AppUtil
                      std::vector<double>& pargsAverage,
                      std::vector<double>& pargsVariance,
                      std::vector< std::vector<size_t> >& pargsExtraDetail,
+                     std::vector<KernelTraffic>& pargsTraffic,
                      const bool busTransferToDevice,
                      const bool busTransferFromDevice,
                      const bool dummyRun = false,
@@ -96,6 +136,35 @@ namespace AppUtil
                     const std::vector<double>& pargsAverage,
                     const std::vector<double>& pargsVariance,
                     const std::vector< std::vector<size_t> >& pargsExtraDetail);
+
+    // print benchmark results with a roofline report: arithmetic intensity,
+    // achieved bandwidth and fraction of device peaks from the journal, and
+    // median and p99 of all journal times for each kernel
+    void printBench(const size_t numberTrials,
+                    KernelInterface& kernel,
+                    Journal& journal,
+                    const std::vector< std::vector<size_t> >& pargs,
+                    const std::vector<bool>& pargsOk,
+                    const std::vector<size_t>& pargsTime,
+                    const std::vector<double>& pargsAverage,
+                    const std::vector<double>& pargsVariance,
+                    const std::vector< std::vector<size_t> >& pargsExtraDetail,
+                    const std::vector<KernelTraffic>& pargsTraffic);
+
+    // per call latency over a sweep of small problem sizes: the fastest
+    // kernel for each size is found with one trial (journal times are
+    // reused), then timed call by call against the host reference, prints
+    // p50/p99 and where the device becomes faster than the host
+    void latencySweep(KernelInterface& kernel,
+                      Bench& bench,
+                      Journal& journal,
+                      const std::vector<size_t>& sizes,
+                      const std::vector< std::vector< std::vector<size_t> > >& pargsBySize,
+                      const size_t numberCalls,
+                      const bool busTransferToDevice,
+                      const bool busTransferFromDevice,
+                      const bool printDebug,
+                      const bool paranoidCheck);
 };
 
 }; // namespace
@@ -15,15 +15,23 @@
 //    You should have received a copy of the GNU Lesser General Public License
 //    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <ctype.h>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
 #include <ostream>
 #include <sstream>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <unistd.h>
 #include "GatlasType.hpp"
 #include "GatlasQualifier.hpp"
 #include "GatlasCodeText.hpp"
+#include "OCLAppUtil.hpp"
 
 #include "GatlasBenchmark.hpp"
 
@@ -31,16 +39,132 @@
 
 using namespace std;
 
+// journal keys of device limit records, kernel names never start with this
+static const string DEVICE_MEMO_PREFIX = "device_";
+
+// prefix for summary of times, written only when the journal is compacted,
+// time records after it are added to the summary as they are read
+static const string STATS_MEMO_PREFIX = "stats_";
+
+// prefixes for kernels with identical source, the hash of the source for
+// the key first built from it and the keys that are duplicates of it
+static const string SOURCE_MEMO_PREFIX = "source_";
+static const string ALIAS_MEMO_PREFIX = "alias_";
+
 ////////////////////////////////////////
 // KernelInterface
 
+// expression nodes built while printing a kernel are freed when it is done
 ostream& operator<< (ostream& os, const KernelInterface& k) {
+    static ExprArena arena;
+    ExprArenaScope scope(arena);
     return k.print(os);
 }
 
+////////////////////////////////////////
+// DeviceFingerprint
+
+// fingerprint fields must not contain whitespace or the key and field separators
+static string fingerprintField(const string& value) {
+    const size_t first = value.find_first_not_of(" \t\n");
+    const size_t last = value.find_last_not_of(" \t\n");
+    if (string::npos == first) return "";
+
+    string field = value.substr(first, last - first + 1);
+    for (size_t i = 0; i < field.size(); i++)
+        if (isspace(field[i]) || '/' == field[i] || '|' == field[i])
+            field[i] = '_';
+    return field;
+}
+
+DeviceFingerprint::DeviceFingerprint()
+    : computeUnits(0),
+      clockFrequency(0)
+{ }
+
+DeviceFingerprint::DeviceFingerprint(OCLApp& oclApp)
+    : vendor(fingerprintField(oclApp.deviceVendor())),
+      name(fingerprintField(oclApp.deviceName())),
+      driver(fingerprintField(oclApp.driverVersion())),
+      computeUnits(oclApp.maxComputeUnits()),
+      clockFrequency(oclApp.maxClockFrequency())
+{ }
+
+DeviceFingerprint::DeviceFingerprint(const string& token)
+    : computeUnits(0),
+      clockFrequency(0)
+{
+    vector<string> fields;
+    stringstream ss(token);
+    string field;
+    while (getline(ss, field, '|'))
+        fields.push_back(field);
+
+    if (5 == fields.size()) {
+        vendor = fields[0];
+        name = fields[1];
+        driver = fields[2];
+        computeUnits = atoi(fields[3].c_str());
+        clockFrequency = atoi(fields[4].c_str());
+    }
+}
+
+bool DeviceFingerprint::empty() const {
+    return vendor.empty() && name.empty();
+}
+
+string DeviceFingerprint::str() const {
+    if (empty()) return "";
+
+    stringstream ss;
+    ss << vendor << "|" << name << "|" << driver << "|" << computeUnits << "|" << clockFrequency;
+    return ss.str();
+}
+
+bool DeviceFingerprint::compatible(const DeviceFingerprint& other) const {
+    return vendor == other.vendor && name == other.name && computeUnits == other.computeUnits;
+}
+
+bool DeviceFingerprint::closer(const DeviceFingerprint& a, const DeviceFingerprint& b) const {
+    // same driver matters more than clock speed
+    if ((driver == a.driver) != (driver == b.driver))
+        return driver == a.driver;
+
+    const size_t diffA = clockFrequency > a.clockFrequency ? clockFrequency - a.clockFrequency : a.clockFrequency - clockFrequency;
+    const size_t diffB = clockFrequency > b.clockFrequency ? clockFrequency - b.clockFrequency : b.clockFrequency - clockFrequency;
+    return diffA < diffB;
+}
+
 ////////////////////////////////////////
 // Journal
 
+// advisory lock shared by all processes using a journal, the journal file
+// itself is replaced when compacted so the lock is on a separate file
+class JournalLock
+{
+    int _fd;
+
+public:
+    JournalLock(const string& journalFile, const bool exclusive)
+        : _fd(open((journalFile + ".lock").c_str(), O_RDWR | O_CREAT, 0666))
+    {
+        // read only directory, readers go ahead without the lock
+        if (-1 == _fd) return;
+
+        if (-1 == flock(_fd, exclusive ? LOCK_EX : LOCK_SH)) {
+            close(_fd);
+            _fd = -1;
+        }
+    }
+
+    ~JournalLock() {
+        if (-1 != _fd) {
+            flock(_fd, LOCK_UN);
+            close(_fd);
+        }
+    }
+};
+
 string Journal::toString(const KernelInterface& kernel, const vector<size_t>& params) const {
     stringstream ss;
     ss << kernel.kernelName() << "_";
@@ -49,57 +173,449 @@ string Journal::toString(const KernelInterface& kernel, const vector<size_t>& pa
     return ss.str();
 }
 
+// duplicate kernels share the records of the kernel first built from the source
+string Journal::resolve(const string& key) const {
+    const map<string, string>::const_iterator iter = _memoAlias.find(key);
+    return _memoAlias.end() == iter ? key : (*iter).second;
+}
+
+string Journal::prefix() const {
+    return _fingerprint.empty() ? "" : _fingerprint.str() + "/";
+}
+
+void Journal::selectMemo() {
+    _memoRunState.clear();
+    _memoTime.clear();
+    _memoDevice.clear();
+    _memoStats.clear();
+    _memoAlias.clear();
+    _memoSource.clear();
+
+    // lookup order is this device, closest compatible device, untagged records
+    vector<string> order;
+    if (! _fingerprint.empty()) {
+        const string self = _fingerprint.str();
+        if (_memoByDevice.count(self)) order.push_back(self);
+
+        if (_closestDevice) {
+            string closest;
+            DeviceFingerprint closestDevice;
+            for (map<string, Memo>::const_iterator iter = _memoByDevice.begin();
+                 iter != _memoByDevice.end();
+                 iter++) {
+                const DeviceFingerprint device((*iter).first);
+                if ((*iter).first != self &&
+                    _fingerprint.compatible(device) &&
+                    (closest.empty() || _fingerprint.closer(device, closestDevice))) {
+                    closest = (*iter).first;
+                    closestDevice = device;
+                }
+            }
+            if (! closest.empty()) order.push_back(closest);
+        }
+
+    } else if (1 == fingerprints().size()) {
+        // journal is for a single device
+        order.push_back(fingerprints()[0].str());
+    }
+    if (_memoByDevice.count("")) order.push_back("");
+    _memoOrder = order;
+
+    // records for a key all come from the first device that has it
+    for (size_t i = 0; i < order.size(); i++) {
+        const Memo& memo = _memoByDevice[order[i]];
+
+        for (map<string, int>::const_iterator iter = memo.runState.begin();
+             iter != memo.runState.end();
+             iter++) {
+            const string& key = (*iter).first;
+            if (_memoRunState.count(key) || _memoTime.count(key)) continue;
+            _memoRunState[key] = (*iter).second;
+            if (memo.time.count(key)) _memoTime[key] = (*memo.time.find(key)).second;
+            if (memo.stats.count(key)) _memoStats[key] = (*memo.stats.find(key)).second;
+        }
+
+        for (map<string, vector<size_t> >::const_iterator iter = memo.time.begin();
+             iter != memo.time.end();
+             iter++) {
+            const string& key = (*iter).first;
+            if (_memoRunState.count(key) || _memoTime.count(key)) continue;
+            _memoTime[key] = (*iter).second;
+            if (memo.stats.count(key)) _memoStats[key] = (*memo.stats.find(key)).second;
+        }
+
+        for (map<string, size_t>::const_iterator iter = memo.device.begin();
+             iter != memo.device.end();
+             iter++) {
+            if (0 == _memoDevice.count((*iter).first))
+                _memoDevice[(*iter).first] = (*iter).second;
+        }
+
+        for (map<string, string>::const_iterator iter = memo.alias.begin();
+             iter != memo.alias.end();
+             iter++) {
+            if (0 == _memoAlias.count((*iter).first))
+                _memoAlias[(*iter).first] = (*iter).second;
+        }
+
+        for (map<string, string>::const_iterator iter = memo.source.begin();
+             iter != memo.source.end();
+             iter++) {
+            if (0 == _memoSource.count((*iter).second))
+                _memoSource[(*iter).second] = (*iter).first;
+        }
+    }
+}
+
+// only the keys of records read since the last selection are looked up
+// again, devices are in the same order as long as no device was added
+void Journal::selectMemo(const MemoKeys& keys) {
+    for (set<string>::const_iterator iter = keys.record.begin();
+         iter != keys.record.end();
+         iter++) {
+        const string& key = *iter;
+        _memoRunState.erase(key);
+        _memoTime.erase(key);
+        _memoStats.erase(key);
+
+        for (size_t i = 0; i < _memoOrder.size(); i++) {
+            const Memo& memo = _memoByDevice[_memoOrder[i]];
+            const bool hasState = memo.runState.count(key);
+            const bool hasTime = memo.time.count(key);
+            if (! hasState && ! hasTime) continue;
+
+            if (hasState) _memoRunState[key] = (*memo.runState.find(key)).second;
+            if (hasTime) _memoTime[key] = (*memo.time.find(key)).second;
+            if (memo.stats.count(key)) _memoStats[key] = (*memo.stats.find(key)).second;
+            break;
+        }
+    }
+
+    for (set<string>::const_iterator iter = keys.device.begin();
+         iter != keys.device.end();
+         iter++) {
+        for (size_t i = 0; i < _memoOrder.size(); i++) {
+            const Memo& memo = _memoByDevice[_memoOrder[i]];
+            if (memo.device.count(*iter)) {
+                _memoDevice[*iter] = (*memo.device.find(*iter)).second;
+                break;
+            }
+        }
+    }
+
+    for (set<string>::const_iterator iter = keys.alias.begin();
+         iter != keys.alias.end();
+         iter++) {
+        for (size_t i = 0; i < _memoOrder.size(); i++) {
+            const Memo& memo = _memoByDevice[_memoOrder[i]];
+            if (memo.alias.count(*iter)) {
+                _memoAlias[*iter] = (*memo.alias.find(*iter)).second;
+                break;
+            }
+        }
+    }
+
+    // a hash belongs to the first device in order with the smallest key
+    for (size_t i = 0; i < keys.source.size(); i++) {
+        const string& key = keys.source[i].first;
+        const string& hash = keys.source[i].second;
+
+        const map<string, string>::iterator same = _memoSource.find(hash);
+        if (_memoSource.end() == same) {
+            for (size_t j = 0; j < _memoOrder.size(); j++) {
+                const Memo& memo = _memoByDevice[_memoOrder[j]];
+                const map<string, string>::const_iterator jter = memo.source.find(key);
+                if (memo.source.end() != jter && hash == (*jter).second) {
+                    _memoSource[hash] = key;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        for (size_t j = 0; j < _memoOrder.size(); j++) {
+            const Memo& memo = _memoByDevice[_memoOrder[j]];
+            const map<string, string>::const_iterator newer = memo.source.find(key);
+            const map<string, string>::const_iterator older = memo.source.find((*same).second);
+            const bool hasNewer = memo.source.end() != newer && hash == (*newer).second;
+            const bool hasOlder = memo.source.end() != older && hash == (*older).second;
+            if (hasNewer && (! hasOlder || key < (*same).second)) (*same).second = key;
+            if (hasNewer || hasOlder) break;
+        }
+    }
+}
+
 Journal::Journal(const std::string& journalFile)
-    : _journalFile(journalFile)
+    : _journalFile(journalFile),
+      _closestDevice(true),
+      _memoOffset(0),
+      _memoInode(0)
 { }
 
-bool Journal::loadMemo() {
-    ifstream journal(_journalFile.c_str());
-    if (journal.is_open()) {
+void Journal::setFingerprint(const DeviceFingerprint& device, const bool closestDevice) {
+    _fingerprint = device;
+    _closestDevice = closestDevice;
+    selectMemo();
+}
+
+const DeviceFingerprint& Journal::fingerprint() const { return _fingerprint; }
+
+vector<DeviceFingerprint> Journal::fingerprints() const {
+    vector<DeviceFingerprint> devices;
+    for (map<string, Memo>::const_iterator iter = _memoByDevice.begin();
+         iter != _memoByDevice.end();
+         iter++) {
+        if (! (*iter).first.empty())
+            devices.push_back(DeviceFingerprint((*iter).first));
+    }
+    return devices;
+}
+
+void Journal::addMemo(const string& device, const string& key, const int value) {
+    Memo& memo = _memoByDevice[device];
+
+    if (0 == key.find(DEVICE_MEMO_PREFIX))
+        memo.device[key.substr(DEVICE_MEMO_PREFIX.size())] = value;
+    else if (value < 0)
+        memo.runState[key] = value;
+    else {
+        memo.time[key].push_back(value);
+        if (value > 0) memo.stats[key].add(value);
+    }
+}
+
+void Journal::parseMemo(istream& journal, MemoKeys& keys) {
+    string line;
+    while (getline(journal, line)) {
+        stringstream ss(line);
         string key;
+        if (! (ss >> key)) continue;
+
+        // records may be tagged with the device fingerprint
+        string device;
+        const size_t pos = key.find('/');
+        if (string::npos != pos) {
+            device = key.substr(0, pos);
+            key = key.substr(pos + 1);
+        }
+
+        // summary replaces what was accumulated from the times before it
+        if (0 == key.find(STATS_MEMO_PREFIX)) {
+            string token;
+            getline(ss, token);
+            _memoByDevice[device].stats[key.substr(STATS_MEMO_PREFIX.size())] = TimeStats(token);
+            keys.record.insert(key.substr(STATS_MEMO_PREFIX.size()));
+            continue;
+        }
+
+        // kernels with identical source
+        if (0 == key.find(SOURCE_MEMO_PREFIX)) {
+            string hash;
+            if (ss >> hash) {
+                _memoByDevice[device].source[key.substr(SOURCE_MEMO_PREFIX.size())] = hash;
+                keys.source.push_back(make_pair(key.substr(SOURCE_MEMO_PREFIX.size()), hash));
+            }
+            continue;
+        }
+        if (0 == key.find(ALIAS_MEMO_PREFIX)) {
+            string same;
+            if (ss >> same) {
+                _memoByDevice[device].alias[key.substr(ALIAS_MEMO_PREFIX.size())] = same;
+                keys.alias.insert(key.substr(ALIAS_MEMO_PREFIX.size()));
+            }
+            continue;
+        }
+
         int value;
-        _memoRunState.clear();
-        _memoTime.clear();
-        while (! journal.eof() && (journal >> key >> value)) {
-            if (value < 0)
-                _memoRunState[key] = value;
+        if (ss >> value) {
+            addMemo(device, key, value);
+            if (0 == key.find(DEVICE_MEMO_PREFIX))
+                keys.device.insert(key.substr(DEVICE_MEMO_PREFIX.size()));
             else
-                _memoTime[key].push_back(value);
+                keys.record.insert(key);
         }
+    }
+}
+
+// (assumes the journal lock is held so there are no partial records)
+bool Journal::readMemo() {
+    struct stat st;
+    if (-1 == stat(_journalFile.c_str(), &st))
+        return false;
+
+    // nothing appended since the last read
+    if (st.st_ino == _memoInode && st.st_size == _memoOffset)
         return true;
-    } else {
+
+    ifstream journal(_journalFile.c_str());
+    if (! journal.is_open())
         return false;
+
+    // start over if another process compacted the journal
+    const bool compacted = st.st_ino != _memoInode || st.st_size < _memoOffset;
+    if (compacted) {
+        _memoByDevice.clear();
+        _memoOffset = 0;
+        _memoInode = st.st_ino;
+    }
+
+    const size_t numberDevices = _memoByDevice.size();
+
+    journal.seekg(_memoOffset);
+    MemoKeys keys;
+    parseMemo(journal, keys);
+    _memoOffset = st.st_size;
+
+    // appended records are merged into the lookups, which are only rebuilt
+    // when everything was read again or a new device changes the order
+    if (compacted || numberDevices != _memoByDevice.size())
+        selectMemo();
+    else
+        selectMemo(keys);
+    return true;
+}
+
+bool Journal::loadMemo() {
+    JournalLock lock(_journalFile, false);
+    _memoOffset = 0;
+    _memoInode = 0;
+    return readMemo();
+}
+
+bool Journal::refreshMemo() {
+    JournalLock lock(_journalFile, false);
+    return readMemo();
+}
+
+void Journal::mergeMemo(const Journal& other, const DeviceFingerprint& untagged) {
+    for (map<string, Memo>::const_iterator iter = other._memoByDevice.begin();
+         iter != other._memoByDevice.end();
+         iter++) {
+        const Memo& memo = (*iter).second;
+        Memo& into = _memoByDevice[(*iter).first.empty() ? untagged.str() : (*iter).first];
+
+        // a kernel that ran ok on one machine is good even if it failed on another
+        for (map<string, int>::const_iterator jter = memo.runState.begin();
+             jter != memo.runState.end();
+             jter++) {
+            const string& key = (*jter).first;
+            if (0 == into.time.count(key) || memo.time.count(key))
+                into.runState[key] = (*jter).second;
+        }
+
+        // times from all machines are trials of the same kernel
+        for (map<string, vector<size_t> >::const_iterator jter = memo.time.begin();
+             jter != memo.time.end();
+             jter++) {
+            vector<size_t>& times = into.time[(*jter).first];
+            times.insert(times.end(), (*jter).second.begin(), (*jter).second.end());
+        }
+
+        for (map<string, TimeStats>::const_iterator jter = memo.stats.begin();
+             jter != memo.stats.end();
+             jter++)
+            into.stats[(*jter).first].merge((*jter).second);
+
+        for (map<string, size_t>::const_iterator jter = memo.device.begin();
+             jter != memo.device.end();
+             jter++) {
+            if (0 == into.device.count((*jter).first))
+                into.device[(*jter).first] = (*jter).second;
+        }
+
+        for (map<string, string>::const_iterator jter = memo.alias.begin();
+             jter != memo.alias.end();
+             jter++) {
+            if (0 == into.alias.count((*jter).first))
+                into.alias[(*jter).first] = (*jter).second;
+        }
+
+        for (map<string, string>::const_iterator jter = memo.source.begin();
+             jter != memo.source.end();
+             jter++) {
+            if (0 == into.source.count((*jter).first))
+                into.source[(*jter).first] = (*jter).second;
+        }
     }
+
+    selectMemo();
 }
 
 int Journal::purgeMemo(const bool deleteTimes) {
+    JournalLock lock(_journalFile, true);
+
+    // keep records other processes appended since the last load
+    readMemo();
+
+    // compacted journal is written to a temporary file and renamed so
+    // readers never see a partial file
+    const string tmpFile = _journalFile + ".tmp";
     int count = -1;
-    ofstream journal(_journalFile.c_str());
+    ofstream journal(tmpFile.c_str());
     if (journal.is_open()) {
         count = 0;
-        for (map<string, int>::const_iterator iter = _memoRunState.begin();
-             iter != _memoRunState.end();
-             iter++) {
-            const string key = (*iter).first;
-            const int value = (*iter).second;
-
-            // always keep records for bad kernels
-            if (0 == _memoTime.count(key)) {
-                // this kernel has no benchmark time so must be bad
-                journal << key << "\t" << value << endl;
-                count++; // increment number of bad kernels
-
-            // optionally keep benchmark time records for good kernels
-            } else {
-                if (! deleteTimes) {
-                    journal << key << "\t" << value << endl; // this is always RUN_OK
-                    for (size_t i = 0; i < _memoTime[key].size(); i++) {
-                        const size_t benchtime = _memoTime[key][i];
-                        journal << key << "\t" << benchtime << endl;
+
+        // records are grouped by device and sorted by key
+        for (map<string, Memo>::iterator dter = _memoByDevice.begin();
+             dter != _memoByDevice.end();
+             dter++) {
+            const string tag = (*dter).first.empty() ? "" : (*dter).first + "/";
+            Memo& memo = (*dter).second;
+
+            // device limits are needed for replay
+            for (map<string, size_t>::const_iterator iter = memo.device.begin();
+                 iter != memo.device.end();
+                 iter++)
+                journal << tag << DEVICE_MEMO_PREFIX << (*iter).first << "\t" << (*iter).second << endl;
+
+            // duplicates are never built again
+            for (map<string, string>::const_iterator iter = memo.source.begin();
+                 iter != memo.source.end();
+                 iter++)
+                journal << tag << SOURCE_MEMO_PREFIX << (*iter).first << "\t" << (*iter).second << endl;
+            for (map<string, string>::const_iterator iter = memo.alias.begin();
+                 iter != memo.alias.end();
+                 iter++)
+                journal << tag << ALIAS_MEMO_PREFIX << (*iter).first << "\t" << (*iter).second << endl;
+
+            for (map<string, int>::const_iterator iter = memo.runState.begin();
+                 iter != memo.runState.end();
+                 iter++) {
+                const string key = (*iter).first;
+                const int value = (*iter).second;
+
+                // always keep records for bad kernels
+                if (0 == memo.time.count(key)) {
+                    // this kernel has no benchmark time so must be bad
+                    journal << tag << key << "\t" << value << endl;
+                    if (BATCH_IN_PROGRESS != value)
+                        count++; // increment number of bad kernels
+
+                // optionally keep benchmark time records for good kernels
+                } else {
+                    if (! deleteTimes) {
+                        journal << tag << key << "\t" << value << endl; // this is always RUN_OK
+                        for (size_t i = 0; i < memo.time[key].size(); i++) {
+                            const size_t benchtime = memo.time[key][i];
+                            journal << tag << key << "\t" << benchtime << endl;
+                        }
+                        if (memo.stats.count(key))
+                            journal << tag << STATS_MEMO_PREFIX << key << "\t" << memo.stats[key].str() << endl;
                     }
                 }
             }
         }
+
+        journal.close();
+        struct stat st;
+        if (journal.fail() ||
+            -1 == rename(tmpFile.c_str(), _journalFile.c_str()) ||
+            -1 == stat(_journalFile.c_str(), &st)) {
+            remove(tmpFile.c_str());
+            return -1;
+        }
+        _memoOffset = st.st_size;
+        _memoInode = st.st_ino;
     }
     return count;
 }
@@ -107,7 +623,7 @@ int Journal::purgeMemo(const bool deleteTimes) {
 size_t Journal::memoGood() const { return _memoTime.size(); }
 
 int Journal::memoRunState(const KernelInterface& kernel, const vector<size_t>& params) {
-    const string key = toString(kernel, params);
+    const string key = resolve(toString(kernel, params));
     if (0 == _memoRunState.count(key))
         return MISSING; // not in memo
     else
@@ -115,7 +631,7 @@ int Journal::memoRunState(const KernelInterface& kernel, const vector<size_t>& p
 }
 
 int Journal::memoTime(const KernelInterface& kernel, const vector<size_t>& params, const size_t trialNumber) {
-    const string key = toString(kernel, params);
+    const string key = resolve(toString(kernel, params));
     if (0 == _memoTime.count(key))
         return -1; // not in memo
     else {
@@ -126,54 +642,547 @@ int Journal::memoTime(const KernelInterface& kernel, const vector<size_t>& param
     }
 }
 
-bool Journal::takeMemo(const KernelInterface& kernel, const std::vector<size_t>& params, const int value) const {
+bool Journal::appendRecord(const string& key, const string& value) {
+    OCLTraceScope trace("journal");
+    JournalLock lock(_journalFile, true);
+
+    // catch up with other processes so the file offset stays in step
+    readMemo();
+
     ofstream journal(_journalFile.c_str(), ios::app);
     if (journal.is_open()) {
-        journal << toString(kernel, params) << "\t" << value << endl;
+        journal << prefix() << key << "\t" << value << endl;
+        journal.close();
+
+        struct stat st;
+        if (-1 != stat(_journalFile.c_str(), &st)) {
+            _memoOffset = st.st_size;
+            _memoInode = st.st_ino;
+        }
         return true;
     } else {
         return false;
     }
 }
 
+bool Journal::appendMemo(const string& key, const int value) {
+    stringstream ss;
+    ss << value;
+    if (! appendRecord(key, ss.str())) return false;
+
+    // records from this device take precedence in lookups, the summary of
+    // times grows with each time and is only written at compaction
+    const string device = _fingerprint.str();
+    addMemo(device, key, value);
+    const Memo& memo = _memoByDevice[device];
+
+    if (0 == key.find(DEVICE_MEMO_PREFIX)) {
+        const string name = key.substr(DEVICE_MEMO_PREFIX.size());
+        _memoDevice[name] = (*memo.device.find(name)).second;
+    } else {
+        if (memo.runState.count(key))
+            _memoRunState[key] = (*memo.runState.find(key)).second;
+        else
+            _memoRunState.erase(key);
+
+        if (memo.time.count(key))
+            _memoTime[key] = (*memo.time.find(key)).second;
+        else
+            _memoTime.erase(key);
+
+        if (memo.stats.count(key))
+            _memoStats[key] = (*memo.stats.find(key)).second;
+        else
+            _memoStats.erase(key);
+    }
+
+    return true;
+}
+
+bool Journal::takeMemo(const KernelInterface& kernel, const std::vector<size_t>& params, const int value) {
+    return appendMemo(resolve(toString(kernel, params)), value);
+}
+
+TimeStats Journal::memoStats(const KernelInterface& kernel, const vector<size_t>& params) const {
+    const map<string, TimeStats>::const_iterator iter = _memoStats.find(resolve(toString(kernel, params)));
+    return _memoStats.end() == iter ? TimeStats() : (*iter).second;
+}
+
+string Journal::memoSource(const KernelInterface& kernel,
+                           const vector<size_t>& params,
+                           const string& sourceHash) const {
+    const map<string, string>::const_iterator iter = _memoSource.find(sourceHash);
+    if (_memoSource.end() == iter || resolve(toString(kernel, params)) == (*iter).second)
+        return "";
+    else
+        return (*iter).second;
+}
+
+bool Journal::takeSourceMemo(const KernelInterface& kernel,
+                             const vector<size_t>& params,
+                             const string& sourceHash) {
+    // only the first kernel built from the source is needed
+    if (_memoSource.count(sourceHash)) return true;
+
+    const string key = resolve(toString(kernel, params));
+    if (! appendRecord(SOURCE_MEMO_PREFIX + key, sourceHash)) return false;
+
+    _memoByDevice[_fingerprint.str()].source[key] = sourceHash;
+    _memoSource[sourceHash] = key;
+    return true;
+}
+
+bool Journal::takeAliasMemo(const KernelInterface& kernel,
+                            const vector<size_t>& params,
+                            const string& key) {
+    const string alias = toString(kernel, params);
+    if (key.empty() || alias == key) return false;
+    if (resolve(alias) == key) return true;
+
+    if (! appendRecord(ALIAS_MEMO_PREFIX + alias, key)) return false;
+
+    _memoByDevice[_fingerprint.str()].alias[alias] = key;
+    _memoAlias[alias] = key;
+    return true;
+}
+
+int Journal::memoDevice(const string& name) const {
+    const map<string, size_t>::const_iterator iter = _memoDevice.find(name);
+    return _memoDevice.end() == iter ? -1 : (*iter).second;
+}
+
+bool Journal::takeDeviceMemo(const string& name, const size_t value) {
+    // only write when the device is new or has changed
+    map<string, size_t>& own = _memoByDevice[_fingerprint.str()].device;
+    if (own.count(name) && value == own[name]) return true;
+
+    return appendMemo(DEVICE_MEMO_PREFIX + name, value);
+}
+
 ////////////////////////////////////////
 // Bench
 
 Bench::Bench(OCLApp& oclApp, KernelInterface& kernel, const bool printStatus)
-    : _oclApp(oclApp),
+    : _oclApp(&oclApp),
       _kernel(kernel),
       _journal(NULL),
       _kernelHandle(-1),
-      _printStatus(printStatus)
+      _printStatus(printStatus),
+      _overlapTransfers(false),
+      _batchSize(1)
 { }
 
 Bench::Bench(OCLApp& oclApp, KernelInterface& kernel, Journal& journal, const bool printStatus)
+    : _oclApp(&oclApp),
+      _kernel(kernel),
+      _journal(&journal),
+      _kernelHandle(-1),
+      _printStatus(printStatus),
+      _overlapTransfers(false),
+      _batchSize(1)
+{ }
+
+Bench::Bench(OCLApp* oclApp, KernelInterface& kernel, Journal& journal, const bool printStatus)
     : _oclApp(oclApp),
       _kernel(kernel),
       _journal(&journal),
       _kernelHandle(-1),
-      _printStatus(printStatus)
+      _printStatus(printStatus),
+      _overlapTransfers(false),
+      _batchSize(1)
 { }
 
 bool Bench::printStatus() const { return _printStatus; }
 
-bool Bench::rebuildProgram() {
-    // program source
+bool Bench::replay() const { return NULL == _oclApp; }
+
+const set< vector<size_t> >& Bench::missing() const { return _missing; }
+
+void Bench::overlapTransfers(const bool enable) { _overlapTransfers = enable; }
+
+void Bench::batchSize(const size_t size) { _batchSize = size > 0 ? size : 1; }
+
+size_t Bench::batchSize() const { return _batchSize; }
+
+// a single trial has nothing to overlap with, overlapped runs pipeline at
+// least this many kernels and the time is scaled to the trials asked for
+static const size_t OVERLAP_TRIALS = 4;
+
+bool Bench::overlapped(const bool busTransferToDevice,
+                       const bool busTransferFromDevice) const {
+    if (!_overlapTransfers || _oclApp->numberQueues() <= OCLApp::COPY_QUEUE)
+        return false;
+
+    // kernel must say which buffers move over the bus every trial, these
+    // are the buffers of the current candidate once its arguments are set
+    const vector<size_t> inputs = _kernel.inputBuffers();
+    const vector<size_t> outputs = _kernel.outputBuffers();
+    if ((busTransferToDevice && inputs.empty()) || (busTransferFromDevice && outputs.empty()))
+        return false;
+    for (size_t i = 0; i < inputs.size(); i++)
+        if (static_cast<size_t>(-1) == inputs[i]) return false;
+    for (size_t i = 0; i < outputs.size(); i++)
+        if (static_cast<size_t>(-1) == outputs[i]) return false;
+
+    // nothing to overlap if the device works directly on host memory
+    for (size_t i = 0; i < inputs.size(); i++)
+        if (_oclApp->zeroCopyBuffer(inputs[i])) return false;
+    for (size_t i = 0; i < outputs.size(); i++)
+        if (_oclApp->zeroCopyBuffer(outputs[i])) return false;
+
+    return busTransferToDevice || busTransferFromDevice;
+}
+
+bool Bench::shadowBuffers(const vector<size_t>& handles,
+                          vector<size_t>& shadows) {
+    shadows.clear();
+    for (size_t i = 0; i < handles.size(); i++) {
+        const size_t bytes = _oclApp->bufferBytes(handles[i]);
+        const int shadow = _oclApp->createPooledBuffer<char>(bytes, OCLApp::READWRITE);
+        if (-1 == shadow) {
+            if (_printStatus) cerr << "error: create buffer for overlapped trials" << endl;
+            releaseBuffers(shadows);
+            return false;
+        }
+        shadows.push_back(shadow);
+
+        // same data so the trials of either set give the same output
+        memcpy(_oclApp->bufferPtr<char>(shadow), _oclApp->bufferPtr<char>(handles[i]), bytes);
+        if (!syncBufferToDevice(*_oclApp, shadow)) {
+            if (_printStatus) cerr << "error: create buffer for overlapped trials" << endl;
+            releaseBuffers(shadows);
+            return false;
+        }
+    }
+    return true;
+}
+
+void Bench::releaseBuffers(const vector<size_t>& handles) {
+    for (size_t i = 0; i < handles.size(); i++)
+        _oclApp->releaseBuffer(handles[i]);
+}
+
+bool Bench::enqueueOverlapped(const size_t numTrials,
+                              const vector<size_t>& globalDims,
+                              const vector<size_t>& localDims,
+                              const bool busTransferToDevice,
+                              const bool busTransferFromDevice,
+                              const vector<size_t> inputs[2],
+                              const vector<size_t> outputs[2]) {
+    // with only one copy queue, reads and writes share it
+    const size_t writeQueue = OCLApp::COPY_QUEUE;
+    const size_t readQueue = _oclApp->numberQueues() > OCLApp::COPY_QUEUE + 1
+                                 ? OCLApp::COPY_QUEUE + 1
+                                 : OCLApp::COPY_QUEUE;
+
+    // trials alternate between two sets of buffers so the transfers of one
+    // trial overlap the kernel of the other, the last trial uses the kernel
+    // buffers so its output is checked
+    vector<size_t> kernelDeps, writeEvents, readEvents[2];
+    int lastKernel[2] = { -1, -1 };
+    int waitKernel = -1;
+    bool rc = true;
+
+    for (size_t i = 0; rc && i < numTrials; i++)
+    {
+        const size_t set = (numTrials - 1 - i) % 2;
+
+        // input data for this trial goes over the bus while the kernel of
+        // the other set runs, the inputs are not overwritten until the last
+        // kernel of this set is done reading them
+        writeEvents.clear();
+        if (busTransferToDevice) {
+            const vector<size_t> writeDeps = -1 != lastKernel[set]
+                                                 ? vector<size_t>(1, lastKernel[set])
+                                                 : vector<size_t>();
+            rc = _oclApp->selectQueue(writeQueue);
+            for (size_t j = 0; rc && j < inputs[set].size(); j++) {
+                const int writeEvent = _oclApp->enqueueWriteBuffer(inputs[set][j], writeDeps);
+                if (-1 == writeEvent) rc = false;
+                else writeEvents.push_back(writeEvent);
+            }
+            if (!rc) {
+                if (_printStatus) cerr << "error: enqueue input transfer " << i << endl;
+                break;
+            }
+        }
+
+        // kernel depends on its inputs, the previous kernel and the reads
+        // of the last output of this set which must finish before it is
+        // overwritten
+        kernelDeps = writeEvents;
+        if (-1 != waitKernel) kernelDeps.push_back(waitKernel);
+        kernelDeps.insert(kernelDeps.end(), readEvents[set].begin(), readEvents[set].end());
+
+        rc = _oclApp->selectQueue(OCLApp::COMPUTE_QUEUE) &&
+             _kernel.setBufferArgs(*_oclApp, _kernelHandle, inputs[set], outputs[set]);
+        if (rc) waitKernel = _oclApp->enqueueKernel(_kernelHandle, globalDims, localDims, kernelDeps);
+        if (!rc || -1 == waitKernel) {
+            if (_printStatus) cerr << "error: enqueue kernel " << i << endl;
+            rc = false;
+            break;
+        }
+        lastKernel[set] = waitKernel;
+
+        // output data goes over the bus while the next kernel runs
+        readEvents[set].clear();
+        if (busTransferFromDevice) {
+            rc = _oclApp->selectQueue(readQueue);
+            for (size_t j = 0; rc && j < outputs[set].size(); j++) {
+                const int readEvent = _oclApp->enqueueReadBuffer(outputs[set][j], vector<size_t>(1, waitKernel));
+                if (-1 == readEvent) rc = false;
+                else readEvents[set].push_back(readEvent);
+            }
+            if (!rc) {
+                if (_printStatus) cerr << "error: enqueue output transfer " << i << endl;
+                break;
+            }
+        }
+    }
+
+    _oclApp->selectQueue(OCLApp::COMPUTE_QUEUE);
+
+    // wait for all transfers and kernels to finish
+    if (!_oclApp->wait()) { // blocking call
+        if (_printStatus) cerr << "error: waiting for all transfers and kernels" << endl;
+        return false;
+    }
+
+    return rc;
+}
+
+// FNV-1a hash continued from the previous value
+static unsigned long hashBytes(const void* data, const size_t n, unsigned long hash) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < n; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ul;
+    }
+    return hash;
+}
+
+string Bench::generateSource() {
+    OCLTraceScope trace("generate source");
     stringstream ss;
     ss << _kernel;
     _programSource.clear();
     _programSource.push_back(ss.str());
 
+    // the same source may run over different work items or problem sizes
+    unsigned long hash = 14695981039346656037ul;
+    hash = hashBytes(_programSource[0].data(), _programSource[0].size(), hash);
+    const vector<size_t> globalDims = _kernel.globalWorkItems();
+    const vector<size_t> localDims = _kernel.localWorkItems();
+    const size_t problem[] = { _kernel.numberFlops(), _kernel.bytesMoved() };
+    if (! globalDims.empty()) hash = hashBytes(&globalDims[0], globalDims.size() * sizeof(size_t), hash);
+    if (! localDims.empty()) hash = hashBytes(&localDims[0], localDims.size() * sizeof(size_t), hash);
+    hash = hashBytes(problem, sizeof(problem), hash);
+
+    // and the same source compiles differently with other build options
+    const string options = _kernel.buildOptions();
+    hash = hashBytes(options.data(), options.size(), hash);
+
+    stringstream hs;
+    hs << std::hex << hash;
+    return hs.str();
+}
+
+string Bench::sourceHash(const vector<size_t>& args) {
+    _kernel.setParams(args);
+    const string hash = generateSource();
+
+    // kernel buffers are sized by the arguments last set
+    if (! _lastArgs.empty()) _kernel.setParams(_lastArgs);
+    return hash;
+}
+
+bool Bench::alias(const vector<size_t>& args) {
+    if (replay() || NULL == _journal) return false;
+
+    const string key = _journal->memoSource(_kernel, args, sourceHash(args));
+    return ! key.empty() && _journal->takeAliasMemo(_kernel, args, key);
+}
+
+bool Bench::rebuildProgram() {
+    // kernels of a batch go away with the program
+    _batchKernel.clear();
+
     // build program
-    if (_oclApp.buildProgram(_programSource)) {
+    if (_oclApp->buildProgram(_programSource, _kernel.buildOptions())) {
         // create kernel
-        _kernelHandle = _oclApp.createKernel(_kernel.kernelName());
+        _kernelHandle = _oclApp->createKernel(_kernel.kernelName());
         return true;
     } else {
         return false;
     }
 }
 
+// kernel name unique to the parameters, FNV-1a hash so names stay short
+static string batchKernelName(const KernelInterface& kernel, const vector<size_t>& params) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i < params.size(); i++) {
+        size_t value = params[i];
+        for (size_t j = 0; j < sizeof(size_t); j++, value >>= 8) {
+            hash ^= value & 0xff;
+            hash *= 16777619u;
+        }
+    }
+    stringstream ss;
+    ss << kernel.kernelName() << "_" << std::hex << hash;
+    return ss.str();
+}
+
+// function declarations are printed as: void name (
+static string kernelDeclaration(const KernelInterface& kernel) {
+    return " " + kernel.kernelName() + " (";
+}
+
+bool Bench::buildBatchProgram(const vector< vector<size_t> >& batch,
+                              vector<string>& batchNames) {
+    // program source with all candidates, which share build options
+    string options;
+    {
+        OCLTraceScope trace("generate source");
+        stringstream ss;
+        set<string> uniqueNames;
+        batchNames.clear();
+        for (size_t i = 0; i < batch.size(); i++) {
+            _kernel.setParams(batch[i]);
+            options = _kernel.buildOptions();
+            stringstream ks;
+            ks << _kernel;
+            string source = ks.str();
+
+            const string declName = kernelDeclaration(_kernel);
+            const string name = batchKernelName(_kernel, batch[i]);
+            const size_t pos = source.find(declName);
+
+            // candidates that can not be renamed are left to build alone
+            if (string::npos == pos || uniqueNames.count(name)) {
+                batchNames.push_back("");
+                continue;
+            }
+            source.replace(pos, declName.size(), " " + name + " (");
+            uniqueNames.insert(name);
+            batchNames.push_back(name);
+            ss << source;
+        }
+        _programSource.clear();
+        _programSource.push_back(ss.str());
+
+        // kernel buffers are sized by the arguments last set
+        if (! _lastArgs.empty()) _kernel.setParams(_lastArgs);
+    }
+
+    // build program, this replaces any previous batch
+    _batchKernel.clear();
+    return _oclApp->buildProgram(_programSource, options);
+}
+
+void Bench::bisectBatch(const vector< vector<size_t> >& batch) {
+    // a single candidate failed, recorded as if built alone
+    if (1 == batch.size()) {
+        _batchFailed.insert(batch[0]);
+        if (_journal) _journal->takeMemo(_kernel, batch[0], Journal::BUILD_IN_PROGRESS);
+        return;
+    }
+
+    const size_t half = batch.size() / 2;
+    const vector< vector<size_t> > lower(batch.begin(), batch.begin() + half);
+    const vector< vector<size_t> > upper(batch.begin() + half, batch.end());
+
+    vector<string> batchNames;
+    if (! buildBatchProgram(lower, batchNames)) bisectBatch(lower);
+    if (! buildBatchProgram(upper, batchNames)) bisectBatch(upper);
+}
+
+size_t Bench::buildBatch(const vector< vector<size_t> >& batch) {
+
+    OCLTraceScope trace("build batch");
+
+    _batchKernel.clear();
+    _batchFailed.clear();
+
+    if (replay()) return 0;
+
+    // candidates with the source of a kernel already built are not built again
+    vector< vector<size_t> > unique;
+    size_t covered = 0;
+    set<string> uniqueSource;
+    set<string> uniqueNames;
+    string batchOptions;
+    for (size_t i = 0; i < batch.size(); i++) {
+        _kernel.setParams(batch[i]);
+        const string options = _kernel.buildOptions();
+        const string hash = sourceHash(batch[i]);
+        const map< string, vector<size_t> >::const_iterator same = _sourceArgs.find(hash);
+        if (uniqueSource.count(hash) ||
+            (_sourceArgs.end() != same && batch[i] != (*same).second) ||
+            (_journal && ! _journal->memoSource(_kernel, batch[i], hash).empty())) {
+            covered++;
+            continue;
+        }
+
+        // candidates that can not be renamed are built alone by run
+        const string name = batchKernelName(_kernel, batch[i]);
+        if (string::npos == _programSource[0].find(kernelDeclaration(_kernel)) ||
+            uniqueNames.count(name))
+            break;
+
+        // one program has one set of build options, the others are built by run
+        if (unique.empty()) batchOptions = options;
+        if (options != batchOptions) break;
+        covered++;
+        uniqueSource.insert(hash);
+        uniqueNames.insert(name);
+        unique.push_back(batch[i]);
+    }
+
+    // a single candidate is built by run as usual
+    if (unique.size() < 2) return covered;
+
+    // if the compiler crashes, every candidate is built alone next time
+    if (_journal)
+        for (size_t i = 0; i < unique.size(); i++)
+            _journal->takeMemo(_kernel, unique[i], Journal::BATCH_IN_PROGRESS);
+
+    if (_printStatus) cerr << "building batch of " << unique.size() << " kernels...";
+
+    vector< vector<size_t> > good = unique;
+    vector<string> batchNames;
+    if (! buildBatchProgram(good, batchNames)) {
+        // isolate the bad candidates, then build the rest together again
+        bisectBatch(unique);
+        good.clear();
+        for (size_t i = 0; i < unique.size(); i++)
+            if (0 == _batchFailed.count(unique[i])) good.push_back(unique[i]);
+
+        if (good.empty() || ! buildBatchProgram(good, batchNames)) {
+            if (_printStatus) cerr << " failed" << endl;
+            return covered;
+        }
+    }
+
+    // kernel handles by name
+    vector<string> kernelNames;
+    const int firstHandle = _oclApp->createKernelsInProgram(kernelNames);
+    if (-1 == firstHandle) {
+        if (_printStatus) cerr << " failed" << endl;
+        return covered;
+    }
+    map<string, int> handleByName;
+    for (size_t i = 0; i < kernelNames.size(); i++)
+        handleByName[kernelNames[i]] = firstHandle + i;
+
+    for (size_t i = 0; i < good.size(); i++)
+        if (handleByName.count(batchNames[i]))
+            _batchKernel[good[i]] = handleByName[batchNames[i]];
+
+    if (_printStatus) cerr << " done (" << _batchFailed.size() << " failed)" << endl;
+
+    return covered;
+}
+
 // returns elapsed time in microseconds, 0 if error
 size_t Bench::run(const size_t numTrials,
                   const vector<size_t>& args,
@@ -181,23 +1190,79 @@ size_t Bench::run(const size_t numTrials,
                   const bool busTransferFromDevice,
                   const bool printDebug) {
 
+    OCLTraceScope trace("run");
+
     // kernel parameter arguments
     _kernel.setParams(args);
+    _lastArgs = args;
 
     if (_printStatus && printDebug) cerr << _kernel << endl;
 
-    if (_journal) _journal->takeMemo(_kernel, args, Journal::BUILD_IN_PROGRESS);
+    // replay only has what is in the journal
+    if (replay()) {
+        _missing.insert(args);
+        if (_printStatus) cout << "missing";
+        return 0;
+    }
+
+    // bad candidate isolated when its batch was built
+    if (_batchFailed.count(args)) return 0;
+
+    // identical source was built and timed already
+    const string hash = generateSource();
+    const map< string, vector<size_t> >::const_iterator same = _sourceArgs.find(hash);
+    if (_sourceArgs.end() != same && args != (*same).second) {
+        if (_journal) _journal->takeAliasMemo(_kernel, args, _journal->memoSource(_kernel, args, hash));
+        if (_printStatus) cerr << "same source\t";
+
+        // elapsed time scales with the number of trials
+        const pair<size_t, size_t>& timed = _sourceTime[hash];
+        return 0 == timed.second ? 0 : timed.first * numTrials / timed.second;
+    }
+    _sourceArgs[hash] = args;
+    _sourceTime[hash] = make_pair(0, 0);
+    if (_journal) _journal->takeSourceMemo(_kernel, args, hash);
+
+    const map< vector<size_t>, int >::const_iterator batched = _batchKernel.find(args);
+    if (_batchKernel.end() != batched) {
+        // kernel was built ahead in the batch program
+        _kernelHandle = (*batched).second;
+        if (_printStatus) cerr << "batched kernel\t";
+
+    } else {
+        if (_journal) _journal->takeMemo(_kernel, args, Journal::BUILD_IN_PROGRESS);
 
-    // kernels change depending on arguments
-    if (_printStatus) cerr << "rebuilding kernel...";
-    if (! rebuildProgram()) return 0; // build program failed
-    if (_printStatus) cerr << " done\t";
+        // kernels change depending on arguments
+        if (_printStatus) cerr << "rebuilding kernel...";
+        if (! rebuildProgram()) return 0; // build program failed
+        if (_printStatus) cerr << " done\t";
+    }
 
     if (_journal) _journal->takeMemo(_kernel, args, Journal::BUILD_OK);
 
-    // set kernel arguments (exclude PCIe bus transfer cost)
-    if (!busTransferToDevice)
-        if (!_kernel.setArgs(_oclApp, _kernelHandle, busTransferToDevice)) return 0; // fail
+    // set kernel arguments (exclude PCIe bus transfer cost, overlapped
+    // transfers are enqueued with the kernels), arguments are bound once
+    // and before deciding to overlap so the buffers are of this candidate
+    bool argsSet = false;
+    if (!busTransferToDevice || _overlapTransfers) {
+        OCLTraceScope trace("set args");
+        if (!_kernel.setArgs(*_oclApp, _kernelHandle, false)) return 0; // fail
+        argsSet = true;
+    }
+
+    // transfers in each trial overlap kernels on other queues, the trials
+    // alternate between the kernel buffers and a second set like them
+    const bool overlap = argsSet && overlapped(busTransferToDevice, busTransferFromDevice);
+    vector<size_t> inputs[2], outputs[2];
+    if (overlap) {
+        inputs[0] = _kernel.inputBuffers();
+        outputs[0] = _kernel.outputBuffers();
+        if (!shadowBuffers(inputs[0], inputs[1])) return 0; // fail
+        if (!shadowBuffers(outputs[0], outputs[1])) {
+            releaseBuffers(inputs[1]);
+            return 0; // fail
+        }
+    }
 
     // work item dimensions
     const vector<size_t> globalDims = _kernel.globalWorkItems();
@@ -212,38 +1277,57 @@ size_t Bench::run(const size_t numTrials,
         return 0; // fail
     }
 
+    const unsigned long traceStart = OCLTrace::enabled() ? OCLTrace::now() : 0;
+
     // set kernel arguments (include PCIe bus transfer cost)
-    if (busTransferToDevice)
-        if (!_kernel.setArgs(_oclApp, _kernelHandle, busTransferToDevice)) return 0; // fail
+    if (busTransferToDevice && !overlap) {
+        OCLTraceScope trace("set args");
+        if (!_kernel.setArgs(*_oclApp, _kernelHandle, busTransferToDevice)) return 0; // fail
+    }
 
-    // execute kernel for specified number of trials
-    int waitKernel;
-    for (size_t i = 0; i < numTrials; i++)
-    {
-        if (0 == i)
-            // first enqueued kernel
-            waitKernel = _oclApp.enqueueKernel(_kernelHandle, globalDims, localDims);
-        else
-            // subsequent enqueued kernels depend on previous one
-            waitKernel = _oclApp.enqueueKernel(_kernelHandle, globalDims, localDims, waitKernel);
+    if (overlap) {
+        // transfers and kernels pipelined for specified number of trials
+        const size_t overlapTrials = numTrials < OVERLAP_TRIALS ? OVERLAP_TRIALS : numTrials;
+        const bool rc = enqueueOverlapped(overlapTrials, globalDims, localDims,
+                                          busTransferToDevice, busTransferFromDevice,
+                                          inputs, outputs);
 
-        if (-1 == waitKernel) {
-            if (_printStatus) cerr << "error: enqueue kernel " << i << endl;
-            if (0 != i && !_oclApp.wait()) // blocking call
-                if (_printStatus) cerr << "error: waiting for " << (i-1) << " enqueued kernels" << endl;
-            return 0; // fail
+        // the kernel is left bound to its own buffers
+        releaseBuffers(inputs[1]);
+        releaseBuffers(outputs[1]);
+        if (!rc) return 0; // fail
+
+    } else {
+        // execute kernel for specified number of trials
+        int waitKernel;
+        for (size_t i = 0; i < numTrials; i++)
+        {
+            if (0 == i)
+                // first enqueued kernel
+                waitKernel = _oclApp->enqueueKernel(_kernelHandle, globalDims, localDims);
+            else
+                // subsequent enqueued kernels depend on previous one
+                waitKernel = _oclApp->enqueueKernel(_kernelHandle, globalDims, localDims, waitKernel);
+
+            if (-1 == waitKernel) {
+                if (_printStatus) cerr << "error: enqueue kernel " << i << endl;
+                if (0 != i && !_oclApp->wait()) // blocking call
+                    if (_printStatus) cerr << "error: waiting for " << (i-1) << " enqueued kernels" << endl;
+                return 0; // fail
+            }
         }
-    }
 
-    // wait for all kernels to finish
-    if (!_oclApp.wait(waitKernel)) { // blocking call
-        if (_printStatus) cerr << "error: waiting for all kernels" << endl;
-        return 0; // fail
+        // wait for all kernels to finish
+        if (!_oclApp->wait(waitKernel)) { // blocking call
+            if (_printStatus) cerr << "error: waiting for all kernels" << endl;
+            return 0; // fail
+        }
     }
 
     // read back output data from device (including PCIe data transfer cost)
-    if (busTransferFromDevice) {
-        if (!_kernel.syncOutput(_oclApp)) {
+    if (busTransferFromDevice && !overlap) {
+        OCLTraceScope trace("sync output");
+        if (!_kernel.syncOutput(*_oclApp)) {
             if (_printStatus) cerr << "error: read output data from device" << endl;
             return 0; // fail
         }
@@ -256,27 +1340,39 @@ size_t Bench::run(const size_t numTrials,
         return 0; // fail
     }
 
+    // the timed trials
+    if (OCLTrace::enabled()) OCLTrace::host("trials", traceStart, OCLTrace::now());
+
     // read back output data from device (excluding PCIe data transfer cost)
     if (!busTransferFromDevice) {
-        if (!_kernel.syncOutput(_oclApp)) {
+        OCLTraceScope trace("sync output");
+        if (!_kernel.syncOutput(*_oclApp)) {
             if (_printStatus) cerr << "error: read output data from device" << endl;
             return 0; // fail
         }
     }
 
     // calculate elapsed time in microseconds
-    const size_t elapsed_time
+    size_t elapsed_time
         = 1000 * 1000 * ( stop_time.tv_sec - start_time.tv_sec )
               + stop_time.tv_usec
               + (1000 * 1000 - start_time.tv_usec)
               - 1000 * 1000;
 
+    // throughput of the pipelined kernels for the trials asked for
+    if (overlap && numTrials < OVERLAP_TRIALS)
+        elapsed_time = elapsed_time * numTrials / OVERLAP_TRIALS;
+
     // allow kernel to check results, sometimes bad kernels do nothing
-    const bool isOk = _kernel.checkOutput(_oclApp, printDebug);
+    bool isOk;
+    {
+        OCLTraceScope trace("check output");
+        isOk = _kernel.checkOutput(*_oclApp, printDebug);
+    }
     if (! isOk && _printStatus) cerr << "fail";
 
     // final cleanup
-    if (!_oclApp.wait()) {
+    if (!_oclApp->wait()) {
         if (_printStatus) cerr << "error: clean up wait events" << endl;
     }
 
@@ -285,7 +1381,104 @@ size_t Bench::run(const size_t numTrials,
         _journal->takeMemo(_kernel, args, isOk ? elapsed_time : 0);
     }
 
+    _sourceTime[hash] = make_pair(isOk ? elapsed_time : 0, numTrials);
+
     return isOk ? elapsed_time : 0;
 }
 
+// nanoseconds between two gettimeofday calls
+static size_t elapsedNanosecs(const struct timeval& start_time,
+                              const struct timeval& stop_time) {
+    return 1000 * (1000 * 1000 * (stop_time.tv_sec - start_time.tv_sec)
+                       + stop_time.tv_usec - start_time.tv_usec);
+}
+
+bool Bench::latency(const size_t numCalls,
+                    const vector<size_t>& args,
+                    CallLatency& callLatency,
+                    const bool printDebug) {
+
+    OCLTraceScope trace("latency");
+
+    // kernel parameter arguments
+    _kernel.setParams(args);
+    _lastArgs = args;
+
+    if (_printStatus && printDebug) cerr << _kernel << endl;
+
+    // latency is never recorded in the journal
+    if (replay()) {
+        _missing.insert(args);
+        return false;
+    }
+
+    generateSource();
+    if (! rebuildProgram()) return false; // build program failed
+
+    // arguments are set once, buffers stay on the device
+    if (!_kernel.setArgs(*_oclApp, _kernelHandle, false)) return false; // fail
+
+    // work item dimensions
+    const vector<size_t> globalDims = _kernel.globalWorkItems();
+    const vector<size_t> localDims = _kernel.localWorkItems();
+
+    // first call is not counted, drivers may defer work until then
+    for (size_t i = 0; i <= numCalls; i++) {
+        struct timeval start_time, enqueue_time, stop_time;
+        gettimeofday(&start_time, 0);
+
+        const int waitKernel = _oclApp->enqueueKernel(_kernelHandle, globalDims, localDims);
+
+        gettimeofday(&enqueue_time, 0);
+
+        if (-1 == waitKernel) {
+            if (_printStatus) cerr << "error: enqueue kernel " << i << endl;
+            return false; // fail
+        }
+
+        if (!_oclApp->wait(waitKernel)) { // blocking call
+            if (_printStatus) cerr << "error: waiting for kernel " << i << endl;
+            return false; // fail
+        }
+
+        gettimeofday(&stop_time, 0);
+
+        // queued, submit, start, end on the device clock
+        const vector<unsigned long> times = _oclApp->profileEvent(waitKernel);
+
+        if (0 == i) continue;
+
+        callLatency.endToEnd.add(elapsedNanosecs(start_time, stop_time));
+        callLatency.enqueue.add(elapsedNanosecs(start_time, enqueue_time));
+        if (times[2] >= times[0]) callLatency.queued.add(times[2] - times[0]);
+        if (times[3] >= times[2]) callLatency.execute.add(times[3] - times[2]);
+    }
+
+    // allow kernel to check results, sometimes bad kernels do nothing
+    if (!_kernel.syncOutput(*_oclApp)) {
+        if (_printStatus) cerr << "error: read output data from device" << endl;
+        return false; // fail
+    }
+    const bool isOk = _kernel.checkOutput(*_oclApp, printDebug);
+    if (! isOk && _printStatus) cerr << "fail";
+
+    // host reference for the crossover, the first call allocates memory
+    // and slow references stop after a second
+    if (isOk && _kernel.hostReference()) {
+        OCLTraceScope trace("host reference");
+        size_t total = 0;
+        for (size_t i = 0; i < numCalls && total < 1000 * 1000 * 1000; i++) {
+            struct timeval start_time, stop_time;
+            gettimeofday(&start_time, 0);
+            _kernel.hostReference();
+            gettimeofday(&stop_time, 0);
+            const size_t nanosecs = elapsedNanosecs(start_time, stop_time);
+            callLatency.host.add(nanosecs);
+            total += nanosecs;
+        }
+    }
+
+    return isOk;
+}
+
 }; // namespace
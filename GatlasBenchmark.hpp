@@ -18,10 +18,14 @@
 //    You should have received a copy of the GNU Lesser General Public License
 //    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <istream>
 #include <map>
+#include <set>
 #include <string>
+#include <sys/types.h>
 #include <vector>
 #include "OCLApp.hpp"
+#include "GatlasStatistics.hpp"
 
 #include "declare_namespace"
 
@@ -33,12 +37,25 @@ struct KernelInterface
     // return number of flops
     virtual size_t numberFlops() const = 0;
 
+    // return number of bytes read from and written to global memory,
+    // estimated from the blocking as if nothing is cached
+    virtual size_t bytesMoved() const = 0;
+
+    // return number of bytes read from and written to local memory (estimate)
+    virtual size_t bytesMovedLocal() const { return 0; }
+
+    // size of a scalar element in bytes
+    virtual size_t elementSize() const = 0;
+
     // kernel source is parameterized
     virtual void setParams(const std::vector<size_t>& params) = 0;
 
     // kernel extra parameter by dimensions
     virtual std::vector<size_t> extraParamDetail() const = 0;
 
+    // OpenCL compiler options the kernel is built with
+    virtual std::string buildOptions() const { return ""; }
+
     // allocate buffers and set kernel matrix arguments
     virtual bool setArgs(OCLApp& oclApp, const size_t kernelHandle, const bool syncInput) = 0;
 
@@ -49,6 +66,22 @@ struct KernelInterface
     // switches on paranoid checking
     virtual void paranoidCheck() = 0;
 
+    // calculates the same problem on the host with a straightforward loop
+    // nest, the reference a device kernel must beat (false if there is none)
+    virtual bool hostReference() { return false; }
+
+    // buffers sent to and read back from the device every trial when bus
+    // transfers overlap kernel execution (none means no overlapping)
+    virtual std::vector<size_t> inputBuffers() const { return std::vector<size_t>(); }
+    virtual std::vector<size_t> outputBuffers() const { return std::vector<size_t>(); }
+
+    // bind other buffers of the same sizes in place of the input and output
+    // buffers, overlapped trials alternate between two sets of buffers
+    virtual bool setBufferArgs(OCLApp& oclApp,
+                               const size_t kernelHandle,
+                               const std::vector<size_t>& inputs,
+                               const std::vector<size_t>& outputs) { return false; }
+
     // work items
     virtual std::vector<size_t> globalWorkItems() const = 0;
     virtual std::vector<size_t> localWorkItems() const = 0;
@@ -59,28 +92,117 @@ struct KernelInterface
 
 std::ostream& operator<< (std::ostream& os, const KernelInterface& k);
 
+// identifies the device and driver so journals from many machines may be merged
+struct DeviceFingerprint
+{
+    std::string vendor;
+    std::string name;
+    std::string driver;
+    size_t      computeUnits;
+    size_t      clockFrequency;
+
+    DeviceFingerprint();
+    DeviceFingerprint(OCLApp& oclApp);
+    DeviceFingerprint(const std::string& token); // parse from str()
+
+    bool empty() const;
+
+    // one token without whitespace, used in journal keys
+    std::string str() const;
+
+    // same kind of device (vendor, name and compute units match)
+    bool compatible(const DeviceFingerprint& other) const;
+
+    // true if a is a closer match to this device than b
+    bool closer(const DeviceFingerprint& a, const DeviceFingerprint& b) const;
+};
+
 class Journal
 {
     const std::string _journalFile;
 
+    // records for one device
+    struct Memo {
+        std::map<std::string, int>                  runState;
+        std::map<std::string, std::vector<size_t> > time;
+        std::map<std::string, size_t>               device;
+        std::map<std::string, TimeStats>            stats;
+        std::map<std::string, std::string>          alias;  // duplicate key to key with identical source
+        std::map<std::string, std::string>          source; // key to hash of its kernel source
+    };
+
+    // all records in the journal by device fingerprint (empty for untagged records)
+    std::map<std::string, Memo> _memoByDevice;
+
+    // this device, written with every record and preferred for lookups
+    DeviceFingerprint _fingerprint;
+    bool              _closestDevice; // fall back to the closest compatible device
+
+    // lookup of records from this device, the closest compatible device and untagged records
     std::map<std::string, int>                  _memoRunState; // contains all param keys
     std::map<std::string, std::vector<size_t> > _memoTime;     // only contains param keys in state KERNEL_OK
+    std::map<std::string, size_t>               _memoDevice;   // device limits so replay needs no device
+    std::map<std::string, TimeStats>            _memoStats;    // summary of all times for param keys
+    std::map<std::string, std::string>          _memoAlias;    // duplicate keys share records of these keys
+    std::map<std::string, std::string>          _memoSource;   // source hash to first key built from it
+
+    // devices in lookup order, the lookups are built from these
+    std::vector<std::string> _memoOrder;
+
+    // keys of records read since the lookups were built
+    struct MemoKeys {
+        std::set<std::string>                               record; // run state, times and stats
+        std::set<std::string>                               device;
+        std::set<std::string>                               alias;
+        std::vector< std::pair<std::string, std::string> > source; // key and hash
+    };
+
+    // how much of the journal file has been read, compaction replaces the file
+    off_t _memoOffset;
+    ino_t _memoInode;
 
     std::string toString(const KernelInterface& kernel, const std::vector<size_t>& params) const;
+    std::string resolve(const std::string& key) const;
+    std::string prefix() const;
+    void selectMemo();
+    void selectMemo(const MemoKeys& keys);
+    void addMemo(const std::string& device, const std::string& key, const int value);
+    void parseMemo(std::istream& journal, MemoKeys& keys);
+    bool readMemo();
+    bool appendRecord(const std::string& key, const std::string& value);
+    bool appendMemo(const std::string& key, const int value);
 
 public:
     enum RunState { MISSING           = 0,
                     BUILD_IN_PROGRESS = -1,
                     BUILD_OK          = -2,
                     RUN_IN_PROGRESS   = -3,
-                    RUN_OK            = -4 };
+                    RUN_OK            = -4,
+                    BATCH_IN_PROGRESS = -5 }; // built with other kernels in one program
 
     Journal(const std::string& journalFile);
 
+    // records are tagged with the device, lookups prefer it and then
+    // (unless exact) the closest compatible device found in the journal
+    void setFingerprint(const DeviceFingerprint& device, const bool closestDevice = true);
+    const DeviceFingerprint& fingerprint() const;
+
+    // devices with records in the journal (assumes load memo has been called)
+    std::vector<DeviceFingerprint> fingerprints() const;
+
     // load records from memo file
     bool loadMemo();
 
+    // load only records appended since the last load (by this or other
+    // processes), everything is reloaded if the file was compacted
+    bool refreshMemo();
+
+    // add records from another journal, untagged records there are for the given device
+    void mergeMemo(const Journal& other, const DeviceFingerprint& untagged = DeviceFingerprint());
+
     // (assumes load memo has been called)
+    // records appended by other processes are picked up first, then the
+    // compacted file atomically replaces the journal
     // remove unnecessary records from memo file (kernel solutions that ran ok; keep only the last record for a key)
     // returns number of bad kernels (either crashed during build or hung while running)
     int purgeMemo(const bool deleteTimes = false);
@@ -90,35 +212,145 @@ public:
     int    memoRunState(const KernelInterface& kernel, const std::vector<size_t>& params);
     int    memoTime(const KernelInterface& kernel, const std::vector<size_t>& params, const size_t trialNumber);
 
-    // write to memo file
-    bool takeMemo(const KernelInterface& kernel, const std::vector<size_t>& params, const int value) const;
+    // summary of every time recorded for a kernel (zero count if none),
+    // times of zero mark kernels that failed the output check and are left out
+    TimeStats memoStats(const KernelInterface& kernel, const std::vector<size_t>& params) const;
+
+    // write to memo file, the memo is updated too so there is no need to reload
+    bool takeMemo(const KernelInterface& kernel, const std::vector<size_t>& params, const int value);
+
+    // kernels built from identical source share records: the key of a
+    // different kernel already built from the source, empty if none
+    std::string memoSource(const KernelInterface& kernel,
+                           const std::vector<size_t>& params,
+                           const std::string& sourceHash) const;
+    bool takeSourceMemo(const KernelInterface& kernel,
+                        const std::vector<size_t>& params,
+                        const std::string& sourceHash);
+
+    // records of the kernel are read from and written to the other key
+    bool takeAliasMemo(const KernelInterface& kernel,
+                       const std::vector<size_t>& params,
+                       const std::string& key);
+
+    // device limits used to enumerate kernel parameters, -1 if not in memo
+    int  memoDevice(const std::string& name) const;
+    bool takeDeviceMemo(const std::string& name, const size_t value);
+};
+
+// per call latency in nanoseconds with the kernel built, arguments set and
+// buffers resident on the device, as a library caller sees it
+struct CallLatency
+{
+    TimeStats endToEnd; // enqueue call until the wait returns
+    TimeStats enqueue;  // host time in the enqueue call
+    TimeStats queued;   // device queued until execution starts
+    TimeStats execute;  // device execution start to end
+    TimeStats host;     // host reference calculation
 };
 
 class Bench
 {
-    OCLApp&                  _oclApp;
+    OCLApp*                  _oclApp;   // NULL when replaying the journal
     KernelInterface&         _kernel;
     Journal*                 _journal;
     std::vector<std::string> _programSource;
     int                      _kernelHandle;
 
     const bool               _printStatus;
+    bool                     _overlapTransfers;
+
+    std::set< std::vector<size_t> > _missing; // replay parameters not in journal
+
+    // many candidates compiled together in one program
+    size_t                                 _batchSize;
+    std::map< std::vector<size_t>, int >   _batchKernel; // kernel handles of the built batch
+    std::set< std::vector<size_t> >        _batchFailed; // isolated by bisection
+    std::vector<size_t>                    _lastArgs;    // kernel arguments last set
+
+    // candidates with identical source are built and timed once
+    std::map< std::string, std::vector<size_t> > _sourceArgs; // first candidate with the source
+    std::map< std::string, std::pair<size_t, size_t> > _sourceTime; // and its last elapsed time over trials
+
+    // program source for the kernel parameters, returns a hash of it with
+    // the work items and problem size
+    std::string generateSource();
+    std::string sourceHash(const std::vector<size_t>& args);
 
     bool rebuildProgram();
 
+    // one program with every candidate, kernels renamed by parameters
+    bool buildBatchProgram(const std::vector< std::vector<size_t> >& batch,
+                           std::vector<std::string>& batchNames);
+
+    // find the candidates that do not build alone by bisection
+    void bisectBatch(const std::vector< std::vector<size_t> >& batch);
+
+    // bus transfers on copy queues while kernels run on the compute queue
+    bool overlapped(const bool busTransferToDevice,
+                    const bool busTransferFromDevice) const;
+    bool enqueueOverlapped(const size_t numTrials,
+                           const std::vector<size_t>& globalDims,
+                           const std::vector<size_t>& localDims,
+                           const bool busTransferToDevice,
+                           const bool busTransferFromDevice,
+                           const std::vector<size_t> inputs[2],
+                           const std::vector<size_t> outputs[2]);
+
+    // second set of buffers for overlapped trials, same contents as the first
+    bool shadowBuffers(const std::vector<size_t>& handles,
+                       std::vector<size_t>& shadows);
+    void releaseBuffers(const std::vector<size_t>& handles);
+
 public:
 
     Bench(OCLApp& oclApp, KernelInterface& kernel, const bool printStatus = true);
     Bench(OCLApp& oclApp, KernelInterface& kernel, Journal& journal, const bool printStatus = true);
 
+    // NULL OpenCL application replays times from the journal without a device
+    Bench(OCLApp* oclApp, KernelInterface& kernel, Journal& journal, const bool printStatus = true);
+
     bool printStatus() const;
 
-    // returns elapsed time in microseconds, 0 if error
+    // kernel parameters that could not be replayed
+    bool replay() const;
+    const std::set< std::vector<size_t> >& missing() const;
+
+    // every trial transfers data over the bus concurrently with kernels
+    // (requires an OCLApp with multiple queues), a run pipelines at least
+    // four trials and reports the time of the trials asked for
+    void overlapTransfers(const bool enable);
+
+    // compile up to this many candidates in one program (default is 1),
+    // each kernel name is suffixed with a hash of its parameters
+    void batchSize(const size_t size);
+    size_t batchSize() const;
+
+    // build candidates ahead of running them, if the batch fails it is
+    // bisected so a bad candidate is built and recorded in the journal
+    // alone, the batch stops before the first candidate that must be built
+    // alone as that replaces the batch program, returns number of leading
+    // candidates covered by the batch
+    size_t buildBatch(const std::vector< std::vector<size_t> >& batch);
+
+    // true if the kernel source is identical to a kernel already built,
+    // recorded in the journal as an alias so it shares the records of that
+    // kernel and is never built again
+    bool alias(const std::vector<size_t>& args);
+
+    // returns elapsed time in microseconds, 0 if error (or replaying)
     size_t run(const size_t numTrials,
                const std::vector<size_t>& args,
                const bool busTransferToDevice,
                const bool busTransferFromDevice,
                const bool printDebug = false);
+
+    // per call latency of small problems with nothing but the kernel
+    // enqueued and waited on each call, false if error (or replaying)
+    bool latency(const size_t numCalls,
+                 const std::vector<size_t>& args,
+                 CallLatency& callLatency,
+                 const bool printDebug = false);
 };
 
 }; // namespace
@@ -28,44 +28,61 @@ std::ostream& operator<< (std::ostream& os, const Printable& v) {
 ///////////////////////////////////////////////////////////////////////////////
 // constants and value transformations
 
+const ExprNode* Value::node() const {
+    return ExprArena::current().text(name());
+}
+
+ConstantValue<std::string>::ConstantValue(const std::string& value)
+    : _node(ExprArena::current().text(value))
+    { }
+
+ConstantValue<std::string>::ConstantValue(const Value& value)
+    : _node(value.node())
+    { }
+
+ConstantValue<std::string>::ConstantValue(const ExprNode* node)
+    : _node(node)
+    { }
+
+std::string ConstantValue<std::string>::name() const { return str(*_node); }
+const ExprNode* ConstantValue<std::string>::node() const { return _node; }
+
 DerefValue::DerefValue(const Value& value) : _value(value) { }
-std::string DerefValue::name() const {
-    std::stringstream ss;
-    ss << "*" << _value.name();
-    return ss.str();
+std::string DerefValue::name() const { return str(*node()); }
+const ExprNode* DerefValue::node() const {
+    return ExprArena::current().prefix("*", _value.node());
 }
 
 ConstantValue<std::string> operator* (const Value& right) {
-    return ConstantValue<std::string>(DerefValue(right).name());
+    return ConstantValue<std::string>(DerefValue(right).node());
 }
 
 PostIncValue::PostIncValue(const Value& value) : _value(value) { }
-std::string PostIncValue::name() const {
-    std::stringstream ss;
-    ss << _value.name() << "++";
-    return ss.str();
+std::string PostIncValue::name() const { return str(*node()); }
+const ExprNode* PostIncValue::node() const {
+    return ExprArena::current().postfix("++", _value.node());
 }
 
 ConstantValue<std::string> operator++ (const Value& left, int dummy) {
-    return ConstantValue<std::string>(PostIncValue(left).name());
+    return ConstantValue<std::string>(PostIncValue(left).node());
 }
 
-std::string BinOpValue::left() const {
-    if (_left) return _left->name();
-    else return as_string<size_t>(_numLeft);
+const ExprNode* BinOpValue::leftNode() const {
+    if (_left) return _left->node();
+    else return ExprArena::current().number(_numLeft);
 }
 
-std::string BinOpValue::right() const {
-    if (_right) return _right->name();
-    else return as_string<size_t>(_numRight);
+const ExprNode* BinOpValue::rightNode() const {
+    if (_right) return _right->node();
+    else return ExprArena::current().number(_numRight);
 }
 
-std::string BinOpValue::value(const std::string& op) const {
-    std::stringstream ss;
-    ss << "(" << left() << op << right() << ")";
-    return ss.str();
+const ExprNode* BinOpValue::value(const char *op) const {
+    return ExprArena::current().binary(op, leftNode(), rightNode());
 }
 
+std::string BinOpValue::name() const { return str(*node()); }
+
 BinOpValue::BinOpValue(const Value& left, const Value& right)
     : _left(&left),
       _right(&right),
@@ -91,48 +108,56 @@ AddValue::AddValue(const Value& left, const Value& right) : BinOpValue(left, rig
 AddValue::AddValue(const Value& left, const size_t right) : BinOpValue(left, right) { }
 AddValue::AddValue(const size_t left, const Value& right) : BinOpValue(left, right) { }
 
-std::string AddValue::name() const {
-    if ("0" == left()) return right();
-    else if ("0" == right()) return left();
-    else return value(" + ");
+const ExprNode* AddValue::node() const {
+    const ExprNode* l = leftNode();
+    const ExprNode* r = rightNode();
+    if (l->isLiteral(0)) return r;
+    else if (r->isLiteral(0)) return l;
+    else return ExprArena::current().binary(" + ", l, r);
 }
 
 SubValue::SubValue(const Value& left, const Value& right) : BinOpValue(left, right) { }
 SubValue::SubValue(const Value& left, const size_t right) : BinOpValue(left, right) { }
 SubValue::SubValue(const size_t left, const Value& right) : BinOpValue(left, right) { }
 
-std::string SubValue::name() const {
-    if ("0" == right()) return left();
-    else return value(" - ");
+const ExprNode* SubValue::node() const {
+    const ExprNode* l = leftNode();
+    const ExprNode* r = rightNode();
+    if (r->isLiteral(0)) return l;
+    else return ExprArena::current().binary(" - ", l, r);
 }
 
 MulValue::MulValue(const Value& left, const Value& right) : BinOpValue(left, right) { }
 MulValue::MulValue(const Value& left, const size_t right) : BinOpValue(left, right) { }
 MulValue::MulValue(const size_t left, const Value& right) : BinOpValue(left, right) { }
 
-std::string MulValue::name() const {
-    if ("1" == left()) return right();
-    else if ("1" == right()) return left();
-    else if ("0" == left()) return left();
-    else if ("0" == right()) return right();
-    else return value(" * ");
+const ExprNode* MulValue::node() const {
+    const ExprNode* l = leftNode();
+    const ExprNode* r = rightNode();
+    if (l->isLiteral(1)) return r;
+    else if (r->isLiteral(1)) return l;
+    else if (l->isLiteral(0)) return l;
+    else if (r->isLiteral(0)) return r;
+    else return ExprArena::current().binary(" * ", l, r);
 }
 
 DivValue::DivValue(const Value& left, const Value& right) : BinOpValue(left, right) { }
 DivValue::DivValue(const Value& left, const size_t right) : BinOpValue(left, right) { }
 DivValue::DivValue(const size_t left, const Value& right) : BinOpValue(left, right) { }
 
-std::string DivValue::name() const {
-    if ("1" == right()) return left();
-    else if ("0" == left()) return left();
-    else return value(" / ");
+const ExprNode* DivValue::node() const {
+    const ExprNode* l = leftNode();
+    const ExprNode* r = rightNode();
+    if (r->isLiteral(1)) return l;
+    else if (l->isLiteral(0)) return l;
+    else return ExprArena::current().binary(" / ", l, r);
 }
 
 ModValue::ModValue(const Value& left, const Value& right) : BinOpValue(left, right) { }
 ModValue::ModValue(const Value& left, const size_t right) : BinOpValue(left, right) { }
 ModValue::ModValue(const size_t left, const Value& right) : BinOpValue(left, right) { }
 
-std::string ModValue::name() const {
+const ExprNode* ModValue::node() const {
     return value("%");
 }
 
@@ -140,7 +165,7 @@ RightShiftValue::RightShiftValue(const Value& left, const Value& right) : BinOpV
 RightShiftValue::RightShiftValue(const Value& left, const size_t right) : BinOpValue(left, right) { }
 RightShiftValue::RightShiftValue(const size_t left, const Value& right) : BinOpValue(left, right) { }
 
-std::string RightShiftValue::name() const {
+const ExprNode* RightShiftValue::node() const {
     return value(">>");
 }
 
@@ -148,78 +173,114 @@ LeftShiftValue::LeftShiftValue(const Value& left, const Value& right) : BinOpVal
 LeftShiftValue::LeftShiftValue(const Value& left, const size_t right) : BinOpValue(left, right) { }
 LeftShiftValue::LeftShiftValue(const size_t left, const Value& right) : BinOpValue(left, right) { }
 
-std::string LeftShiftValue::name() const {
+const ExprNode* LeftShiftValue::node() const {
     return value("<<");
 }
 
+BitAndValue::BitAndValue(const Value& left, const Value& right) : BinOpValue(left, right) { }
+BitAndValue::BitAndValue(const Value& left, const size_t right) : BinOpValue(left, right) { }
+BitAndValue::BitAndValue(const size_t left, const Value& right) : BinOpValue(left, right) { }
+
+const ExprNode* BitAndValue::node() const {
+    return value("&");
+}
+
+BitXorValue::BitXorValue(const Value& left, const Value& right) : BinOpValue(left, right) { }
+BitXorValue::BitXorValue(const Value& left, const size_t right) : BinOpValue(left, right) { }
+BitXorValue::BitXorValue(const size_t left, const Value& right) : BinOpValue(left, right) { }
+
+const ExprNode* BitXorValue::node() const {
+    return value("^");
+}
+
 ConstantValue<std::string> operator+ (const Value& left, const Value& right) {
-    return ConstantValue<std::string>(AddValue(left, right).name());
+    return ConstantValue<std::string>(AddValue(left, right).node());
 }
 ConstantValue<std::string> operator+ (const Value& left, const size_t right) {
-    return ConstantValue<std::string>(AddValue(left, right).name());
+    return ConstantValue<std::string>(AddValue(left, right).node());
 }
 ConstantValue<std::string> operator+ (const size_t left, const Value& right) {
-    return ConstantValue<std::string>(AddValue(left, right).name());
+    return ConstantValue<std::string>(AddValue(left, right).node());
 }
 
 ConstantValue<std::string> operator- (const Value& left, const Value& right) {
-    return ConstantValue<std::string>(SubValue(left, right).name());
+    return ConstantValue<std::string>(SubValue(left, right).node());
 }
 ConstantValue<std::string> operator- (const Value& left, const size_t right) {
-    return ConstantValue<std::string>(SubValue(left, right).name());
+    return ConstantValue<std::string>(SubValue(left, right).node());
 }
 ConstantValue<std::string> operator- (const size_t left, const Value& right) {
-    return ConstantValue<std::string>(SubValue(left, right).name());
+    return ConstantValue<std::string>(SubValue(left, right).node());
 }
 
 ConstantValue<std::string> operator* (const Value& left, const Value& right) {
-    return ConstantValue<std::string>(MulValue(left, right).name());
+    return ConstantValue<std::string>(MulValue(left, right).node());
 }
 ConstantValue<std::string> operator* (const Value& left, const size_t right) {
-    return ConstantValue<std::string>(MulValue(left, right).name());
+    return ConstantValue<std::string>(MulValue(left, right).node());
 }
 ConstantValue<std::string> operator* (const size_t left, const Value& right) {
-    return ConstantValue<std::string>(MulValue(left, right).name());
+    return ConstantValue<std::string>(MulValue(left, right).node());
 }
 
 ConstantValue<std::string> operator/ (const Value& left, const Value& right) {
-    return ConstantValue<std::string>(DivValue(left, right).name());
+    return ConstantValue<std::string>(DivValue(left, right).node());
 }
 ConstantValue<std::string> operator/ (const Value& left, const size_t right) {
-    return ConstantValue<std::string>(DivValue(left, right).name());
+    return ConstantValue<std::string>(DivValue(left, right).node());
 }
 ConstantValue<std::string> operator/ (const size_t left, const Value& right) {
-    return ConstantValue<std::string>(DivValue(left, right).name());
+    return ConstantValue<std::string>(DivValue(left, right).node());
 }
 
 ConstantValue<std::string> operator% (const Value& left, const Value& right) {
-    return ConstantValue<std::string>(ModValue(left, right).name());
+    return ConstantValue<std::string>(ModValue(left, right).node());
 }
 ConstantValue<std::string> operator% (const Value& left, const size_t right) {
-    return ConstantValue<std::string>(ModValue(left, right).name());
+    return ConstantValue<std::string>(ModValue(left, right).node());
 }
 ConstantValue<std::string> operator% (const size_t left, const Value& right) {
-    return ConstantValue<std::string>(ModValue(left, right).name());
+    return ConstantValue<std::string>(ModValue(left, right).node());
 }
 
 ConstantValue<std::string> operator>> (const Value& left, const Value& right) {
-    return ConstantValue<std::string>(RightShiftValue(left, right).name());
+    return ConstantValue<std::string>(RightShiftValue(left, right).node());
 }
 ConstantValue<std::string> operator>> (const Value& left, const size_t right) {
-    return ConstantValue<std::string>(RightShiftValue(left, right).name());
+    return ConstantValue<std::string>(RightShiftValue(left, right).node());
 }
 ConstantValue<std::string> operator>> (const size_t left, const Value& right) {
-    return ConstantValue<std::string>(RightShiftValue(left, right).name());
+    return ConstantValue<std::string>(RightShiftValue(left, right).node());
 }
 
 ConstantValue<std::string> operator<< (const Value& left, const Value& right) {
-    return ConstantValue<std::string>(LeftShiftValue(left, right).name());
+    return ConstantValue<std::string>(LeftShiftValue(left, right).node());
 }
 ConstantValue<std::string> operator<< (const Value& left, const size_t right) {
-    return ConstantValue<std::string>(LeftShiftValue(left, right).name());
+    return ConstantValue<std::string>(LeftShiftValue(left, right).node());
 }
 ConstantValue<std::string> operator<< (const size_t left, const Value& right) {
-    return ConstantValue<std::string>(LeftShiftValue(left, right).name());
+    return ConstantValue<std::string>(LeftShiftValue(left, right).node());
+}
+
+ConstantValue<std::string> operator& (const Value& left, const Value& right) {
+    return ConstantValue<std::string>(BitAndValue(left, right).node());
+}
+ConstantValue<std::string> operator& (const Value& left, const size_t right) {
+    return ConstantValue<std::string>(BitAndValue(left, right).node());
+}
+ConstantValue<std::string> operator& (const size_t left, const Value& right) {
+    return ConstantValue<std::string>(BitAndValue(left, right).node());
+}
+
+ConstantValue<std::string> operator^ (const Value& left, const Value& right) {
+    return ConstantValue<std::string>(BitXorValue(left, right).node());
+}
+ConstantValue<std::string> operator^ (const Value& left, const size_t right) {
+    return ConstantValue<std::string>(BitXorValue(left, right).node());
+}
+ConstantValue<std::string> operator^ (const size_t left, const Value& right) {
+    return ConstantValue<std::string>(BitXorValue(left, right).node());
 }
 
 MADValue::MADValue(const Value& a, const Value& b, const Value& c)
@@ -243,13 +304,14 @@ MADValue::MADValue(const std::string& a, const std::string& b, const Value& c)
       _useStrings(true)
     { }
 
-std::string MADValue::name() const {
-    std::stringstream ss;
+std::string MADValue::name() const { return str(*node()); }
+
+const ExprNode* MADValue::node() const {
+    ExprArena& arena = ExprArena::current();
     if (_useStrings)
-        ss << "mad(" << _aStr << ", " << _bStr << ", " << _cStr << ")";
+        return arena.call("mad", arena.text(_aStr), arena.text(_bStr), arena.text(_cStr));
     else
-        ss << "mad(" << _a->name() << ", " << _b->name() << ", " << _c->name() << ")";
-    return ss.str();
+        return arena.call("mad", _a->node(), _b->node(), _c->node());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -317,9 +379,17 @@ std::ostream& WorkItems::print(std::ostream& os) const {
 
 WorkItemGlobalSize::WorkItemGlobalSize(const size_t dimindex) : _dimindex(dimindex) { }
 std::string WorkItemGlobalSize::name() const { return func_string<size_t>("get_global_size", _dimindex); }
+const ExprNode* WorkItemGlobalSize::node() const {
+    ExprArena& arena = ExprArena::current();
+    return arena.call("get_global_size", arena.number(_dimindex));
+}
 
 WorkItemLocalSize::WorkItemLocalSize(const size_t dimindex) : _dimindex(dimindex) { }
 std::string WorkItemLocalSize::name() const { return func_string<size_t>("get_local_size", _dimindex); }
+const ExprNode* WorkItemLocalSize::node() const {
+    ExprArena& arena = ExprArena::current();
+    return arena.call("get_local_size", arena.number(_dimindex));
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // special things like barriers and loops
@@ -349,7 +419,7 @@ ForLoop::ForLoop(const Variable& index, const size_t limit, const size_t step, I
 std::ostream& ForLoop::print(std::ostream& os) const {
     os << _indent << "for (int " << _index.name() << " = 0; " << _index.name() << " < ";
     if (_limit) {
-        os << _limit->name();
+        os << *_limit->node();
     } else {
         os << _numLimit;
     }
@@ -372,7 +442,7 @@ IfThen::IfThen(const Value& lhs, const std::string& op, const Value& rhs, Indent
     { }
 
 std::ostream& IfThen::print(std::ostream& os) const {
-    os << _indent << "if (" << _lhs.name() << " " << _op << " " << _rhs.name() << ")" << std::endl
+    os << _indent << "if (" << *_lhs.node() << " " << _op << " " << *_rhs.node() << ")" << std::endl
        << _indent << "{" << std::endl;
     _indent.more();
     return os;
@@ -387,9 +457,10 @@ std::ostream& EndBlock::print(std::ostream& os) const {
 // required sampler settings for 2D images
 // use like this: Var< const sampler_t > sampler;
 //                os << declare(sampler, ImageSampler());
-std::string ImageSampler::name() const {
-    return "CLK_FILTER_NEAREST | CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_NONE";
-}
+static const char *IMAGE_SAMPLER = "CLK_FILTER_NEAREST | CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_NONE";
+
+std::string ImageSampler::name() const { return IMAGE_SAMPLER; }
+const ExprNode* ImageSampler::node() const { return ExprArena::current().literal(IMAGE_SAMPLER); }
 
 ///////////////////////////////////////////////////////////////////////////////
 // declaring, assigning and incrementing variables
@@ -402,7 +473,7 @@ std::string declare(const Variable& lhs, const Indent& indent) {
 
 std::string declare(const Variable& lhs, const Value& rhs, const Indent& indent) {
     std::stringstream ss;
-    ss << indent << lhs.declaredName() << " = " << rhs.name() << ";" << std::endl;
+    ss << indent << lhs.declaredName() << " = " << *rhs.node() << ";" << std::endl;
     return ss.str();
 }
 
@@ -412,7 +483,7 @@ std::string declare(const Variable& lhs, const size_t rhs, const Indent& indent)
 
 std::string assign(const std::string& lhs, const Value& rhs, const Indent& indent) {
     std::stringstream ss;
-    ss << indent << lhs << " = " << rhs.name() << ";" << std::endl;
+    ss << indent << lhs << " = " << *rhs.node() << ";" << std::endl;
     return ss.str();
 }
 
@@ -422,7 +493,7 @@ std::string assign(const std::string& lhs, const size_t rhs, const Indent& inden
 
 std::string assign(const Value& lhs, const Value& rhs, const Indent& indent) {
     std::stringstream ss;
-    ss << indent << lhs.name() << " = " << rhs.name() << ";" << std::endl;
+    ss << indent << *lhs.node() << " = " << *rhs.node() << ";" << std::endl;
     return ss.str();
 }
 
@@ -432,7 +503,7 @@ std::string assign(const Value& lhs, const size_t rhs, const Indent& indent) {
 
 std::string increment(const std::string& lhs, const Value& rhs, const Indent& indent) {
     std::stringstream ss;
-    ss << indent << lhs << " += " << rhs.name() << ";" << std::endl;
+    ss << indent << lhs << " += " << *rhs.node() << ";" << std::endl;
     return ss.str();
 }
 
@@ -442,7 +513,7 @@ std::string increment(const std::string& lhs, const size_t rhs, const Indent& in
 
 std::string increment(const Variable& lhs, const Value& rhs, const Indent& indent) {
     std::stringstream ss;
-    ss << indent << lhs.name() << " += " << rhs.name() << ";" << std::endl;
+    ss << indent << lhs.name() << " += " << *rhs.node() << ";" << std::endl;
     return ss.str();
 }
 
@@ -23,6 +23,7 @@
 #include <string>
 #include <vector>
 #include "OCLUtil.hpp"
+#include "GatlasExpression.hpp"
 #include "GatlasFormatting.hpp"
 #include "GatlasOperator.hpp"
 #include "GatlasQualifier.hpp"
@@ -36,6 +37,9 @@
 struct Value
 {
     virtual std::string name() const = 0;
+
+    // expression tree, just the formatted name unless overridden
+    virtual const ExprNode* node() const;
 };
 
 struct Variable : public Value
@@ -72,16 +76,28 @@ public:
     }
 };
 
+// string constants are expression trees, operators on values build these
+template <>
+class ConstantValue<std::string> : public Value
+{
+    const ExprNode* _node;
+public:
+    ConstantValue(const std::string& value);
+    ConstantValue(const Value& value);
+    ConstantValue(const ExprNode* node);
+    std::string name() const;
+    const ExprNode* node() const;
+};
+
 template <typename T>
 class CastValue : public Value
 {
     const Value& _value;
 public:
     CastValue(const Value& value) : _value(value) { }
-    std::string name() const {
-        std::stringstream ss;
-        ss << "(" << castto<T>() << ")(" << _value.name() << ")";
-        return ss.str();
+    std::string name() const { return str(*node()); }
+    const ExprNode* node() const {
+        return ExprArena::current().cast(castto<T>(), _value.node());
     }
 };
 
@@ -92,13 +108,12 @@ class ReinterpretValue : public Value
     const bool _doApply;
 public:
     ReinterpretValue(const Value& value, const bool doApply = true) : _value(value), _doApply(doApply) { }
-    std::string name() const {
-        std::stringstream ss;
+    std::string name() const { return str(*node()); }
+    const ExprNode* node() const {
         if (_doApply)
-            ss << "as_" << nameof<SCALAR, VECTOR_LENGTH>() << "(" << _value.name() << ")";
+            return ExprArena::current().call("as_" + nameof<SCALAR, VECTOR_LENGTH>(), _value.node());
         else
-            ss << _value.name();
-        return ss.str();
+            return _value.node();
     }
 };
 
@@ -108,6 +123,7 @@ class DerefValue : public Value
 public:
     DerefValue(const Value& value);
     std::string name() const;
+    const ExprNode* node() const;
 };
 
 ConstantValue<std::string> operator* (const Value& right);
@@ -118,6 +134,7 @@ class PostIncValue : public Value
 public:
     PostIncValue(const Value& value);
     std::string name() const;
+    const ExprNode* node() const;
 };
 
 ConstantValue<std::string> operator++ (const Value& left, int dummy);
@@ -130,16 +147,17 @@ class BinOpValue : public Value
     const size_t _numRight;
 
 protected:
-    std::string left() const;
-    std::string right() const;
-    std::string value(const std::string& op) const;
+    const ExprNode* leftNode() const;
+    const ExprNode* rightNode() const;
+    const ExprNode* value(const char *op) const;
 
     BinOpValue(const Value& left, const Value& right);
     BinOpValue(const Value& left, const size_t right);
     BinOpValue(const size_t left, const Value& right);
 
 public:
-    virtual std::string name() const = 0;
+    std::string name() const;
+    virtual const ExprNode* node() const = 0;
 };
 
 struct AddValue : public BinOpValue
@@ -148,7 +166,7 @@ struct AddValue : public BinOpValue
     AddValue(const Value& left, const size_t right);
     AddValue(const size_t left, const Value& right);
 
-    std::string name() const;
+    const ExprNode* node() const;
 };
 
 struct SubValue : public BinOpValue
@@ -157,7 +175,7 @@ struct SubValue : public BinOpValue
     SubValue(const Value& left, const size_t right);
     SubValue(const size_t left, const Value& right);
 
-    std::string name() const;
+    const ExprNode* node() const;
 };
 
 struct MulValue : public BinOpValue
@@ -166,7 +184,7 @@ struct MulValue : public BinOpValue
     MulValue(const Value& left, const size_t right);
     MulValue(const size_t left, const Value& right);
 
-    std::string name() const;
+    const ExprNode* node() const;
 };
 
 struct DivValue : public BinOpValue
@@ -175,7 +193,7 @@ struct DivValue : public BinOpValue
     DivValue(const Value& left, const size_t right);
     DivValue(const size_t left, const Value& right);
 
-    std::string name() const;
+    const ExprNode* node() const;
 };
 
 struct ModValue : public BinOpValue
@@ -184,7 +202,7 @@ struct ModValue : public BinOpValue
     ModValue(const Value& left, const size_t right);
     ModValue(const size_t left, const Value& right);
 
-    std::string name() const;
+    const ExprNode* node() const;
 };
 
 struct RightShiftValue : public BinOpValue
@@ -193,7 +211,7 @@ struct RightShiftValue : public BinOpValue
     RightShiftValue(const Value& left, const size_t right);
     RightShiftValue(const size_t left, const Value& right);
 
-    std::string name() const;
+    const ExprNode* node() const;
 };
 
 struct LeftShiftValue : public BinOpValue
@@ -202,7 +220,25 @@ struct LeftShiftValue : public BinOpValue
     LeftShiftValue(const Value& left, const size_t right);
     LeftShiftValue(const size_t left, const Value& right);
 
-    std::string name() const;
+    const ExprNode* node() const;
+};
+
+struct BitAndValue : public BinOpValue
+{
+    BitAndValue(const Value& left, const Value& right);
+    BitAndValue(const Value& left, const size_t right);
+    BitAndValue(const size_t left, const Value& right);
+
+    const ExprNode* node() const;
+};
+
+struct BitXorValue : public BinOpValue
+{
+    BitXorValue(const Value& left, const Value& right);
+    BitXorValue(const Value& left, const size_t right);
+    BitXorValue(const size_t left, const Value& right);
+
+    const ExprNode* node() const;
 };
 
 ConstantValue<std::string> operator+ (const Value& left, const Value& right);
@@ -233,6 +269,14 @@ ConstantValue<std::string> operator<< (const Value& left, const Value& right);
 ConstantValue<std::string> operator<< (const Value& left, const size_t right);
 ConstantValue<std::string> operator<< (const size_t left, const Value& right);
 
+ConstantValue<std::string> operator& (const Value& left, const Value& right);
+ConstantValue<std::string> operator& (const Value& left, const size_t right);
+ConstantValue<std::string> operator& (const size_t left, const Value& right);
+
+ConstantValue<std::string> operator^ (const Value& left, const Value& right);
+ConstantValue<std::string> operator^ (const Value& left, const size_t right);
+ConstantValue<std::string> operator^ (const size_t left, const Value& right);
+
 // MAD operation
 class MADValue : public Value
 {
@@ -252,6 +296,7 @@ public:
     MADValue(const std::string& a, const std::string& b, const Value& c);
 
     std::string name() const;
+    const ExprNode* node() const;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -377,6 +422,13 @@ public:
         }
     }
 
+    const ExprNode* node() const {
+        if (_inlineValue)
+            return ExprArena::current().number(_value);
+        else
+            return ExprArena::current().text(_identifier);
+    }
+
     std::string declaredName() const {
         std::stringstream ss;
         ss << _qualifier << nameof<T>() << " " << name();
@@ -415,6 +467,7 @@ class WorkItemGlobalSize : public Value
 public:
     WorkItemGlobalSize(const size_t dimindex);
     std::string name() const;
+    const ExprNode* node() const;
 };
 
 class WorkItemLocalSize : public Value
@@ -423,6 +476,7 @@ class WorkItemLocalSize : public Value
 public:
     WorkItemLocalSize(const size_t dimindex);
     std::string name() const;
+    const ExprNode* node() const;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -475,6 +529,7 @@ public:
 struct ImageSampler : public Value
 {
     std::string name() const;
+    const ExprNode* node() const;
 };
 
 // read float and uint32 quad from a 2D image
@@ -497,14 +552,14 @@ public:
           _y(y)
     { }
 
-    std::string name() const {
-        std::stringstream ss;
-        ss << (isfloat<T>() ? "read_imagef(" : "read_imageui(")
-           << _image.name() << ", "
-           << _sampler.name() << ", (int2)("
-           << _x.name() << ", "
-           << _y.name() << "))";
-        return ss.str();
+    std::string name() const { return str(*node()); }
+
+    const ExprNode* node() const {
+        ExprArena& arena = ExprArena::current();
+        return arena.call(isfloat<T>() ? "read_imagef" : "read_imageui",
+                          _image.node(),
+                          _sampler.node(),
+                          arena.cast("int2", _x.node(), _y.node()));
     }
 };
 
@@ -534,9 +589,9 @@ public:
         return endline(os << _indent
                           << (isfloat<T>() ? "write_imagef(" : "write_imageui(")
                           << _image.name() << ", (int2)("
-                          << _x.name() << ", "
-                          << _y.name() << "), "
-                          << _value.name()
+                          << *_x.node() << ", "
+                          << *_y.node() << "), "
+                          << *_value.node()
                           << ")");
     }
 };
@@ -810,9 +865,10 @@ std::string declare(const VectorInterface<T>& lhs, const Indent& indent = Indent
 
 template <typename T>
 std::string declare(const VectorInterface<T>& lhs, const Value& rhs, const Indent& indent = Indent::obj()) {
+    const ExprNode* rhsNode = rhs.node();
     std::stringstream ss;
     for (size_t i = 0; i < lhs.length(); i++) {
-        ss << indent << lhs.declaredName(i) << " = " << rhs.name() << ";" << std::endl;
+        ss << indent << lhs.declaredName(i) << " = " << *rhsNode << ";" << std::endl;
     }
     return ss.str();
 }
@@ -824,18 +880,32 @@ std::string declare(const VectorInterface<T>& lhs, const size_t rhs, const Inden
 
 template <typename T>
 std::string declare(const VectorInterface<T>& lhs, const Value& rhs, const Value& step, const Indent& indent = Indent::obj()) {
+    const ExprNode* stepNode = step.node();
     std::stringstream ss;
     for (size_t i = 0; i < lhs.length(); i++) {
         ss << indent << lhs.declaredName(i) << " = ";
         if (0 == i)
-            ss << rhs.name();
+            ss << *rhs.node();
         else
-            ss << lhs.name(i-1) << " + " << step.name();
+            ss << lhs.name(i-1) << " + " << *stepNode;
         ss << ";" << std::endl;
     }
     return ss.str();
 }
 
+// declares a named local for a loop invariant value and returns the name to
+// use in its place, or returns the value unchanged when not hoisting
+template <typename T>
+ConstantValue<std::string> hoist(std::ostream& os,
+                                 const Var<T>& lhs,
+                                 const Value& rhs,
+                                 const bool doHoist,
+                                 const Indent& indent = Indent::obj()) {
+    if (! doHoist) return ConstantValue<std::string>(rhs);
+    os << declare(lhs, rhs, indent);
+    return ConstantValue<std::string>(lhs);
+}
+
 std::string assign(const std::string& lhs, const Value& rhs, const Indent& indent = Indent::obj());
 std::string assign(const std::string& lhs, const size_t rhs, const Indent& indent = Indent::obj());
 std::string assign(const Value& lhs, const Value& rhs, const Indent& indent = Indent::obj());
@@ -843,9 +913,10 @@ std::string assign(const Value& lhs, const size_t rhs, const Indent& indent = In
 
 template <typename T>
 std::string assign(const VectorInterface<T>& lhs, const Value& rhs, const Indent& indent = Indent::obj()) {
+    const ExprNode* rhsNode = rhs.node();
     std::stringstream ss;
     for (size_t i = 0; i < lhs.length(); i++) {
-        ss << indent << lhs.name(i) << " = " << rhs.name() << ";" << std::endl;
+        ss << indent << lhs.name(i) << " = " << *rhsNode << ";" << std::endl;
     }
     return ss.str();
 }
@@ -867,13 +938,14 @@ std::string assign(const VectorInterface<T>& lhs, const VectorInterface<T2>& rhs
 
 template <typename T>
 std::string assign(const VectorInterface<T>& lhs, const Value& rhs, const Value& step, const Indent& indent = Indent::obj()) {
+    const ExprNode* stepNode = step.node();
     std::stringstream ss;
     for (size_t i = 0; i < lhs.length(); i++) {
         ss << indent << lhs.name(i) << " = ";
         if (0 == i)
-            ss << rhs.name();
+            ss << *rhs.node();
         else
-            ss << lhs.name(i-1) << " + " << step.name();
+            ss << lhs.name(i-1) << " + " << *stepNode;
         ss << ";" << std::endl;
     }
     return ss.str();
@@ -891,9 +963,10 @@ std::string increment(const Variable& lhs, const size_t rhs, const Indent& inden
 
 template <typename T>
 std::string increment(const VectorInterface<T>& lhs, const Value& rhs, const Indent& indent = Indent::obj()) {
+    const ExprNode* rhsNode = rhs.node();
     std::stringstream ss;
     for (size_t i = 0; i < lhs.length(); i++) {
-        ss << indent << lhs.name(i) << " += " << rhs.name() << ";" << std::endl;
+        ss << indent << lhs.name(i) << " += " << *rhsNode << ";" << std::endl;
     }
     return ss.str();
 }
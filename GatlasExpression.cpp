@@ -0,0 +1,338 @@
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+#include "GatlasExpression.hpp"
+
+using namespace std;
+
+#include "declare_namespace"
+
+bool ExprNode::isLiteral(const long value) const {
+    if (NUMBER == kind) return value == number;
+
+    // formatted text like a constant or inlined variable
+    if (TEXT == kind && value >= 0 && value <= 9)
+        return text[0] == '0' + value && text[1] == '\0';
+
+    // every other kind of node prints with parentheses or operators
+    return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ExprArena
+
+static ExprArena *currentArena = NULL;
+
+ExprArena::ExprArena()
+    : _blockIndex(0),
+      _blockOffset(0),
+      _folding(false)
+{ }
+
+ExprArena::~ExprArena() {
+    for (size_t i = 0; i < _blocks.size(); i++)
+        free(_blocks[i].first);
+}
+
+void* ExprArena::allocate(const size_t numberBytes) {
+    // round up so every allocation is aligned like a pointer or long
+    const size_t ALIGN = sizeof(long) > sizeof(void*) ? sizeof(long) : sizeof(void*);
+    const size_t n = ((numberBytes + ALIGN - 1) / ALIGN) * ALIGN;
+
+    // first block with enough room, from the current one on
+    while (_blockIndex < _blocks.size() && _blockOffset + n > _blocks[_blockIndex].second) {
+        _blockIndex++;
+        _blockOffset = 0;
+    }
+
+    if (_blockIndex == _blocks.size()) {
+        const size_t blockSize = n > BLOCK_SIZE ? n : BLOCK_SIZE;
+        _blocks.push_back(make_pair(static_cast<char*>(malloc(blockSize)), blockSize));
+        _blockOffset = 0;
+    }
+
+    void *ptr = _blocks[_blockIndex].first + _blockOffset;
+    _blockOffset += n;
+    return ptr;
+}
+
+void ExprArena::reset() {
+    _blockIndex = 0;
+    _blockOffset = 0;
+    _folding = false;
+}
+
+void ExprArena::setFolding(const bool value) { _folding = value; }
+bool ExprArena::folding() const { return _folding; }
+
+size_t ExprArena::capacity() const {
+    size_t total = 0;
+    for (size_t i = 0; i < _blocks.size(); i++)
+        total += _blocks[i].second;
+    return total;
+}
+
+ExprNode* ExprArena::newNode(const ExprNode::Kind kind,
+                             const char *text,
+                             const size_t numberArgs) {
+    ExprNode *node = static_cast<ExprNode*>(allocate(sizeof(ExprNode)));
+    node->kind = kind;
+    node->text = text;
+    node->number = 0;
+    node->numberArgs = numberArgs;
+    node->args = numberArgs
+                     ? static_cast<const ExprNode**>(allocate(numberArgs * sizeof(ExprNode*)))
+                     : NULL;
+    return node;
+}
+
+const ExprNode* ExprArena::number(const long value) {
+    ExprNode *node = newNode(ExprNode::NUMBER, NULL, 0);
+    node->number = value;
+    return node;
+}
+
+const ExprNode* ExprArena::text(const string& s) {
+    char *copy = static_cast<char*>(allocate(s.size() + 1));
+    memcpy(copy, s.c_str(), s.size() + 1);
+    return newNode(ExprNode::TEXT, copy, 0);
+}
+
+const ExprNode* ExprArena::literal(const char *s) {
+    return newNode(ExprNode::TEXT, s, 0);
+}
+
+const ExprNode* ExprArena::binary(const char *op, const ExprNode* left, const ExprNode* right) {
+    if (_folding) {
+        const ExprNode* folded = fold(op, left, right);
+        if (folded) return folded;
+    }
+    ExprNode *node = newNode(ExprNode::BINARY, op, 2);
+    node->args[0] = left;
+    node->args[1] = right;
+    return node;
+}
+
+const ExprNode* ExprArena::prefix(const char *op, const ExprNode* operand) {
+    ExprNode *node = newNode(ExprNode::PREFIX, op, 1);
+    node->args[0] = operand;
+    return node;
+}
+
+const ExprNode* ExprArena::postfix(const char *op, const ExprNode* operand) {
+    ExprNode *node = newNode(ExprNode::POSTFIX, op, 1);
+    node->args[0] = operand;
+    return node;
+}
+
+const ExprNode* ExprArena::call(const string& function,
+                                const ExprNode* arg0,
+                                const ExprNode* arg1,
+                                const ExprNode* arg2) {
+    const size_t numberArgs = arg2 ? 3 : (arg1 ? 2 : 1);
+    ExprNode *node = newNode(ExprNode::CALL, text(function)->text, numberArgs);
+    node->args[0] = arg0;
+    if (arg1) node->args[1] = arg1;
+    if (arg2) node->args[2] = arg2;
+    return node;
+}
+
+const ExprNode* ExprArena::cast(const string& type,
+                                const ExprNode* arg0,
+                                const ExprNode* arg1) {
+    ExprNode *node = newNode(ExprNode::CAST, text(type)->text, arg1 ? 2 : 1);
+    node->args[0] = arg0;
+    if (arg1) node->args[1] = arg1;
+    return node;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// constant folding
+//
+// Integer nodes only come from index arithmetic so the rules below are
+// exact for int and pointer expressions. Constants move outward so the
+// unrolled variants of an address differ only by a trailing offset.
+
+static bool isOp(const char *op, const char *token) {
+    return 0 == strcmp(op, token);
+}
+
+static bool isNumber(const ExprNode* node) {
+    return ExprNode::NUMBER == node->kind;
+}
+
+// node is (a op b) with b a number
+static bool isRightNumber(const ExprNode* node, const char *token) {
+    return ExprNode::BINARY == node->kind && isOp(node->text, token) && isNumber(node->args[1]);
+}
+
+// node is (a op b) with a a number
+static bool isLeftNumber(const ExprNode* node, const char *token) {
+    return ExprNode::BINARY == node->kind && isOp(node->text, token) && isNumber(node->args[0]);
+}
+
+// returns NULL if no rule applies
+const ExprNode* ExprArena::fold(const char *op, const ExprNode* left, const ExprNode* right) {
+    const bool ADD = isOp(op, " + ");
+    const bool MUL = isOp(op, " * ");
+    const bool DIV = isOp(op, " / ");
+
+    // both sides constant
+    if (isNumber(left) && isNumber(right)) {
+        const long a = left->number;
+        const long b = right->number;
+        if (ADD) return number(a + b);
+        if (isOp(op, " - ")) return number(a - b);
+        if (MUL) return number(a * b);
+        if (DIV && 0 != b) return number(a / b);
+        if (isOp(op, "%") && 0 != b) return number(a % b);
+        if (isOp(op, "<<")) return number(a << b);
+        if (isOp(op, ">>")) return number(a >> b);
+        if (isOp(op, "&")) return number(a & b);
+        if (isOp(op, "^")) return number(a ^ b);
+        return NULL;
+    }
+
+    if (ADD) {
+        if (left->isLiteral(0)) return right;
+        if (right->isLiteral(0)) return left;
+
+        // c + x -> x + c, also for pointers
+        if (isNumber(left))
+            return binary(op, right, left);
+
+        // (x + c1) + c2 -> x + (c1 + c2)
+        if (isRightNumber(left, " + ") && isNumber(right))
+            return binary(op, left->args[0], number(left->args[1]->number + right->number));
+
+        // (x + c) + y -> (x + y) + c
+        if (isRightNumber(left, " + "))
+            return binary(op, binary(op, left->args[0], right), left->args[1]);
+
+        // x + (y + c) -> (x + y) + c
+        if (isRightNumber(right, " + "))
+            return binary(op, binary(op, left, right->args[0]), right->args[1]);
+
+        return NULL;
+    }
+
+    if (MUL) {
+        if (left->isLiteral(1)) return right;
+        if (right->isLiteral(1)) return left;
+
+        // gather constant factors on the left
+        if (isNumber(right) && ! isNumber(left))
+            return binary(op, right, left);
+
+        if (isNumber(left)) {
+            if (0 == left->number) return left;
+
+            // c1 * (c2 * x) -> (c1 * c2) * x
+            if (isLeftNumber(right, " * "))
+                return binary(op, number(left->number * right->args[0]->number), right->args[1]);
+
+            // c * (x + d) -> (c * x) + (c * d), the product is shared by unrolled offsets
+            if (isRightNumber(right, " + "))
+                return binary(" + ",
+                              binary(op, left, right->args[0]),
+                              number(left->number * right->args[1]->number));
+        }
+
+        return NULL;
+    }
+
+    if (DIV && isNumber(right) && 0 != right->number) {
+        if (right->isLiteral(1)) return left;
+
+        // (c1 * x) / c2 -> (c1 / c2) * x when exact
+        if (isLeftNumber(left, " * ") && 0 == left->args[0]->number % right->number)
+            return binary(" * ", number(left->args[0]->number / right->number), left->args[1]);
+    }
+
+    return NULL;
+}
+
+ExprArena& ExprArena::current() {
+    static ExprArena globalArena;
+    return currentArena ? *currentArena : globalArena;
+}
+
+ExprArenaScope::ExprArenaScope(ExprArena& arena)
+    : _arena(arena),
+      _outer(currentArena)
+{
+    currentArena = &_arena;
+}
+
+ExprArenaScope::~ExprArenaScope() {
+    currentArena = _outer;
+    _arena.reset();
+}
+
+ExprFoldingScope::ExprFoldingScope(const bool enable)
+    : _arena(ExprArena::current()),
+      _outer(_arena.folding())
+{
+    _arena.setFolding(enable);
+}
+
+ExprFoldingScope::~ExprFoldingScope() {
+    _arena.setFolding(_outer);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// pretty-printer
+
+static ostream& printArgs(ostream& os, const ExprNode& node) {
+    for (size_t i = 0; i < node.numberArgs; i++) {
+        if (0 != i) os << ", ";
+        os << *node.args[i];
+    }
+    return os;
+}
+
+ostream& operator<< (ostream& os, const ExprNode& node) {
+    switch (node.kind) {
+        case (ExprNode::NUMBER) :
+            return os << node.number;
+        case (ExprNode::TEXT) :
+            return os << node.text;
+        case (ExprNode::BINARY) :
+            return os << "(" << *node.args[0] << node.text << *node.args[1] << ")";
+        case (ExprNode::PREFIX) :
+            return os << node.text << *node.args[0];
+        case (ExprNode::POSTFIX) :
+            return os << *node.args[0] << node.text;
+        case (ExprNode::CALL) :
+            return printArgs(os << node.text << "(", node) << ")";
+        case (ExprNode::CAST) :
+            return printArgs(os << "(" << node.text << ")(", node) << ")";
+    }
+    return os;
+}
+
+string str(const ExprNode& node) {
+    stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+}; // namespace
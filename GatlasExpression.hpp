@@ -0,0 +1,147 @@
+#ifndef _GATLAS_EXPRESSION_HPP_
+#define _GATLAS_EXPRESSION_HPP_
+
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "declare_namespace"
+
+///////////////////////////////////////////////////////////////////////////////
+// Expression tree for generated kernel source. Operators on values build
+// nodes instead of formatting strings, and the tree is printed once when
+// the statement holding it is written out. Nodes never own memory, they
+// are allocated from an arena that is reset after each kernel.
+
+struct ExprNode
+{
+    enum Kind {
+        NUMBER,  // integer literal
+        TEXT,    // identifier or anything already formatted
+        BINARY,  // (left op right)
+        PREFIX,  // op operand
+        POSTFIX, // operand op
+        CALL,    // function(arg, arg, ...)
+        CAST     // (type)(arg, arg, ...)
+    };
+
+    Kind             kind;
+    const char      *text;       // identifier, operator, function or type
+    long             number;
+    size_t           numberArgs;
+    const ExprNode **args;
+
+    // same as comparing the printed text
+    bool isLiteral(const long value) const;
+};
+
+class ExprArena
+{
+    static const size_t BLOCK_SIZE = 32 * 1024;
+
+    std::vector< std::pair<char*, size_t> > _blocks;
+    size_t _blockIndex;
+    size_t _blockOffset;
+
+    // fold integer constants as binary nodes are built
+    bool _folding;
+
+    ExprArena(const ExprArena&);
+    ExprArena& operator= (const ExprArena&);
+
+    ExprNode* newNode(const ExprNode::Kind kind,
+                      const char *text,
+                      const size_t numberArgs);
+
+    const ExprNode* fold(const char *op, const ExprNode* left, const ExprNode* right);
+
+public:
+    ExprArena();
+    ~ExprArena();
+
+    // aligned for any node or pointer
+    void* allocate(const size_t numberBytes);
+
+    // nodes from before are invalid, memory blocks are kept for reuse
+    void reset();
+
+    // constant folding, reassociation and distribution of index arithmetic
+    void setFolding(const bool value);
+    bool folding() const;
+
+    // bytes held by the arena
+    size_t capacity() const;
+
+    const ExprNode* number(const long value);
+    const ExprNode* text(const std::string& s);
+    const ExprNode* literal(const char *s); // s must outlive the arena
+
+    const ExprNode* binary(const char *op, const ExprNode* left, const ExprNode* right);
+    const ExprNode* prefix(const char *op, const ExprNode* operand);
+    const ExprNode* postfix(const char *op, const ExprNode* operand);
+
+    const ExprNode* call(const std::string& function,
+                         const ExprNode* arg0,
+                         const ExprNode* arg1 = NULL,
+                         const ExprNode* arg2 = NULL);
+
+    const ExprNode* cast(const std::string& type,
+                         const ExprNode* arg0,
+                         const ExprNode* arg1 = NULL);
+
+    // arena of the innermost scope, or one that is never reset for values
+    // that outlive any kernel (like members of kernel generators)
+    static ExprArena& current();
+
+    friend class ExprArenaScope;
+};
+
+// expressions built while in scope are allocated from the arena, which is
+// reset when the scope ends
+class ExprArenaScope
+{
+    ExprArena& _arena;
+    ExprArena* _outer;
+
+public:
+    ExprArenaScope(ExprArena& arena);
+    ~ExprArenaScope();
+};
+
+// folding is enabled for the current arena while in scope
+class ExprFoldingScope
+{
+    ExprArena& _arena;
+    const bool _outer;
+
+public:
+    ExprFoldingScope(const bool enable);
+    ~ExprFoldingScope();
+};
+
+// the single pretty-printer
+std::ostream& operator<< (std::ostream& os, const ExprNode& node);
+
+std::string str(const ExprNode& node);
+
+}; // namespace
+
+#endif
@@ -31,7 +31,9 @@ const char* hex(const size_t n) {
 }
 
 std::ostream& operator<< (std::ostream& os, const Indent& tabs) {
-    return os << tabs.str();
+    for (size_t i = 0; i < tabs._tabs; i++)
+        os << "    ";
+    return os;
 }
 
 std::ostream& endline(std::ostream& os) {
@@ -75,6 +75,8 @@ public:
     Indent& set(const Indent& other);
     std::string str() const;
     static Indent& obj();
+
+    friend std::ostream& operator<< (std::ostream& os, const Indent& tabs);
 };
 
 static const Indent TAB0;
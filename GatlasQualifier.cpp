@@ -44,6 +44,12 @@ WorkGroupSizeHint::WorkGroupSizeHint(const size_t X, const size_t Y, const size_
     : _x(X), _y(Y), _z(Z)
     { }
 
+WorkGroupSizeHint::WorkGroupSizeHint(const std::vector<size_t>& localWorkItems)
+    : _x(localWorkItems.size() > 0 ? localWorkItems[0] : 1),
+      _y(localWorkItems.size() > 1 ? localWorkItems[1] : 1),
+      _z(localWorkItems.size() > 2 ? localWorkItems[2] : 1)
+    { }
+
 std::string WorkGroupSizeHint::str() const {
     std::string s = "__attribute__((";
     s.append(func_string("work_group_size_hint", _x, _y, _z))
@@ -55,6 +61,12 @@ RequiredWorkGroupSize::RequiredWorkGroupSize(const size_t X, const size_t Y, con
     : _x(X), _y(Y), _z(Z)
     { }
 
+RequiredWorkGroupSize::RequiredWorkGroupSize(const std::vector<size_t>& localWorkItems)
+    : _x(localWorkItems.size() > 0 ? localWorkItems[0] : 1),
+      _y(localWorkItems.size() > 1 ? localWorkItems[1] : 1),
+      _z(localWorkItems.size() > 2 ? localWorkItems[2] : 1)
+    { }
+
 std::string RequiredWorkGroupSize::str() const {
     std::string s = "__attribute__((";
     s.append(func_string("reqd_work_group_size", _x, _y, _z))
@@ -20,6 +20,7 @@
 
 #include <ostream>
 #include <string>
+#include <vector>
 #include "GatlasType.hpp"
 #include "GatlasFormatting.hpp"
 
@@ -80,6 +81,7 @@ class WorkGroupSizeHint : public FunctionAttribute
     const size_t _z;
 public:
     WorkGroupSizeHint(const size_t X, const size_t Y, const size_t Z);
+    WorkGroupSizeHint(const std::vector<size_t>& localWorkItems);
     std::string str() const;
 };
 
@@ -90,6 +92,7 @@ class RequiredWorkGroupSize : public FunctionAttribute
     const size_t _z;
 public:
     RequiredWorkGroupSize(const size_t X, const size_t Y, const size_t Z);
+    RequiredWorkGroupSize(const std::vector<size_t>& localWorkItems);
     std::string str() const;
 };
 
@@ -0,0 +1,173 @@
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <sstream>
+
+#include "GatlasStatistics.hpp"
+
+using namespace std;
+
+#include "declare_namespace"
+
+TimeStats::TimeStats()
+    : _count(0),
+      _sum(0),
+      _sumSquares(0),
+      _min(0),
+      _max(0)
+{ }
+
+TimeStats::TimeStats(const string& token)
+    : _count(0),
+      _sum(0),
+      _sumSquares(0),
+      _min(0),
+      _max(0)
+{
+    stringstream ss(token);
+    size_t numberCentroids = 0;
+    if (! (ss >> _count >> _sum >> _sumSquares >> _min >> _max >> numberCentroids)) {
+        *this = TimeStats();
+        return;
+    }
+
+    for (size_t i = 0; i < numberCentroids; i++) {
+        double mean;
+        size_t weight;
+        if (! (ss >> mean >> weight)) {
+            *this = TimeStats();
+            return;
+        }
+        _centroids.push_back(pair<double, size_t>(mean, weight));
+    }
+}
+
+void TimeStats::compress() {
+    vector< pair<double, size_t> > merged;
+
+    // weight bound is 4 * count * q * (1 - q) / compression
+    double cumulative = 0;
+    for (size_t i = 0; i < _centroids.size(); i++) {
+        const pair<double, size_t>& c = _centroids[i];
+
+        if (! merged.empty()) {
+            pair<double, size_t>& last = merged.back();
+            const size_t weight = last.second + c.second;
+            const double q = (cumulative - last.second + weight / 2.0) / _count;
+            const double bound = 4.0 * _count * q * (1 - q) / COMPRESSION;
+
+            if (weight <= bound) {
+                last.first += (c.first - last.first) * c.second / weight;
+                last.second = weight;
+                cumulative += c.second;
+                continue;
+            }
+        }
+
+        merged.push_back(c);
+        cumulative += c.second;
+    }
+
+    _centroids.swap(merged);
+}
+
+void TimeStats::add(const size_t value) {
+    if (0 == _count || value < _min) _min = value;
+    if (0 == _count || value > _max) _max = value;
+    _count++;
+    _sum += value;
+    _sumSquares += static_cast<double>(value) * value;
+
+    const pair<double, size_t> c(value, 1);
+    _centroids.insert(upper_bound(_centroids.begin(), _centroids.end(), c), c);
+
+    if (_centroids.size() > 2 * COMPRESSION) compress();
+}
+
+void TimeStats::merge(const TimeStats& other) {
+    if (0 == other._count) return;
+
+    if (0 == _count || other._min < _min) _min = other._min;
+    if (0 == _count || other._max > _max) _max = other._max;
+    _count += other._count;
+    _sum += other._sum;
+    _sumSquares += other._sumSquares;
+
+    const size_t n = _centroids.size();
+    _centroids.insert(_centroids.end(), other._centroids.begin(), other._centroids.end());
+    inplace_merge(_centroids.begin(), _centroids.begin() + n, _centroids.end());
+
+    if (_centroids.size() > 2 * COMPRESSION) compress();
+}
+
+size_t TimeStats::count() const { return _count; }
+double TimeStats::sum() const { return _sum; }
+double TimeStats::sumSquares() const { return _sumSquares; }
+size_t TimeStats::min() const { return _min; }
+size_t TimeStats::max() const { return _max; }
+
+double TimeStats::mean() const {
+    return 0 == _count ? 0 : _sum / _count;
+}
+
+double TimeStats::variance() const {
+    if (_count < 2) return 0;
+    const double avg = mean();
+    const double var = (_sumSquares - _count * avg * avg) / (_count - 1);
+    return var < 0 ? 0 : var;
+}
+
+double TimeStats::quantile(const double q) const {
+    if (0 == _count) return 0;
+    if (q <= 0) return _min;
+    if (q >= 1) return _max;
+
+    // each centroid mean sits at the middle of its weight, interpolate
+    // between neighbouring centers (and the min and max at the ends)
+    const double target = q * _count;
+    double prevCenter = 0;
+    double prevMean = _min;
+    double cumulative = 0;
+    for (size_t i = 0; i < _centroids.size(); i++) {
+        const double center = cumulative + _centroids[i].second / 2.0;
+        if (target < center) {
+            const double t = (target - prevCenter) / (center - prevCenter);
+            return prevMean + t * (_centroids[i].first - prevMean);
+        }
+        prevCenter = center;
+        prevMean = _centroids[i].first;
+        cumulative += _centroids[i].second;
+    }
+
+    const double t = (target - prevCenter) / (_count - prevCenter);
+    return prevMean + t * (_max - prevMean);
+}
+
+double TimeStats::median() const { return quantile(0.5); }
+
+string TimeStats::str() const {
+    stringstream ss;
+    ss.precision(17);
+    ss << _count << " " << _sum << " " << _sumSquares << " "
+       << _min << " " << _max << " " << _centroids.size();
+    for (size_t i = 0; i < _centroids.size(); i++)
+        ss << " " << _centroids[i].first << " " << _centroids[i].second;
+    return ss.str();
+}
+
+}; // namespace
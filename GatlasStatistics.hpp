@@ -0,0 +1,75 @@
+#ifndef _GATLAS_STATISTICS_HPP_
+#define _GATLAS_STATISTICS_HPP_
+
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "declare_namespace"
+
+// Summary of benchmark times for one kernel, maintained incrementally as
+// trials are recorded. Quantiles come from a merging t-digest: times are
+// kept as centroids (mean, weight) sorted by mean, and neighbouring
+// centroids are merged as long as the weight stays under a bound that is
+// small near the tails, so the median and p99 stay accurate in a few
+// hundred numbers no matter how many trials there are.
+class TimeStats
+{
+    static const size_t COMPRESSION = 100;
+
+    size_t _count;
+    double _sum;
+    double _sumSquares;
+    size_t _min;
+    size_t _max;
+
+    std::vector< std::pair<double, size_t> > _centroids;
+
+    void compress();
+
+public:
+    TimeStats();
+
+    // serialized by str()
+    TimeStats(const std::string& token);
+
+    void add(const size_t value);
+    void merge(const TimeStats& other);
+
+    size_t count() const;
+    double sum() const;
+    double sumSquares() const;
+    size_t min() const;
+    size_t max() const;
+
+    double mean() const;
+    double variance() const;
+
+    // q from 0 to 1, zero if there are no times
+    double quantile(const double q) const;
+    double median() const;
+
+    // one line of space separated numbers
+    std::string str() const;
+};
+
+}; // namespace
+
+#endif
@@ -84,4 +84,11 @@ template <> std::ostream& pragma_extension<double>(std::ostream& os) {
     return os;
 }
 
+void reduceFraction(size_t& numer, size_t& denom) {
+    while (0 == numer % 2 && 0 == denom % 2) {
+        numer /= 2;
+        denom /= 2;
+    }
+}
+
 }; // namespace
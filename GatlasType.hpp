@@ -125,6 +125,10 @@ DECL_VECTYPE_FUNCS(SCALAR, 16)
 // OpenCL pragmas required for specific scalar types
 template <typename SCALAR> std::ostream& pragma_extension(std::ostream& os);
 
+// fraction of a vector length in lowest terms, vector lengths are powers of
+// two so only common factors of two need to be removed
+void reduceFraction(size_t& numer, size_t& denom);
+
 }; // namespace
 
 #endif
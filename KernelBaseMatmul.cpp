@@ -87,9 +87,9 @@ size_t MatmulWorkGroup::groupSize() const {
     return (_dimWidth == _dimHeight) ? _dimWidth : 0;
 }
 
-size_t MatmulWorkGroup::localHeight() const { return groupHeight() + LOCALMEM_PAD; }
-size_t MatmulWorkGroup::localWidth() const { return groupWidth() + LOCALMEM_PAD; }
-size_t MatmulWorkGroup::localSize() const { return groupSize() + LOCALMEM_PAD; }
+size_t MatmulWorkGroup::localHeight(const size_t pad) const { return groupHeight() + pad; }
+size_t MatmulWorkGroup::localWidth(const size_t pad) const { return groupWidth() + pad; }
+size_t MatmulWorkGroup::localSize(const size_t pad) const { return groupSize() + pad; }
 
 ////////////////////////////////////////
 // MatmulInnerBlocking
@@ -110,23 +110,19 @@ size_t MatmulInnerBlocking::wholeHeight() const { return blockHeight() / blockWi
 size_t MatmulInnerBlocking::fractHeight() const { return blockHeight() % blockWidth(); }
 
 ConstantValue<string> MatmulInnerBlocking::multHeight(const Value& valSize) const {
-    switch (fractHeight()) {
-        case (0) : return wholeHeight() * valSize;
-        case (1) : return (wholeHeight() * valSize + valSize / blockWidth());
-        case (2) : return (wholeHeight() * valSize + valSize / 2);
-        case (3) : return (wholeHeight() * valSize + 3 * valSize / blockWidth());
-    }
-    return ConstantValue<string>(""); // should never happen
+    size_t numer = fractHeight(), denom = blockWidth();
+    if (0 == numer) return wholeHeight() * valSize;
+    reduceFraction(numer, denom);
+    return 1 == numer
+               ? (wholeHeight() * valSize + valSize / denom)
+               : (wholeHeight() * valSize + numer * valSize / denom);
 }
 
 size_t MatmulInnerBlocking::multHeight(const size_t valSize) const {
-    switch (fractHeight()) {
-        case (0) : return wholeHeight() * valSize;
-        case (1) : return (wholeHeight() * valSize + valSize / blockWidth());
-        case (2) : return (wholeHeight() * valSize + valSize / 2);
-        case (3) : return (wholeHeight() * valSize + 3 * valSize / blockWidth());
-    }
-    return 0; // should never happen
+    size_t numer = fractHeight(), denom = blockWidth();
+    if (0 == numer) return wholeHeight() * valSize;
+    reduceFraction(numer, denom);
+    return wholeHeight() * valSize + numer * valSize / denom;
 }
 
 ////////////////////////////////////////
@@ -142,6 +138,7 @@ MatmulExtraParameterObserver::MatmulExtraParameterObserver(const size_t numberVa
 size_t MatmulExtraParameterObserver::numberVariations() const { return _numberVariations; }
 size_t MatmulExtraParameterObserver::getParam() const { return _paramValue; }
 void MatmulExtraParameterObserver::setParam(const size_t value) { _paramValue = value; }
+bool MatmulExtraParameterObserver::validParam(const bool searched) const { return searched || 0 == _paramValue; }
 
 MatmulExtraParameter::MatmulExtraParameter()
     : _extraParam(0), _totalVariations(1)
@@ -201,6 +198,102 @@ MatmulParamGlobalID::MatmulParamGlobalID(MatmulExtraParameter& subject)
 
 bool MatmulParamGlobalID::globalID() const { return getParam(); }
 
+////////////////////////////////////////
+// MatmulParamOptimizeExpr
+
+MatmulParamOptimizeExpr::MatmulParamOptimizeExpr(MatmulExtraParameter& subject)
+    : MatmulExtraParameterObserver(2, subject)
+{ }
+
+bool MatmulParamOptimizeExpr::optimizeExpr() const { return getParam(); }
+
+////////////////////////////////////////
+// MatmulParamPrefetch
+
+MatmulParamPrefetch::MatmulParamPrefetch(MatmulExtraParameter& subject)
+    : MatmulExtraParameterObserver(2, subject)
+{ }
+
+bool MatmulParamPrefetch::prefetchTiles() const { return getParam(); }
+
+////////////////////////////////////////
+// MatmulParamLocalLayout
+
+// the first choice is the original padding of one so that extra parameter
+// values from before the layout was tuned keep their meaning
+static const size_t LOCAL_LAYOUT_PAD[] = { 1, 0, 2, 0 };
+static const bool LOCAL_LAYOUT_SWIZZLE[] = { false, false, false, true };
+
+MatmulParamLocalLayout::MatmulParamLocalLayout(MatmulExtraParameter& subject)
+    : MatmulExtraParameterObserver(4, subject)
+{ }
+
+size_t MatmulParamLocalLayout::localPad() const { return LOCAL_LAYOUT_PAD[getParam()]; }
+bool MatmulParamLocalLayout::swizzleLocal() const { return LOCAL_LAYOUT_SWIZZLE[getParam()]; }
+
+////////////////////////////////////////
+// MatmulParamGroupSizeAttr
+
+// no attribute, reqd_work_group_size or work_group_size_hint
+MatmulParamGroupSizeAttr::MatmulParamGroupSizeAttr(MatmulExtraParameter& subject)
+    : MatmulExtraParameterObserver(3, subject)
+{ }
+
+bool MatmulParamGroupSizeAttr::reqdWorkGroupSize() const { return 1 == getParam(); }
+bool MatmulParamGroupSizeAttr::workGroupSizeHint() const { return 2 == getParam(); }
+
+////////////////////////////////////////
+// MatmulParamBuildOptions
+
+// the first choice is no options so that extra parameter values from before
+// build options were searched keep their meaning
+static const char* BUILD_OPTION_SETS[] = {
+    "",
+    "-cl-mad-enable",
+    "-cl-mad-enable -cl-no-signed-zeros",
+    "-cl-fast-relaxed-math",
+    "-cl-unsafe-math-optimizations" };
+
+MatmulParamBuildOptions::MatmulParamBuildOptions(MatmulExtraParameter& subject)
+    : MatmulExtraParameterObserver(sizeof(BUILD_OPTION_SETS) / sizeof(const char*), subject)
+{ }
+
+std::string MatmulParamBuildOptions::buildOptionSet() const { return BUILD_OPTION_SETS[getParam()]; }
+
+////////////////////////////////////////
+// MatmulParamUnroll
+
+// no unrolling, by two, by four or fully (zero)
+static const size_t UNROLL_FACTOR[] = { 1, 2, 4, 0 };
+
+// longer loops are not fully unrolled so the kernel source stays small
+static const size_t MAX_FULL_UNROLL = 64;
+
+MatmulParamUnroll::MatmulParamUnroll(MatmulExtraParameter& subject)
+    : MatmulExtraParameterObserver(sizeof(UNROLL_FACTOR) / sizeof(size_t), subject)
+{ }
+
+size_t MatmulParamUnroll::unrollFactor(const size_t tripCount) const {
+    return fullUnroll() ? tripCount : UNROLL_FACTOR[getParam()];
+}
+
+bool MatmulParamUnroll::fullUnroll() const { return 0 == UNROLL_FACTOR[getParam()]; }
+
+bool MatmulParamUnroll::validUnroll(const size_t tripCount, const bool searched) const {
+    if (1 == UNROLL_FACTOR[getParam()]) return true;
+    if (! searched) return false;
+    return fullUnroll()
+               ? tripCount <= MAX_FULL_UNROLL
+               : 0 == tripCount % unrollFactor(tripCount);
+}
+
+ConstantValue<std::string> MatmulParamUnroll::unrolledIndex(const Value& index, const size_t step) const {
+    if (fullUnroll())
+        return ConstantValue<std::string>(ExprArena::current().number(step));
+    else
+        return 0 == step ? ConstantValue<std::string>(index) : index + step;
+}
+
 ////////////////////////////////////////
 // MatmulAttrAutoVec
 
@@ -244,6 +337,66 @@ bool MatmulPackedCalc::packedChanged() const { return _packedChanged; }
 
 size_t MatmulPackedCalc::packedCalc() const { return _packedCalc; }
 
+////////////////////////////////////////
+// MatmulSearchBuildOptions
+
+MatmulSearchBuildOptions::MatmulSearchBuildOptions()
+    : _searchBuildOptions(false)
+{ }
+
+void MatmulSearchBuildOptions::setSearchBuildOptions(const bool value) { _searchBuildOptions = value; }
+bool MatmulSearchBuildOptions::getSearchBuildOptions() const { return _searchBuildOptions; }
+
+////////////////////////////////////////
+// MatmulSearchUnroll
+
+MatmulSearchUnroll::MatmulSearchUnroll()
+    : _searchUnroll(false)
+{ }
+
+void MatmulSearchUnroll::setSearchUnroll(const bool value) { _searchUnroll = value; }
+bool MatmulSearchUnroll::getSearchUnroll() const { return _searchUnroll; }
+
+////////////////////////////////////////
+// MatmulSearchOptimizeExpr
+
+MatmulSearchOptimizeExpr::MatmulSearchOptimizeExpr()
+    : _searchOptimizeExpr(false)
+{ }
+
+void MatmulSearchOptimizeExpr::setSearchOptimizeExpr(const bool value) { _searchOptimizeExpr = value; }
+bool MatmulSearchOptimizeExpr::getSearchOptimizeExpr() const { return _searchOptimizeExpr; }
+
+////////////////////////////////////////
+// MatmulSearchGroupSizeAttr
+
+MatmulSearchGroupSizeAttr::MatmulSearchGroupSizeAttr()
+    : _searchGroupSizeAttr(false)
+{ }
+
+void MatmulSearchGroupSizeAttr::setSearchGroupSizeAttr(const bool value) { _searchGroupSizeAttr = value; }
+bool MatmulSearchGroupSizeAttr::getSearchGroupSizeAttr() const { return _searchGroupSizeAttr; }
+
+////////////////////////////////////////
+// MatmulSearchLocalTiles
+
+MatmulSearchLocalTiles::MatmulSearchLocalTiles()
+    : _searchLocalTiles(false)
+{ }
+
+void MatmulSearchLocalTiles::setSearchLocalTiles(const bool value) { _searchLocalTiles = value; }
+bool MatmulSearchLocalTiles::getSearchLocalTiles() const { return _searchLocalTiles; }
+
+////////////////////////////////////////
+// MatmulLocalMemory
+
+MatmulLocalMemory::MatmulLocalMemory()
+    : _localMemorySize(0)
+{ }
+
+void MatmulLocalMemory::setLocalMemorySize(const size_t bytes) { _localMemorySize = bytes; }
+size_t MatmulLocalMemory::localMemorySize() const { return _localMemorySize; }
+
 ////////////////////////////////////////
 // KernelBaseMatmul
 
@@ -255,7 +408,13 @@ KernelBaseMatmul::KernelBaseMatmul()
       MatmulExtraParameter(),
       MatmulAttrAutoVec(),
       MatmulGeneralized(),
-      MatmulPackedCalc()
+      MatmulPackedCalc(),
+      MatmulSearchBuildOptions(),
+      MatmulSearchUnroll(),
+      MatmulSearchOptimizeExpr(),
+      MatmulSearchGroupSizeAttr(),
+      MatmulSearchLocalTiles(),
+      MatmulLocalMemory()
 { }
 
 KernelBaseMatmul::~KernelBaseMatmul() { }
@@ -287,7 +446,14 @@ bool KernelBaseMatmul::validParams() const {
               : true ) &&
 
         // extra parameter
-        extraParam() < totalVariations();
+        extraParam() < totalVariations() &&
+        validExtraParam() &&
+
+        // tiles must fit in local memory when the device limit is known
+        (0 == localMemorySize() || localMemoryBytes() <= localMemorySize()) &&
+
+        // build options only when searched
+        (getSearchBuildOptions() || buildOptions().empty());
 }
 
 bool KernelBaseMatmul::getParams(vector<size_t>& params) const {
@@ -382,4 +548,65 @@ size_t KernelBaseMatmul::numberFlops() const {
         return packedCalc() * dimM() * dimN() * (2 * dimK() - 1);
 }
 
+size_t KernelBaseMatmul::bytesMoved() const {
+    // each block of A is read once for every block column of C sharing it,
+    // each block of B once for every block row
+    const size_t shareA = (localMemoryTiles() ? groupWidth() : 1) * blockWidth();
+    const size_t shareB = (localMemoryTiles() ? groupHeight() : 1) * blockHeight();
+    const size_t readA = dimM() * dimK() * (dimN() / shareA);
+    const size_t readB = dimK() * dimN() * (dimM() / shareB);
+    const size_t rwC = (generalizedMatmul() ? 2 : 1) * dimM() * dimN();
+    return packedCalc() * elementSize() * (readA + readB + rwC);
+}
+
+size_t KernelBaseMatmul::bytesMovedLocal() const {
+    if (! localMemoryTiles()) return 0;
+
+    // blocks of A and B are written once, then every work item reads its
+    // rows of A and columns of B for each inner product
+    const size_t writeAB = dimM() * dimK() * (dimN() / (groupWidth() * blockWidth()))
+                         + dimK() * dimN() * (dimM() / (groupHeight() * blockHeight()));
+    const size_t readAB = dimM() * dimK() * (dimN() / blockWidth())
+                        + dimK() * dimN() * (dimM() / blockHeight());
+    return packedCalc() * elementSize() * (writeAB + readAB);
+}
+
+// straightforward inner products, memory holds A, B and C for each packed
+// kernel and is allocated on the first call
+template <typename T>
+static void hostMatmul(vector<T>& memory,
+                       const size_t M, const size_t N, const size_t K,
+                       const size_t packedCalc,
+                       const bool transposeA,
+                       const bool transposeB,
+                       const bool generalizedMatmul) {
+    const size_t sizeA = M * K, sizeB = K * N, sizeC = M * N;
+    memory.resize(packedCalc * (sizeA + sizeB + sizeC), 1);
+
+    for (size_t pIdx = 0; pIdx < packedCalc; pIdx++) {
+        T *A = &memory[pIdx * (sizeA + sizeB + sizeC)];
+        T *B = A + sizeA;
+        T *C = B + sizeB;
+
+        for (size_t i = 0; i < M; i++)
+        for (size_t j = 0; j < N; j++) {
+            T accum = 0;
+            for (size_t k = 0; k < K; k++)
+                accum += (transposeA ? A[k * M + i] : A[i * K + k])
+                       * (transposeB ? B[j * K + k] : B[k * N + j]);
+            C[i * N + j] = generalizedMatmul ? accum + C[i * N + j] : accum;
+        }
+    }
+}
+
+bool KernelBaseMatmul::hostReference() {
+    if (sizeof(double) == elementSize())
+        hostMatmul(_hostDouble, dimM(), dimN(), dimK(), packedCalc(),
+                   transposeA(), transposeB(), generalizedMatmul());
+    else
+        hostMatmul(_hostFloat, dimM(), dimN(), dimK(), packedCalc(),
+                   transposeA(), transposeB(), generalizedMatmul());
+    return true;
+}
+
 }; // namespace
@@ -88,7 +88,7 @@ class MatmulWorkGroup
     size_t _dimHeight;
     size_t _dimWidth;
 
-    // add one to avoid local memory bank conflicts
+    // add one to avoid local memory bank conflicts, unless tuned
     static const size_t LOCALMEM_PAD = 1;
 
 public:
@@ -110,9 +110,9 @@ public:
     size_t groupSize() const;
 
     // for memory buffer kernels
-    size_t localHeight() const;
-    size_t localWidth() const;
-    size_t localSize() const;
+    size_t localHeight(const size_t pad = LOCALMEM_PAD) const;
+    size_t localWidth(const size_t pad = LOCALMEM_PAD) const;
+    size_t localSize(const size_t pad = LOCALMEM_PAD) const;
 };
 
 ////////////////////////////////////////
@@ -180,6 +180,9 @@ public:
 
     size_t numberVariations() const;
     void setParam(const size_t value);
+
+    // only the first choice is valid unless the dimension is searched
+    bool validParam(const bool searched) const;
 };
 
 ////////////////////////////////////////
@@ -215,6 +218,87 @@ struct MatmulParamGlobalID : public MatmulExtraParameterObserver
     bool globalID() const;
 };
 
+////////////////////////////////////////
+// MatmulParamOptimizeExpr
+
+struct MatmulParamOptimizeExpr : public MatmulExtraParameterObserver
+{
+    MatmulParamOptimizeExpr(MatmulExtraParameter& subject);
+
+    // fold constants and hoist loop invariant addresses in generated source
+    bool optimizeExpr() const;
+};
+
+////////////////////////////////////////
+// MatmulParamPrefetch
+
+struct MatmulParamPrefetch : public MatmulExtraParameterObserver
+{
+    MatmulParamPrefetch(MatmulExtraParameter& subject);
+
+    // next tiles of A and B are read into registers while the current tiles
+    // are used, then stored in a second local memory buffer
+    bool prefetchTiles() const;
+};
+
+////////////////////////////////////////
+// MatmulParamLocalLayout
+
+struct MatmulParamLocalLayout : public MatmulExtraParameterObserver
+{
+    MatmulParamLocalLayout(MatmulExtraParameter& subject);
+
+    // padding of each row of blocks in local memory
+    size_t localPad() const;
+
+    // columns of blocks in local memory are XORed with the row instead
+    bool swizzleLocal() const;
+};
+
+////////////////////////////////////////
+// MatmulParamGroupSizeAttr
+
+struct MatmulParamGroupSizeAttr : public MatmulExtraParameterObserver
+{
+    MatmulParamGroupSizeAttr(MatmulExtraParameter& subject);
+
+    // kernel is declared with the work group size it is enqueued with, as a
+    // requirement or a hint, so the compiler may specialize for it
+    bool reqdWorkGroupSize() const;
+    bool workGroupSizeHint() const;
+};
+
+////////////////////////////////////////
+// MatmulParamBuildOptions
+
+struct MatmulParamBuildOptions : public MatmulExtraParameterObserver
+{
+    MatmulParamBuildOptions(MatmulExtraParameter& subject);
+
+    // OpenCL compiler options, some trade accuracy for speed
+    std::string buildOptionSet() const;
+};
+
+////////////////////////////////////////
+// MatmulParamUnroll
+
+struct MatmulParamUnroll : public MatmulExtraParameterObserver
+{
+    MatmulParamUnroll(MatmulExtraParameter& subject);
+
+    // loop body is repeated this many times per iteration, fully unrolled
+    // loops are all steps without the loop
+    size_t unrollFactor(const size_t tripCount) const;
+    bool fullUnroll() const;
+
+    // unrolling must divide the loop evenly, loops are left as they are
+    // unless unrolling is searched
+    bool validUnroll(const size_t tripCount, const bool searched) const;
+
+    // loop index at a step of the unrolled body
+    ConstantValue<std::string> unrolledIndex(const Value& index, const size_t step) const;
+};
+
 ////////////////////////////////////////
 // MatmulAttrAutoVec
 
@@ -272,6 +356,102 @@ public:
     size_t packedCalc() const;
 };
 
+////////////////////////////////////////
+// MatmulSearchBuildOptions
+
+class MatmulSearchBuildOptions
+{
+    // build options are searched only when output is checked against the
+    // host reference, otherwise wrong answers may be fastest
+    bool _searchBuildOptions; // default value is false
+
+public:
+    MatmulSearchBuildOptions();
+
+    void setSearchBuildOptions(const bool value);
+    bool getSearchBuildOptions() const;
+};
+
+////////////////////////////////////////
+// MatmulSearchUnroll
+
+class MatmulSearchUnroll
+{
+    // unrolling multiplies the extra parameter space by four, so it is
+    // searched only when asked for
+    bool _searchUnroll; // default value is false
+
+public:
+    MatmulSearchUnroll();
+
+    void setSearchUnroll(const bool value);
+    bool getSearchUnroll() const;
+};
+
+////////////////////////////////////////
+// MatmulSearchOptimizeExpr
+
+class MatmulSearchOptimizeExpr
+{
+    // optimized expressions double the extra parameter space, so
+    // they are searched only when asked for
+    bool _searchOptimizeExpr; // default value is false
+
+public:
+    MatmulSearchOptimizeExpr();
+
+    void setSearchOptimizeExpr(const bool value);
+    bool getSearchOptimizeExpr() const;
+};
+
+////////////////////////////////////////
+// MatmulSearchGroupSizeAttr
+
+class MatmulSearchGroupSizeAttr
+{
+    // work group size attributes triple the extra parameter space,
+    // so they are searched only when asked for
+    bool _searchGroupSizeAttr; // default value is false
+
+public:
+    MatmulSearchGroupSizeAttr();
+
+    void setSearchGroupSizeAttr(const bool value);
+    bool getSearchGroupSizeAttr() const;
+};
+
+////////////////////////////////////////
+// MatmulSearchLocalTiles
+
+class MatmulSearchLocalTiles
+{
+    // prefetching and layouts of tiles in local memory multiply the
+    // extra parameter space by eight, so they are searched only when asked for
+    bool _searchLocalTiles; // default value is false
+
+public:
+    MatmulSearchLocalTiles();
+
+    void setSearchLocalTiles(const bool value);
+    bool getSearchLocalTiles() const;
+};
+
+////////////////////////////////////////
+// MatmulLocalMemory
+
+class MatmulLocalMemory
+{
+    // tiles of wide vector types may not fit in the local memory of the
+    // device, so parameters are checked against it
+    size_t _localMemorySize; // bytes, default value is zero for unknown
+
+public:
+    MatmulLocalMemory();
+
+    void setLocalMemorySize(const size_t bytes);
+    size_t localMemorySize() const;
+};
+
 ////////////////////////////////////////
 // KernelBaseMatmul
 
@@ -283,12 +463,40 @@ class KernelBaseMatmul : public KernelInterface,
                          protected MatmulExtraParameter,
                          protected MatmulAttrAutoVec,
                          protected MatmulGeneralized,
-                         protected MatmulPackedCalc
+                         protected MatmulPackedCalc,
+                         protected MatmulSearchBuildOptions,
+                         protected MatmulSearchUnroll,
+                         protected MatmulSearchOptimizeExpr,
+                         protected MatmulSearchGroupSizeAttr,
+                         protected MatmulSearchLocalTiles,
+                         protected MatmulLocalMemory
 {
+    // host reference memory for each packed kernel
+    std::vector<float>  _hostFloat;
+    std::vector<double> _hostDouble;
+
 public:
     // some OpenCL platforms do not support auto vectorize attribute
     using MatmulAttrAutoVec::setUseAttrAutoVec;
 
+    // build options are part of the extra parameter when searched
+    using MatmulSearchBuildOptions::setSearchBuildOptions;
+
+    // loop unrolling is part of the extra parameter when searched
+    using MatmulSearchUnroll::setSearchUnroll;
+
+    // expression optimization is part of the extra parameter when searched
+    using MatmulSearchOptimizeExpr::setSearchOptimizeExpr;
+
+    // work group size attributes are part of the extra parameter when searched
+    using MatmulSearchGroupSizeAttr::setSearchGroupSizeAttr;
+
+    // local memory tiles are part of the extra parameter when searched
+    using MatmulSearchLocalTiles::setSearchLocalTiles;
+
+    // device limit for the local memory of a work group
+    using MatmulLocalMemory::setLocalMemorySize;
+
     // packed kernel support
     using MatmulPackedCalc::setPackedCalc;
 
@@ -326,6 +534,15 @@ protected:
     KernelBaseMatmul();
     virtual ~KernelBaseMatmul();
 
+    // tiles of A and B are shared by the work group through local memory
+    virtual bool localMemoryTiles() const { return false; }
+
+    // bytes of local memory used by one work group
+    virtual size_t localMemoryBytes() const { return 0; }
+
+    // some extra parameter choices do not apply to every work group
+    virtual bool validExtraParam() const { return true; }
+
     // inner product accumulation
     template <typename SCALAR, size_t VECTOR_LENGTH>
     std::string assignMAD(const Vector< VecType<SCALAR, VECTOR_LENGTH> >& accum,
@@ -426,6 +643,10 @@ public:
     std::vector<size_t> localWorkItems() const;
 
     size_t numberFlops() const;
+    size_t bytesMoved() const;
+    size_t bytesMovedLocal() const;
+
+    bool hostReference();
 };
 
 }; // namespace
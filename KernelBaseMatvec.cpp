@@ -92,23 +92,19 @@ size_t MatvecInnerBlocking::wholeHeight() const { return blockHeight() / vectorL
 size_t MatvecInnerBlocking::fractHeight() const { return blockHeight() % vectorLength(); }
 
 ConstantValue<string> MatvecInnerBlocking::multHeight(const Value& valSize) const {
-    switch (fractHeight()) {
-        case (0) : return wholeHeight() * valSize;
-        case (1) : return (wholeHeight() * valSize + valSize / vectorLength());
-        case (2) : return (wholeHeight() * valSize + valSize / 2);
-        case (3) : return (wholeHeight() * valSize + 3 * valSize / vectorLength());
-    }
-    return ConstantValue<string>(""); // should never happen
+    size_t numer = fractHeight(), denom = vectorLength();
+    if (0 == numer) return wholeHeight() * valSize;
+    reduceFraction(numer, denom);
+    return 1 == numer
+               ? (wholeHeight() * valSize + valSize / denom)
+               : (wholeHeight() * valSize + numer * valSize / denom);
 }
 
 size_t MatvecInnerBlocking::multHeight(const size_t valSize) const {
-    switch (fractHeight()) {
-        case (0) : return wholeHeight() * valSize;
-        case (1) : return (wholeHeight() * valSize + valSize / vectorLength());
-        case (2) : return (wholeHeight() * valSize + valSize / 2);
-        case (3) : return (wholeHeight() * valSize + 3 * valSize / vectorLength());
-    }
-    return 0; // should never happen
+    size_t numer = fractHeight(), denom = vectorLength();
+    if (0 == numer) return wholeHeight() * valSize;
+    reduceFraction(numer, denom);
+    return wholeHeight() * valSize + numer * valSize / denom;
 }
 
 ////////////////////////////////////////
@@ -124,6 +120,7 @@ MatvecExtraParameterObserver::MatvecExtraParameterObserver(const size_t numberVa
 size_t MatvecExtraParameterObserver::numberVariations() const { return _numberVariations; }
 size_t MatvecExtraParameterObserver::getParam() const { return _paramValue; }
 void MatvecExtraParameterObserver::setParam(const size_t value) { _paramValue = value; }
+bool MatvecExtraParameterObserver::validParam(const bool searched) const { return searched || 0 == _paramValue; }
 
 MatvecExtraParameter::MatvecExtraParameter()
     : _extraParam(0), _totalVariations(1)
@@ -174,6 +171,78 @@ MatvecParamGlobalID::MatvecParamGlobalID(MatvecExtraParameter& subject)
 
 bool MatvecParamGlobalID::globalID() const { return getParam(); }
 
+////////////////////////////////////////
+// MatvecParamOptimizeExpr
+
+MatvecParamOptimizeExpr::MatvecParamOptimizeExpr(MatvecExtraParameter& subject)
+    : MatvecExtraParameterObserver(2, subject)
+{ }
+
+bool MatvecParamOptimizeExpr::optimizeExpr() const { return getParam(); }
+
+////////////////////////////////////////
+// MatvecParamGroupSizeAttr
+
+// no attribute, reqd_work_group_size or work_group_size_hint
+MatvecParamGroupSizeAttr::MatvecParamGroupSizeAttr(MatvecExtraParameter& subject)
+    : MatvecExtraParameterObserver(3, subject)
+{ }
+
+bool MatvecParamGroupSizeAttr::reqdWorkGroupSize() const { return 1 == getParam(); }
+bool MatvecParamGroupSizeAttr::workGroupSizeHint() const { return 2 == getParam(); }
+
+////////////////////////////////////////
+// MatvecParamBuildOptions
+
+// the first choice is no options so that extra parameter values from before
+// build options were searched keep their meaning
+static const char* BUILD_OPTION_SETS[] = {
+    "",
+    "-cl-mad-enable",
+    "-cl-mad-enable -cl-no-signed-zeros",
+    "-cl-fast-relaxed-math",
+    "-cl-unsafe-math-optimizations" };
+
+MatvecParamBuildOptions::MatvecParamBuildOptions(MatvecExtraParameter& subject)
+    : MatvecExtraParameterObserver(sizeof(BUILD_OPTION_SETS) / sizeof(const char*), subject)
+{ }
+
+std::string MatvecParamBuildOptions::buildOptionSet() const { return BUILD_OPTION_SETS[getParam()]; }
+
+////////////////////////////////////////
+// MatvecParamUnroll
+
+// no unrolling, by two, by four or fully (zero)
+static const size_t UNROLL_FACTOR[] = { 1, 2, 4, 0 };
+
+// longer loops are not fully unrolled so the kernel source stays small
+static const size_t MAX_FULL_UNROLL = 64;
+
+MatvecParamUnroll::MatvecParamUnroll(MatvecExtraParameter& subject)
+    : MatvecExtraParameterObserver(sizeof(UNROLL_FACTOR) / sizeof(size_t), subject)
+{ }
+
+size_t MatvecParamUnroll::unrollFactor(const size_t tripCount) const {
+    return fullUnroll() ? tripCount : UNROLL_FACTOR[getParam()];
+}
+
+bool MatvecParamUnroll::fullUnroll() const { return 0 == UNROLL_FACTOR[getParam()]; }
+
+bool MatvecParamUnroll::validUnroll(const size_t tripCount, const bool searched) const {
+    if (1 == UNROLL_FACTOR[getParam()]) return true;
+    if (! searched) return false;
+    return fullUnroll()
+               ? tripCount <= MAX_FULL_UNROLL
+               : 0 == tripCount % unrollFactor(tripCount);
+}
+
+ConstantValue<std::string> MatvecParamUnroll::unrolledIndex(const Value& index, const size_t step) const {
+    if (fullUnroll())
+        return ConstantValue<std::string>(ExprArena::current().number(step));
+    else
+        return 0 == step ? ConstantValue<std::string>(index) : index + step;
+}
+
 ////////////////////////////////////////
 // MatvecAttrAutoVec
 
@@ -217,6 +286,46 @@ bool MatvecPackedCalc::packedChanged() const { return _packedChanged; }
 
 size_t MatvecPackedCalc::packedCalc() const { return _packedCalc; }
 
+////////////////////////////////////////
+// MatvecSearchBuildOptions
+
+MatvecSearchBuildOptions::MatvecSearchBuildOptions()
+    : _searchBuildOptions(false)
+{ }
+
+void MatvecSearchBuildOptions::setSearchBuildOptions(const bool value) { _searchBuildOptions = value; }
+bool MatvecSearchBuildOptions::getSearchBuildOptions() const { return _searchBuildOptions; }
+
+////////////////////////////////////////
+// MatvecSearchUnroll
+
+MatvecSearchUnroll::MatvecSearchUnroll()
+    : _searchUnroll(false)
+{ }
+
+void MatvecSearchUnroll::setSearchUnroll(const bool value) { _searchUnroll = value; }
+bool MatvecSearchUnroll::getSearchUnroll() const { return _searchUnroll; }
+
+////////////////////////////////////////
+// MatvecSearchOptimizeExpr
+
+MatvecSearchOptimizeExpr::MatvecSearchOptimizeExpr()
+    : _searchOptimizeExpr(false)
+{ }
+
+void MatvecSearchOptimizeExpr::setSearchOptimizeExpr(const bool value) { _searchOptimizeExpr = value; }
+bool MatvecSearchOptimizeExpr::getSearchOptimizeExpr() const { return _searchOptimizeExpr; }
+
+////////////////////////////////////////
+// MatvecSearchGroupSizeAttr
+
+MatvecSearchGroupSizeAttr::MatvecSearchGroupSizeAttr()
+    : _searchGroupSizeAttr(false)
+{ }
+
+void MatvecSearchGroupSizeAttr::setSearchGroupSizeAttr(const bool value) { _searchGroupSizeAttr = value; }
+bool MatvecSearchGroupSizeAttr::getSearchGroupSizeAttr() const { return _searchGroupSizeAttr; }
+
 ////////////////////////////////////////
 // KernelBaseMatvec
 
@@ -228,7 +337,11 @@ KernelBaseMatvec::KernelBaseMatvec()
       MatvecExtraParameter(),
       MatvecAttrAutoVec(),
       MatvecGeneralized(),
-      MatvecPackedCalc()
+      MatvecPackedCalc(),
+      MatvecSearchBuildOptions(),
+      MatvecSearchUnroll(),
+      MatvecSearchOptimizeExpr(),
+      MatvecSearchGroupSizeAttr()
 { }
 
 KernelBaseMatvec::~KernelBaseMatvec() { }
@@ -253,7 +366,11 @@ bool KernelBaseMatvec::validParams() const {
         0 == blockHeight() % vectorLength() &&
 
         // extra parameter
-        extraParam() < totalVariations();
+        extraParam() < totalVariations() &&
+        validExtraParam() &&
+
+        // build options only when searched
+        (getSearchBuildOptions() || buildOptions().empty());
 }
 
 bool KernelBaseMatvec::getParams(vector<size_t>& params) const {
@@ -340,4 +457,47 @@ size_t KernelBaseMatvec::numberFlops() const {
         return packedCalc() * dimM() * (2 * dimN() - 1);
 }
 
+size_t KernelBaseMatvec::bytesMoved() const {
+    // every work item reads all of vector B for its block of rows
+    const size_t readA = dimM() * dimN();
+    const size_t readB = dimN() * (dimM() / blockHeight());
+    const size_t rwC = (generalizedMatvec() ? 2 : 1) * dimM();
+    return packedCalc() * elementSize() * (readA + readB + rwC);
+}
+
+// straightforward inner products, memory holds A, B and C for each packed
+// kernel and is allocated on the first call
+template <typename T>
+static void hostMatvec(vector<T>& memory,
+                       const size_t M, const size_t N,
+                       const size_t packedCalc,
+                       const bool transposeA,
+                       const bool generalizedMatvec) {
+    const size_t sizeA = M * N, sizeB = N, sizeC = M;
+    memory.resize(packedCalc * (sizeA + sizeB + sizeC), 1);
+
+    for (size_t pIdx = 0; pIdx < packedCalc; pIdx++) {
+        T *A = &memory[pIdx * (sizeA + sizeB + sizeC)];
+        T *B = A + sizeA;
+        T *C = B + sizeB;
+
+        for (size_t i = 0; i < M; i++) {
+            T accum = 0;
+            for (size_t k = 0; k < N; k++)
+                accum += (transposeA ? A[k * M + i] : A[i * N + k]) * B[k];
+            C[i] = generalizedMatvec ? accum + C[i] : accum;
+        }
+    }
+}
+
+bool KernelBaseMatvec::hostReference() {
+    if (sizeof(double) == elementSize())
+        hostMatvec(_hostDouble, dimM(), dimN(), packedCalc(),
+                   transposeA(), generalizedMatvec());
+    else
+        hostMatvec(_hostFloat, dimM(), dimN(), packedCalc(),
+                   transposeA(), generalizedMatvec());
+    return true;
+}
+
 }; // namespace
@@ -166,6 +166,9 @@ public:
 
     size_t numberVariations() const;
     void setParam(const size_t value);
+
+    // only the first choice is valid unless the dimension is searched
+    bool validParam(const bool searched) const;
 };
 
 ////////////////////////////////////////
@@ -190,6 +193,61 @@ struct MatvecParamGlobalID : public MatvecExtraParameterObserver
     bool globalID() const;
 };
 
+////////////////////////////////////////
+// MatvecParamOptimizeExpr
+
+struct MatvecParamOptimizeExpr : public MatvecExtraParameterObserver
+{
+    MatvecParamOptimizeExpr(MatvecExtraParameter& subject);
+
+    // fold constants and hoist loop invariant addresses in generated source
+    bool optimizeExpr() const;
+};
+
+////////////////////////////////////////
+// MatvecParamGroupSizeAttr
+
+struct MatvecParamGroupSizeAttr : public MatvecExtraParameterObserver
+{
+    MatvecParamGroupSizeAttr(MatvecExtraParameter& subject);
+
+    // kernel is declared with the work group size it is enqueued with, as a
+    // requirement or a hint, so the compiler may specialize for it
+    bool reqdWorkGroupSize() const;
+    bool workGroupSizeHint() const;
+};
+
+////////////////////////////////////////
+// MatvecParamBuildOptions
+
+struct MatvecParamBuildOptions : public MatvecExtraParameterObserver
+{
+    MatvecParamBuildOptions(MatvecExtraParameter& subject);
+
+    // OpenCL compiler options, some trade accuracy for speed
+    std::string buildOptionSet() const;
+};
+
+////////////////////////////////////////
+// MatvecParamUnroll
+
+struct MatvecParamUnroll : public MatvecExtraParameterObserver
+{
+    MatvecParamUnroll(MatvecExtraParameter& subject);
+
+    // loop body is repeated this many times per iteration, fully unrolled
+    // loops are all steps without the loop
+    size_t unrollFactor(const size_t tripCount) const;
+    bool fullUnroll() const;
+
+    // unrolling must divide the loop evenly, loops are left as they are
+    // unless unrolling is searched
+    bool validUnroll(const size_t tripCount, const bool searched) const;
+
+    // loop index at a step of the unrolled body
+    ConstantValue<std::string> unrolledIndex(const Value& index, const size_t step) const;
+};
+
 ////////////////////////////////////////
 // MatvecAttrAutoVec
 
@@ -247,6 +305,70 @@ public:
     size_t packedCalc() const;
 };
 
+////////////////////////////////////////
+// MatvecSearchBuildOptions
+
+class MatvecSearchBuildOptions
+{
+    // build options are searched only when output is checked against the
+    // host reference, otherwise wrong answers may be fastest
+    bool _searchBuildOptions; // default value is false
+
+public:
+    MatvecSearchBuildOptions();
+
+    void setSearchBuildOptions(const bool value);
+    bool getSearchBuildOptions() const;
+};
+
+////////////////////////////////////////
+// MatvecSearchUnroll
+
+class MatvecSearchUnroll
+{
+    // unrolling multiplies the extra parameter space by four, so it is
+    // searched only when asked for
+    bool _searchUnroll; // default value is false
+
+public:
+    MatvecSearchUnroll();
+
+    void setSearchUnroll(const bool value);
+    bool getSearchUnroll() const;
+};
+
+////////////////////////////////////////
+// MatvecSearchOptimizeExpr
+
+class MatvecSearchOptimizeExpr
+{
+    // optimized expressions double the extra parameter space, so
+    // they are searched only when asked for
+    bool _searchOptimizeExpr; // default value is false
+
+public:
+    MatvecSearchOptimizeExpr();
+
+    void setSearchOptimizeExpr(const bool value);
+    bool getSearchOptimizeExpr() const;
+};
+
+////////////////////////////////////////
+// MatvecSearchGroupSizeAttr
+
+class MatvecSearchGroupSizeAttr
+{
+    // work group size attributes triple the extra parameter space,
+    // so they are searched only when asked for
+    bool _searchGroupSizeAttr; // default value is false
+
+public:
+    MatvecSearchGroupSizeAttr();
+
+    void setSearchGroupSizeAttr(const bool value);
+    bool getSearchGroupSizeAttr() const;
+};
+
 ////////////////////////////////////////
 // KernelBaseMatvec
 
@@ -258,12 +380,32 @@ class KernelBaseMatvec : public KernelInterface,
                          protected MatvecExtraParameter,
                          protected MatvecAttrAutoVec,
                          protected MatvecGeneralized,
-                         protected MatvecPackedCalc
+                         protected MatvecPackedCalc,
+                         protected MatvecSearchBuildOptions,
+                         protected MatvecSearchUnroll,
+                         protected MatvecSearchOptimizeExpr,
+                         protected MatvecSearchGroupSizeAttr
 {
+    // host reference memory for each packed kernel
+    std::vector<float>  _hostFloat;
+    std::vector<double> _hostDouble;
+
 public:
     // some OpenCL platforms do not support auto vectorize attribute
     using MatvecAttrAutoVec::setUseAttrAutoVec;
 
+    // build options are part of the extra parameter when searched
+    using MatvecSearchBuildOptions::setSearchBuildOptions;
+
+    // loop unrolling is part of the extra parameter when searched
+    using MatvecSearchUnroll::setSearchUnroll;
+
+    // expression optimization is part of the extra parameter when searched
+    using MatvecSearchOptimizeExpr::setSearchOptimizeExpr;
+
+    // work group size attributes are part of the extra parameter when searched
+    using MatvecSearchGroupSizeAttr::setSearchGroupSizeAttr;
+
     // packed kernel support
     using MatvecPackedCalc::setPackedCalc;
 
@@ -297,6 +439,9 @@ protected:
     KernelBaseMatvec();
     virtual ~KernelBaseMatvec();
 
+    // some extra parameter choices do not apply to every problem size
+    virtual bool validExtraParam() const { return true; }
+
     // matrix vector product accumulation
     template <typename SCALAR, size_t VECTOR_LENGTH>
     std::string assignMAD(const Var< VecType<SCALAR, VECTOR_LENGTH> >& accum,
@@ -318,6 +463,9 @@ public:
     std::vector<size_t> localWorkItems() const;
 
     size_t numberFlops() const;
+    size_t bytesMoved() const;
+
+    bool hostReference();
 };
 
 }; // namespace
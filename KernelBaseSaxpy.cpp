@@ -85,23 +85,19 @@ size_t SaxpyInnerBlocking::fractHeight() const { return blockHeight() % vectorLe
 size_t SaxpyInnerBlocking::wholeWidth() const { return blockWidth() / vectorLength(); }
 
 ConstantValue<string> SaxpyInnerBlocking::multHeight(const Value& valSize) const {
-    switch (fractHeight()) {
-        case (0) : return wholeHeight() * valSize;
-        case (1) : return (wholeHeight() * valSize + valSize / vectorLength());
-        case (2) : return (wholeHeight() * valSize + valSize / 2);
-        case (3) : return (wholeHeight() * valSize + 3 * valSize / vectorLength());
-    }
-    return ConstantValue<string>(""); // should never happen
+    size_t numer = fractHeight(), denom = vectorLength();
+    if (0 == numer) return wholeHeight() * valSize;
+    reduceFraction(numer, denom);
+    return 1 == numer
+               ? (wholeHeight() * valSize + valSize / denom)
+               : (wholeHeight() * valSize + numer * valSize / denom);
 }
 
 size_t SaxpyInnerBlocking::multHeight(const size_t valSize) const {
-    switch (fractHeight()) {
-        case (0) : return wholeHeight() * valSize;
-        case (1) : return (wholeHeight() * valSize + valSize / vectorLength());
-        case (2) : return (wholeHeight() * valSize + valSize / 2);
-        case (3) : return (wholeHeight() * valSize + 3 * valSize / vectorLength());
-    }
-    return 0; // should never happen
+    size_t numer = fractHeight(), denom = vectorLength();
+    if (0 == numer) return wholeHeight() * valSize;
+    reduceFraction(numer, denom);
+    return wholeHeight() * valSize + numer * valSize / denom;
 }
 
 ////////////////////////////////////////
@@ -117,6 +113,7 @@ SaxpyExtraParameterObserver::SaxpyExtraParameterObserver(const size_t numberVari
 size_t SaxpyExtraParameterObserver::numberVariations() const { return _numberVariations; }
 size_t SaxpyExtraParameterObserver::getParam() const { return _paramValue; }
 void SaxpyExtraParameterObserver::setParam(const size_t value) { _paramValue = value; }
+bool SaxpyExtraParameterObserver::validParam(const bool searched) const { return searched || 0 == _paramValue; }
 
 SaxpyExtraParameter::SaxpyExtraParameter()
     : _extraParam(0), _totalVariations(1)
@@ -167,6 +164,44 @@ SaxpyParamGlobalID::SaxpyParamGlobalID(SaxpyExtraParameter& subject)
 
 bool SaxpyParamGlobalID::globalID() const { return getParam(); }
 
+////////////////////////////////////////
+// SaxpyParamOptimizeExpr
+
+SaxpyParamOptimizeExpr::SaxpyParamOptimizeExpr(SaxpyExtraParameter& subject)
+    : SaxpyExtraParameterObserver(2, subject)
+{ }
+
+bool SaxpyParamOptimizeExpr::optimizeExpr() const { return getParam(); }
+
+////////////////////////////////////////
+// SaxpyParamGroupSizeAttr
+
+// no attribute, reqd_work_group_size or work_group_size_hint
+SaxpyParamGroupSizeAttr::SaxpyParamGroupSizeAttr(SaxpyExtraParameter& subject)
+    : SaxpyExtraParameterObserver(3, subject)
+{ }
+
+bool SaxpyParamGroupSizeAttr::reqdWorkGroupSize() const { return 1 == getParam(); }
+bool SaxpyParamGroupSizeAttr::workGroupSizeHint() const { return 2 == getParam(); }
+
+////////////////////////////////////////
+// SaxpyParamBuildOptions
+
+// the first choice is no options so that extra parameter values from before
+// build options were searched keep their meaning
+static const char* BUILD_OPTION_SETS[] = {
+    "",
+    "-cl-mad-enable",
+    "-cl-mad-enable -cl-no-signed-zeros",
+    "-cl-fast-relaxed-math",
+    "-cl-unsafe-math-optimizations" };
+
+SaxpyParamBuildOptions::SaxpyParamBuildOptions(SaxpyExtraParameter& subject)
+    : SaxpyExtraParameterObserver(sizeof(BUILD_OPTION_SETS) / sizeof(const char*), subject)
+{ }
+
+std::string SaxpyParamBuildOptions::buildOptionSet() const { return BUILD_OPTION_SETS[getParam()]; }
+
 ////////////////////////////////////////
 // SaxpyAttrAutoVec
 
@@ -193,6 +228,36 @@ bool SaxpyPackedCalc::packedChanged() const { return _packedChanged; }
 
 size_t SaxpyPackedCalc::packedCalc() const { return _packedCalc; }
 
+////////////////////////////////////////
+// SaxpySearchBuildOptions
+
+SaxpySearchBuildOptions::SaxpySearchBuildOptions()
+    : _searchBuildOptions(false)
+{ }
+
+void SaxpySearchBuildOptions::setSearchBuildOptions(const bool value) { _searchBuildOptions = value; }
+bool SaxpySearchBuildOptions::getSearchBuildOptions() const { return _searchBuildOptions; }
+
+////////////////////////////////////////
+// SaxpySearchOptimizeExpr
+
+SaxpySearchOptimizeExpr::SaxpySearchOptimizeExpr()
+    : _searchOptimizeExpr(false)
+{ }
+
+void SaxpySearchOptimizeExpr::setSearchOptimizeExpr(const bool value) { _searchOptimizeExpr = value; }
+bool SaxpySearchOptimizeExpr::getSearchOptimizeExpr() const { return _searchOptimizeExpr; }
+
+////////////////////////////////////////
+// SaxpySearchGroupSizeAttr
+
+SaxpySearchGroupSizeAttr::SaxpySearchGroupSizeAttr()
+    : _searchGroupSizeAttr(false)
+{ }
+
+void SaxpySearchGroupSizeAttr::setSearchGroupSizeAttr(const bool value) { _searchGroupSizeAttr = value; }
+bool SaxpySearchGroupSizeAttr::getSearchGroupSizeAttr() const { return _searchGroupSizeAttr; }
+
 ////////////////////////////////////////
 // KernelBaseSaxpy
 
@@ -202,7 +267,10 @@ KernelBaseSaxpy::KernelBaseSaxpy()
       SaxpyInnerBlocking(),
       SaxpyExtraParameter(),
       SaxpyAttrAutoVec(),
-      SaxpyPackedCalc()
+      SaxpyPackedCalc(),
+      SaxpySearchBuildOptions(),
+      SaxpySearchOptimizeExpr(),
+      SaxpySearchGroupSizeAttr()
 { }
 
 KernelBaseSaxpy::~KernelBaseSaxpy() { }
@@ -227,7 +295,11 @@ bool KernelBaseSaxpy::validParams() const {
         0 == blockWidth() % vectorLength() &&
 
         // extra parameter
-        extraParam() < totalVariations();
+        extraParam() < totalVariations() &&
+        validExtraParam() &&
+
+        // build options only when searched
+        (getSearchBuildOptions() || buildOptions().empty());
 }
 
 bool KernelBaseSaxpy::getParams(vector<size_t>& params) const {
@@ -304,4 +376,36 @@ size_t KernelBaseSaxpy::numberFlops() const {
     return packedCalc() * 2 * dimM() * dimN();
 }
 
+size_t KernelBaseSaxpy::bytesMoved() const {
+    // read X and Y, write Z
+    return packedCalc() * elementSize() * 3 * dimM() * dimN();
+}
+
+// Z = alpha * X + Y, memory holds X, Y and Z for each packed kernel and is
+// allocated on the first call
+template <typename T>
+static void hostSaxpy(vector<T>& memory,
+                      const size_t length,
+                      const size_t packedCalc) {
+    memory.resize(packedCalc * 3 * length, 1);
+
+    const T alpha = 1;
+    for (size_t pIdx = 0; pIdx < packedCalc; pIdx++) {
+        T *X = &memory[pIdx * 3 * length];
+        T *Y = X + length;
+        T *Z = Y + length;
+
+        for (size_t i = 0; i < length; i++)
+            Z[i] = alpha * X[i] + Y[i];
+    }
+}
+
+bool KernelBaseSaxpy::hostReference() {
+    if (sizeof(double) == elementSize())
+        hostSaxpy(_hostDouble, dimM() * dimN(), packedCalc());
+    else
+        hostSaxpy(_hostFloat, dimM() * dimN(), packedCalc());
+    return true;
+}
+
 }; // namespace
@@ -145,6 +145,9 @@ public:
 
     size_t numberVariations() const;
     void setParam(const size_t value);
+
+    // only the first choice is valid unless the dimension is searched
+    bool validParam(const bool searched) const;
 };
 
 ////////////////////////////////////////
@@ -169,6 +172,41 @@ struct SaxpyParamGlobalID : public SaxpyExtraParameterObserver
     bool globalID() const;
 };
 
+////////////////////////////////////////
+// SaxpyParamOptimizeExpr
+
+struct SaxpyParamOptimizeExpr : public SaxpyExtraParameterObserver
+{
+    SaxpyParamOptimizeExpr(SaxpyExtraParameter& subject);
+
+    // fold constants and hoist loop invariant addresses in generated source
+    bool optimizeExpr() const;
+};
+
+////////////////////////////////////////
+// SaxpyParamGroupSizeAttr
+
+struct SaxpyParamGroupSizeAttr : public SaxpyExtraParameterObserver
+{
+    SaxpyParamGroupSizeAttr(SaxpyExtraParameter& subject);
+
+    // kernel is declared with the work group size it is enqueued with, as a
+    // requirement or a hint, so the compiler may specialize for it
+    bool reqdWorkGroupSize() const;
+    bool workGroupSizeHint() const;
+};
+
+////////////////////////////////////////
+// SaxpyParamBuildOptions
+
+struct SaxpyParamBuildOptions : public SaxpyExtraParameterObserver
+{
+    SaxpyParamBuildOptions(SaxpyExtraParameter& subject);
+
+    // OpenCL compiler options, some trade accuracy for speed
+    std::string buildOptionSet() const;
+};
+
 ////////////////////////////////////////
 // SaxpyAttrAutoVec
 
@@ -205,6 +243,54 @@ public:
     size_t packedCalc() const;
 };
 
+////////////////////////////////////////
+// SaxpySearchBuildOptions
+
+class SaxpySearchBuildOptions
+{
+    // build options are searched only when output is checked against the
+    // host reference, otherwise wrong answers may be fastest
+    bool _searchBuildOptions; // default value is false
+
+public:
+    SaxpySearchBuildOptions();
+
+    void setSearchBuildOptions(const bool value);
+    bool getSearchBuildOptions() const;
+};
+
+////////////////////////////////////////
+// SaxpySearchOptimizeExpr
+
+class SaxpySearchOptimizeExpr
+{
+    // optimized expressions double the extra parameter space, so
+    // they are searched only when asked for
+    bool _searchOptimizeExpr; // default value is false
+
+public:
+    SaxpySearchOptimizeExpr();
+
+    void setSearchOptimizeExpr(const bool value);
+    bool getSearchOptimizeExpr() const;
+};
+
+////////////////////////////////////////
+// SaxpySearchGroupSizeAttr
+
+class SaxpySearchGroupSizeAttr
+{
+    // work group size attributes triple the extra parameter space,
+    // so they are searched only when asked for
+    bool _searchGroupSizeAttr; // default value is false
+
+public:
+    SaxpySearchGroupSizeAttr();
+
+    void setSearchGroupSizeAttr(const bool value);
+    bool getSearchGroupSizeAttr() const;
+};
+
 ////////////////////////////////////////
 // KernelBaseSaxpy
 
@@ -214,12 +300,28 @@ class KernelBaseSaxpy : public KernelInterface,
                         protected SaxpyInnerBlocking,
                         protected SaxpyExtraParameter,
                         protected SaxpyAttrAutoVec,
-                        protected SaxpyPackedCalc
+                        protected SaxpyPackedCalc,
+                        protected SaxpySearchBuildOptions,
+                        protected SaxpySearchOptimizeExpr,
+                        protected SaxpySearchGroupSizeAttr
 {
+    // host reference memory for each packed kernel
+    std::vector<float>  _hostFloat;
+    std::vector<double> _hostDouble;
+
 public:
     // some OpenCL platforms do not support auto vectorize attribute
     using SaxpyAttrAutoVec::setUseAttrAutoVec;
 
+    // build options are part of the extra parameter when searched
+    using SaxpySearchBuildOptions::setSearchBuildOptions;
+
+    // expression optimization is part of the extra parameter when searched
+    using SaxpySearchOptimizeExpr::setSearchOptimizeExpr;
+
+    // work group size attributes are part of the extra parameter when searched
+    using SaxpySearchGroupSizeAttr::setSearchGroupSizeAttr;
+
     // packed kernel support
     using SaxpyPackedCalc::setPackedCalc;
 
@@ -253,6 +355,9 @@ protected:
     KernelBaseSaxpy();
     virtual ~KernelBaseSaxpy();
 
+    // some extra parameter choices are searched only when asked for
+    virtual bool validExtraParam() const { return true; }
+
 public:
     bool validParams() const;
     bool getParams(std::vector<size_t>& params) const;
@@ -262,6 +367,9 @@ public:
     std::vector<size_t> localWorkItems() const;
 
     size_t numberFlops() const;
+    size_t bytesMoved() const;
+
+    bool hostReference();
 };
 
 }; // namespace
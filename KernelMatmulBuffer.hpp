@@ -26,7 +26,13 @@
 template <typename SCALAR, size_t VECTOR_LENGTH>
 class KernelMatmulBuffer : public KernelBaseMatmul,
                            protected MatmulParamInlineMNK,
-                           protected MatmulParamLoopOrder
+                           protected MatmulParamLoopOrder,
+                           protected MatmulParamOptimizeExpr,
+                           protected MatmulParamPrefetch,
+                           protected MatmulParamLocalLayout,
+                           protected MatmulParamGroupSizeAttr,
+                           protected MatmulParamBuildOptions,
+                           protected MatmulParamUnroll
 {
     typedef SCALAR scalar;
     typedef VecType< SCALAR, VECTOR_LENGTH > scalarN;
@@ -39,11 +45,112 @@ class KernelMatmulBuffer : public KernelBaseMatmul,
     bool _paranoidCheck;
     scalar *_paranoidC;
 
+    // blocks of A and B are staged in local memory
+    bool localMemoryTiles() const { return true; }
+
+    // swizzled columns stay inside aligned runs as long as the lowest power
+    // of two dividing the work group size, so odd sizes can not swizzle
+    size_t swizzleMask() const { return (groupSize() & (0 - groupSize())) - 1; }
+    bool validExtraParam() const {
+        return MatmulParamOptimizeExpr::validParam(getSearchOptimizeExpr()) &&
+               MatmulParamPrefetch::validParam(getSearchLocalTiles()) &&
+               MatmulParamLocalLayout::validParam(getSearchLocalTiles()) &&
+               MatmulParamGroupSizeAttr::validParam(getSearchGroupSizeAttr()) &&
+               (! swizzleLocal() || swizzleMask() > 0) && validUnroll(groupSize(), getSearchUnroll());
+    }
+
+    // scalar elements of the tiles (prefetching uses two buffers of blocks)
+    size_t numberElemsTmpA() const {
+        return (prefetchTiles() ? 2 : 1) * localSize(localPad()) * groupSize() * VECTOR_LENGTH * blockHeight();
+    }
+    size_t numberElemsTmpB() const {
+        return (prefetchTiles() ? 2 : 1) * localSize(localPad()) * groupSize() * VECTOR_LENGTH * VECTOR_LENGTH;
+    }
+    size_t localMemoryBytes() const {
+        return (numberElemsTmpA() + numberElemsTmpB()) * sizeof(scalar);
+    }
+
+    // column in local memory of an element of a block
+    ConstantValue<std::string> localColumn(const Value& column, const Value& localRow) const {
+        return swizzleLocal()
+                   ? (column ^ (localRow & swizzleMask()))
+                   : ConstantValue<std::string>(column);
+    }
+
+    // advance to the next blocks of A and B
+    void nextBlocks(std::ostream& os,
+                    const Var< const scalarN* >& ptrMatA,
+                    const Var< const scalarN* >& ptrMatB,
+                    const Var< const int >& M,
+                    const Var< const int >& N) const {
+        if (transposeA())
+            os << increment(ptrMatA, M * groupSize());
+        else
+            os << increment(ptrMatA, groupSize());
+
+        if (transposeB())
+            os << increment(ptrMatB, groupSize());
+        else
+            os << increment(ptrMatB, N * groupSize());
+    }
+
+    // inner product accumulation over the blocks in local memory
+    void innerProduct(std::ostream& os,
+                      const Var< const scalarN* >& ptrA,
+                      const Var< const scalarN* >& ptrB,
+                      const Vector< scalarN >& valA,
+                      const Vector< scalarN >& valB,
+                      const Vector< scalarN >& accum) const {
+        // the loop over the columns of the blocks is unrolled on the host,
+        // pointers advance once for all steps of an iteration
+        Var< int > jdx("jdx");
+        const size_t unroll = unrollFactor(groupSize());
+        if (! fullUnroll()) os << ForLoop(jdx, groupSize(), unroll);
+
+        for (size_t u = 0; u < unroll; u++) {
+            const ConstantValue<std::string> column = unrolledIndex(jdx, u);
+            const bool advance = ! swizzleLocal() && ! fullUnroll() && unroll - 1 == u;
+
+            // read in values of tmpA
+            for (size_t j = 0; j < blockHeight(); j++)
+                os << assign(valA[j], swizzleLocal()
+                                          ? *(ptrA + j * localSize(localPad())
+                                                   + localColumn(column, blockHeight() * row + j))
+                                          : (0 == u
+                                                 ? *(ptrA + j * localSize(localPad()))
+                                                 : *(ptrA + j * localSize(localPad()) + u)));
+
+            if (advance) os << increment(ptrA, unroll);
+
+            // read in values of tmpB
+            for (size_t j = 0; j < VECTOR_LENGTH; j++)
+                os << assign(valB[j], swizzleLocal()
+                                          ? *(ptrB + j * localSize(localPad())
+                                                   + localColumn(column, VECTOR_LENGTH * col + j))
+                                          : (0 == u
+                                                 ? *(ptrB + j * localSize(localPad()))
+                                                 : *(ptrB + j * localSize(localPad()) + u)));
+
+            if (advance) os << increment(ptrB, unroll);
+
+            // inner product accumulation
+            assignMAD(os, loopOrder(), accum, valA, valB);
+        }
+
+        if (! fullUnroll()) os << EndBlock();
+    }
+
 public:
     KernelMatmulBuffer()
         : KernelBaseMatmul(),
           MatmulParamInlineMNK(getExtraParameter()),
           MatmulParamLoopOrder(getExtraParameter()),
+          MatmulParamOptimizeExpr(getExtraParameter()),
+          MatmulParamPrefetch(getExtraParameter()),
+          MatmulParamLocalLayout(getExtraParameter()),
+          MatmulParamGroupSizeAttr(getExtraParameter()),
+          MatmulParamBuildOptions(getExtraParameter()),
+          MatmulParamUnroll(getExtraParameter()),
           _handleA(-1),
           _handleB(-1),
           _handleC(-1),
@@ -61,6 +168,10 @@ public:
         return ss.str();
     }
 
+    std::string buildOptions() const { return buildOptionSet(); }
+
+    size_t elementSize() const { return sizeof(SCALAR); }
+
     void paranoidCheck() {
         _paranoidCheck = true;
         delete[] _paranoidC;
@@ -71,6 +182,26 @@ public:
         return syncBufferFromDevice(oclApp, _handleC);
     }
 
+    std::vector<size_t> inputBuffers() const {
+        std::vector<size_t> handles;
+        handles.push_back(_handleA);
+        handles.push_back(_handleB);
+        return handles;
+    }
+
+    std::vector<size_t> outputBuffers() const {
+        return std::vector<size_t>(1, _handleC);
+    }
+
+    bool setBufferArgs(OCLApp& oclApp,
+                       const size_t kernelHandle,
+                       const std::vector<size_t>& inputs,
+                       const std::vector<size_t>& outputs) {
+        return setArgGlobal(oclApp, kernelHandle, 0, outputs[0], "matC") &&
+               setArgGlobal(oclApp, kernelHandle, 1, inputs[0], "matA") &&
+               setArgGlobal(oclApp, kernelHandle, 2, inputs[1], "matB");
+    }
+
     bool checkOutput(OCLApp& oclApp, const bool printOutput) {
         if (_paranoidCheck) {
             return checkBuffer<scalar>(oclApp, _handleC, dimN(), packedCalc() * dimM(), _paranoidC, printOutput);
@@ -83,8 +214,11 @@ public:
     bool setArgs(OCLApp& oclApp, const size_t kernelHandle, const bool syncInput) {
 
         // buffer allocation
-        if (-1 == _handleA || -1 == _handleB || -1 == _handleC || dimChanged()) {
-            oclApp.releaseBuffers();
+        if (-1 == _handleA || -1 == _handleB || -1 == _handleC || dimChanged() || packedChanged()) {
+            // return old buffers to the pool, new ones may reuse them
+            if (-1 != _handleA) oclApp.releaseBuffer(_handleA);
+            if (-1 != _handleB) oclApp.releaseBuffer(_handleB);
+            if (-1 != _handleC) oclApp.releaseBuffer(_handleC);
             _handleA = createBufferR<scalar, VECTOR_LENGTH>(oclApp, packedCalc() * dimM() * dimK(), "matA", 1);
             _handleB = createBufferR<scalar, VECTOR_LENGTH>(oclApp, packedCalc() * dimK() * dimN(), "matB", 1);
             _handleC = generalizedMatmul()
@@ -147,15 +281,13 @@ public:
         }
 
         // set kernel arguments
-        const size_t numberElemsTmpA = localSize() * groupSize() * VECTOR_LENGTH * blockHeight();
-        const size_t numberElemsTmpB = localSize() * groupSize() * VECTOR_LENGTH * VECTOR_LENGTH;
         size_t argIndex = 0;
         bool rc =
             setArgGlobal(oclApp, kernelHandle, argIndex++, _handleC, "matC") &&
             setArgGlobal(oclApp, kernelHandle, argIndex++, _handleA, "matA") &&
             setArgGlobal(oclApp, kernelHandle, argIndex++, _handleB, "matB") &&
-            setArgLocal<scalar>(oclApp, kernelHandle, argIndex++, numberElemsTmpA, "tmpA") &&
-            setArgLocal<scalar>(oclApp, kernelHandle, argIndex++, numberElemsTmpB, "tmpB");
+            setArgLocal<scalar>(oclApp, kernelHandle, argIndex++, numberElemsTmpA(), "tmpA") &&
+            setArgLocal<scalar>(oclApp, kernelHandle, argIndex++, numberElemsTmpB(), "tmpB");
         if (! inlineMNK()) {
             rc = rc &&
             setArgValue<int>(oclApp, kernelHandle, argIndex++, dimM(), "M") &&
@@ -173,14 +305,21 @@ public:
     // prints the kernel source
     std::ostream& print(std::ostream& os) const {
 
+        // constant folding of index arithmetic
+        ExprFoldingScope folding(optimizeExpr());
+
         pragma_extension<scalar>(os);
 
         // kernel function attributes
         AutoVectorize< scalarN > attrAutoVec;
+        RequiredWorkGroupSize attrReqdSize(localWorkItems());
+        WorkGroupSizeHint attrSizeHint(localWorkItems());
         FunctionDeclaration kernelDecl(kernelName());
         kernelDecl.returnType<void>();
         kernelDecl.qualify(KERNEL);
         if (getUseAttrAutoVec()) kernelDecl.qualify(attrAutoVec);
+        if (reqdWorkGroupSize()) kernelDecl.qualify(attrReqdSize);
+        if (workGroupSizeHint()) kernelDecl.qualify(attrSizeHint);
 
         // kernel arguments
         Var< scalarN* >       matC("matC", GLOBAL, kernelDecl);
@@ -225,6 +364,11 @@ public:
         Vector< scalarN > valB("valB", VECTOR_LENGTH);
         os << declare(valB);
 
+        // next blocks of A and B read from global memory
+        Vector< scalarN > preA("preA", blockHeight());
+        Vector< scalarN > preB("preB", VECTOR_LENGTH);
+        if (prefetchTiles()) os << declare(preA) << declare(preB);
+
         // packed kernel support
         Var< int > pIdx("pIdx", 1 == packedCalc(), 0);
         if (1 != packedCalc()) os << ForLoop(pIdx, packedCalc(), 1);
@@ -254,87 +398,188 @@ public:
                                            + N * row
                                            + pIdx * K * N / VECTOR_LENGTH);
 
-            // outer loop over blocks
+            // row strides of A, B and C in vector elements, the multiplies by
+            // these are repeated for every unrolled row
+            Var< const int > strideA("strideA");
+            Var< const int > strideB("strideB");
+            Var< const int > strideC("strideC");
+            const bool namedStrides = optimizeExpr() && ! inlineMNK();
+            const ConstantValue<std::string> rowA
+                = hoist(os, strideA, (transposeA() ? M : K) / VECTOR_LENGTH, namedStrides);
+            const ConstantValue<std::string> rowB
+                = hoist(os, strideB, (transposeB() ? K : N) / VECTOR_LENGTH, namedStrides);
+            const ConstantValue<std::string> rowC
+                = hoist(os, strideC, N / VECTOR_LENGTH, namedStrides);
+
+            // local memory addresses are invariant over the outer loop,
+            // swizzled stores are not as the column depends on the row
+            const bool hoistStores = optimizeExpr() && ! swizzleLocal();
+            Var< scalarN* const >       storeA("storeA", LOCAL);
+            Var< scalarN* const >       storeB("storeB", LOCAL);
+            Var< const scalarN* const > loadA("loadA", LOCAL);
+            Var< const scalarN* const > loadB("loadB", LOCAL);
+            const ConstantValue<std::string> baseStoreA
+                = hoist(os, storeA, transposeA()
+                                        ? tmpA + localSize(localPad()) * blockHeight() * row + col
+                                        : tmpA + localSize(localPad()) * row + col,
+                        hoistStores);
+            const ConstantValue<std::string> baseStoreB
+                = hoist(os, storeB, transposeB()
+                                        ? tmpB + localSize(localPad()) * row + col
+                                        : tmpB + localSize(localPad()) * VECTOR_LENGTH * col + row,
+                        hoistStores);
+            const ConstantValue<std::string> baseLoadA
+                = hoist(os, loadA, tmpA + localSize(localPad()) * blockHeight() * row, optimizeExpr());
+            const ConstantValue<std::string> baseLoadB
+                = hoist(os, loadB, tmpB + localSize(localPad()) * VECTOR_LENGTH * col, optimizeExpr());
+
+            // elements of the blocks of A and B this work item copies and
+            // where they go in local memory, rows row + i * groupSize() swizzle
+            // the same as row
+            std::vector< ConstantValue<std::string> > globalA, localA;
+            if (transposeA())
+                for (size_t i = 0; i < blockHeight(); i++) {
+                    const size_t blockNum = i / VECTOR_LENGTH;
+                    const size_t blockIdx = i % VECTOR_LENGTH;
+                    localA.push_back(hoistStores
+                                         ? baseStoreA + localSize(localPad()) * i
+                                         : tmpA + localSize(localPad()) * (blockHeight() * row + i)
+                                                + localColumn(col, blockHeight() * row + i));
+                    globalA.push_back(optimizeExpr()
+                                          ? *(ptrMatA + blockNum + blockIdx * rowA)
+                                          : *(ptrMatA + blockNum + blockIdx * M / VECTOR_LENGTH));
+                }
+            else
+                for (size_t i = 0; i < blockHeight(); i++) {
+                    localA.push_back(hoistStores
+                                         ? baseStoreA + localSize(localPad()) * i * groupSize()
+                                         : tmpA + localSize(localPad()) * (row + i * groupSize())
+                                                + localColumn(col, row));
+                    globalA.push_back(optimizeExpr()
+                                          ? *(ptrMatA + i * groupSize() * rowA)
+                                          : *(ptrMatA + i * groupSize() * K / VECTOR_LENGTH));
+                }
+
+            std::vector< ConstantValue<std::string> > globalB, localB;
+            for (size_t i = 0; i < VECTOR_LENGTH; i++)
+                if (transposeB()) {
+                    localB.push_back(hoistStores
+                                         ? baseStoreB + localSize(localPad()) * i * groupSize()
+                                         : tmpB + localSize(localPad()) * (row + i * groupSize())
+                                                + localColumn(col, row));
+                    globalB.push_back(optimizeExpr()
+                                          ? *(ptrMatB + i * groupSize() * rowB)
+                                          : *(ptrMatB + i * groupSize() * K / VECTOR_LENGTH));
+                } else {
+                    localB.push_back(hoistStores
+                                         ? baseStoreB + localSize(localPad()) * i
+                                         : tmpB + localSize(localPad()) * (VECTOR_LENGTH * col + i)
+                                                + localColumn(row, VECTOR_LENGTH * col + i));
+                    globalB.push_back(optimizeExpr()
+                                          ? *(ptrMatB + i * rowB)
+                                          : *(ptrMatB + i * N / VECTOR_LENGTH));
+                }
+
             Var< int > idx("idx");
-            os << ForLoop(idx, K / (groupSize() * VECTOR_LENGTH), 1);
-
-                // copy block of A
-                if (transposeA())
-                    for (size_t i = 0; i < blockHeight(); i++) {
-                        const size_t blockNum = i / VECTOR_LENGTH;
-                        const size_t blockIdx = i % VECTOR_LENGTH;
-                        os << assign(*(tmpA + localSize() * (blockHeight() * row + i) + col),
-                                     *(ptrMatA + blockNum + blockIdx * M / VECTOR_LENGTH));
-                    }
-                else
-                    for (size_t i = 0; i < blockHeight(); i++)
-                        os << assign(*(tmpA + localSize() * (row + i * groupSize()) + col),
-                                     *(ptrMatA + i * groupSize() * K / VECTOR_LENGTH));
 
-                // copy block of B
+            if (prefetchTiles()) {
+
+                // first blocks go in the first buffer
+                for (size_t i = 0; i < blockHeight(); i++)
+                    os << assign(*localA[i], globalA[i]);
                 for (size_t i = 0; i < VECTOR_LENGTH; i++)
-                    if (transposeB())
-                        os << assign(*(tmpB + localSize() * (row + i * groupSize()) + col),
-                                     *(ptrMatB + i * groupSize() * K / VECTOR_LENGTH));
-                    else
-                        os << assign(*(tmpB + localSize() * (VECTOR_LENGTH * col + i) + row),
-                                     *(ptrMatB + i * N / VECTOR_LENGTH));
-
-                // barrier
+                    os << assign(*localB[i], globalB[i]);
+
                 os << LocalBarrier();
 
-                // next block for A
-                if (transposeA())
-                    os << increment(ptrMatA, M * groupSize());
-                else
-                    os << increment(ptrMatA, groupSize());
+                nextBlocks(os, ptrMatA, ptrMatB, M, N);
 
-                // next block for B
-                if (transposeB())
-                    os << increment(ptrMatB, groupSize());
-                else
-                    os << increment(ptrMatB, N * groupSize());
+                // buffer used for the inner product, the other one is filled
+                const size_t tileA = localSize(localPad()) * groupSize() * blockHeight();
+                const size_t tileB = localSize(localPad()) * groupSize() * VECTOR_LENGTH;
+                Var< int > cur("cur");
+                os << declare(cur, 0);
 
-                // for inner product
-                os << assign(ptrA, tmpA + localSize() * blockHeight() * row);
-                os << assign(ptrB, tmpB + localSize() * VECTOR_LENGTH * col);
+                // outer loop over all blocks but the last
+                os << ForLoop(idx, K / (groupSize() * VECTOR_LENGTH) - 1, 1);
 
-                // inner product accumulation
-                Var< int > jdx("jdx");
-                os << ForLoop(jdx, groupSize(), 1);
+                    // global memory reads of the next blocks are in flight
+                    // during the inner product
+                    for (size_t i = 0; i < blockHeight(); i++)
+                        os << assign(preA[i], globalA[i]);
+                    for (size_t i = 0; i < VECTOR_LENGTH; i++)
+                        os << assign(preB[i], globalB[i]);
 
-                    // read in values of tmpA
-                    for (size_t j = 0; j < blockHeight(); j++)
-                        os << assign(valA[j], *(ptrA + j * localSize()));
+                    nextBlocks(os, ptrMatA, ptrMatB, M, N);
 
-                    os << increment(ptrA, 1);
+                    os << assign(ptrA, baseLoadA + cur * tileA);
+                    os << assign(ptrB, baseLoadB + cur * tileB);
+                    innerProduct(os, ptrA, ptrB, valA, valB, accum);
 
-                    // read in values of tmpB
-                    for (size_t j = 0; j < VECTOR_LENGTH; j++)
-                        os << assign(valB[j], *(ptrB + j * localSize()));
+                    // the other buffer is not read until after the barrier
+                    for (size_t i = 0; i < blockHeight(); i++)
+                        os << assign(*(localA[i] + (1 - cur) * tileA), preA[i]);
+                    for (size_t i = 0; i < VECTOR_LENGTH; i++)
+                        os << assign(*(localB[i] + (1 - cur) * tileB), preB[i]);
 
-                    os << increment(ptrB, 1);
+                    os << LocalBarrier();
 
-                    // inner product accumulation
-                    assignMAD(os, loopOrder(), accum, valA, valB);
+                    os << assign(cur, 1 - cur);
 
                 os << EndBlock();
 
-            os << EndBlock();
+                // last blocks
+                os << assign(ptrA, baseLoadA + cur * tileA);
+                os << assign(ptrB, baseLoadB + cur * tileB);
+                innerProduct(os, ptrA, ptrB, valA, valB, accum);
+
+                // next packed kernel overwrites the first buffer
+                if (1 != packedCalc()) os << LocalBarrier();
+
+            } else {
+
+                // outer loop over blocks
+                os << ForLoop(idx, K / (groupSize() * VECTOR_LENGTH), 1);
+
+                    // copy block of A
+                    for (size_t i = 0; i < blockHeight(); i++)
+                        os << assign(*localA[i], globalA[i]);
+
+                    // copy block of B
+                    for (size_t i = 0; i < VECTOR_LENGTH; i++)
+                        os << assign(*localB[i], globalB[i]);
+
+                    // barrier
+                    os << LocalBarrier();
+
+                    nextBlocks(os, ptrMatA, ptrMatB, M, N);
+
+                    // for inner product
+                    os << assign(ptrA, baseLoadA);
+                    os << assign(ptrB, baseLoadB);
+
+                    innerProduct(os, ptrA, ptrB, valA, valB, accum);
+
+                os << EndBlock();
+            }
 
-            const ConstantValue<std::string> outC = matC + multHeight(N) * globalRow + globalCol + pIdx * M * N / VECTOR_LENGTH;
+            Var< scalarN* const > ptrMatC("ptrMatC", GLOBAL);
+            const ConstantValue<std::string> outC
+                = hoist(os, ptrMatC,
+                        matC + multHeight(N) * globalRow + globalCol + pIdx * M * N / VECTOR_LENGTH,
+                        optimizeExpr());
 
             for (size_t i = 0; i < blockHeight(); i++)
                 if (generalizedMatmul())
-                    os << assign(*(outC + i * (N / VECTOR_LENGTH)),
+                    os << assign(*(outC + i * rowC),
                                  true //isfloat<SCALAR>()
                                      ? MADValue(CastValue<scalarN>(alpha),
                                                 accum[i],
-                                                CastValue<scalarN>(beta) * *(outC + i * (N / VECTOR_LENGTH)))
+                                                CastValue<scalarN>(beta) * *(outC + i * rowC))
                                      : CastValue<scalarN>(alpha) * accum[i] +
-                                       CastValue<scalarN>(beta) * *(outC + i * (N / VECTOR_LENGTH)));
+                                       CastValue<scalarN>(beta) * *(outC + i * rowC));
                 else
-                    os << assign(*(outC + i * (N / VECTOR_LENGTH)), accum[i]);
+                    os << assign(*(outC + i * rowC), accum[i]);
 
         if (1 != packedCalc()) os << EndBlock();
 
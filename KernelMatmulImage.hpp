@@ -27,7 +27,11 @@ template <typename SCALAR, size_t VECTOR_LENGTH>
 class KernelMatmulImage : public KernelBaseMatmul,
                           protected MatmulParamInlineMNK,
                           protected MatmulParamLoopOrder,
-                          protected MatmulParamGlobalID
+                          protected MatmulParamGlobalID,
+                          protected MatmulParamOptimizeExpr,
+                          protected MatmulParamGroupSizeAttr,
+                          protected MatmulParamBuildOptions,
+                          protected MatmulParamUnroll
 {
     typedef SCALAR scalar;
     typedef VecType< SCALAR, VECTOR_LENGTH > scalarN; // float4 or double2
@@ -42,12 +46,23 @@ class KernelMatmulImage : public KernelBaseMatmul,
     bool _paranoidCheck;
     scalar *_paranoidC;
 
+    // the inner product loop is over K
+    bool validExtraParam() const {
+        return MatmulParamOptimizeExpr::validParam(getSearchOptimizeExpr()) &&
+               MatmulParamGroupSizeAttr::validParam(getSearchGroupSizeAttr()) &&
+               validUnroll(dimK() / VECTOR_LENGTH, getSearchUnroll());
+    }
+
 public:
     KernelMatmulImage()
         : KernelBaseMatmul(),
           MatmulParamInlineMNK(getExtraParameter()),
           MatmulParamLoopOrder(getExtraParameter()),
           MatmulParamGlobalID(getExtraParameter()),
+          MatmulParamOptimizeExpr(getExtraParameter()),
+          MatmulParamGroupSizeAttr(getExtraParameter()),
+          MatmulParamBuildOptions(getExtraParameter()),
+          MatmulParamUnroll(getExtraParameter()),
           _spQuad(isfloat<SCALAR>() && 4 == VECTOR_LENGTH),
           _handleA(-1),
           _handleB(-1),
@@ -66,6 +81,10 @@ public:
         return ss.str();
     }
 
+    std::string buildOptions() const { return buildOptionSet(); }
+
+    size_t elementSize() const { return sizeof(SCALAR); }
+
     void paranoidCheck() {
         _paranoidCheck = true;
         delete[] _paranoidC;
@@ -191,14 +210,21 @@ public:
     // prints the kernel source
     std::ostream& print(std::ostream& os) const {
 
+        // constant folding of index arithmetic
+        ExprFoldingScope folding(optimizeExpr());
+
         pragma_extension<scalar>(os);
 
         // kernel function attributes
         AutoVectorize< scalarN > attrAutoVec;
+        RequiredWorkGroupSize attrReqdSize(localWorkItems());
+        WorkGroupSizeHint attrSizeHint(localWorkItems());
         FunctionDeclaration kernelDecl(kernelName());
         kernelDecl.returnType<void>();
         kernelDecl.qualify(KERNEL);
         if (getUseAttrAutoVec()) kernelDecl.qualify(attrAutoVec);
+        if (reqdWorkGroupSize()) kernelDecl.qualify(attrReqdSize);
+        if (workGroupSizeHint()) kernelDecl.qualify(attrSizeHint);
 
         // kernel arguments
         Var< image2d_t > matC_img("matC", WRITEONLY, kernelDecl, !generalizedMatmul());
@@ -237,9 +263,24 @@ public:
             // set accumulators to zero
             os << assign(accum, CastValue<scalarN>(ConstantValue<scalar>(0)));
 
-            // inner product loop
+            // image coordinates of A and B are invariant over the inner product loop
+            Var< const int > coordA("coordA");
+            Var< const int > coordB("coordB");
+            const ConstantValue<std::string> baseCoordA
+                = hoist(os, coordA, transposeA()
+                                        ? wholeHeight() * globalRow
+                                        : blockHeight() * globalRow + pIdx * M,
+                        optimizeExpr());
+            const ConstantValue<std::string> baseCoordB
+                = hoist(os, coordB, VECTOR_LENGTH * globalCol + pIdx * N, optimizeExpr() && transposeB());
+
+            // inner product loop, unrolled on the host
             Var< int > idx("idx");
-            os << ForLoop(idx, K / VECTOR_LENGTH, 1);
+            const size_t unroll = unrollFactor(dimK() / VECTOR_LENGTH);
+            if (! fullUnroll()) os << ForLoop(idx, K / VECTOR_LENGTH, unroll);
+
+            for (size_t u = 0; u < unroll; u++) {
+                const ConstantValue<std::string> index = unrolledIndex(idx, u);
 
                 // read in values of matrix A
                 if (transposeA())
@@ -249,8 +290,10 @@ public:
                         os << assign(valA[j],
                                      ReinterpretValue<SCALAR, VECTOR_LENGTH>(
                                          ReadImage<scalar>(matA, sampler,
-                                                           wholeHeight() * globalRow + blockNum,
-                                                           VECTOR_LENGTH * idx + blockIdx + pIdx * K),
+                                                           optimizeExpr()
+                                                               ? baseCoordA + blockNum
+                                                               : wholeHeight() * globalRow + blockNum,
+                                                           VECTOR_LENGTH * index + blockIdx + pIdx * K),
                                          !_spQuad));
                     }
                 else
@@ -258,8 +301,10 @@ public:
                         os << assign(valA[j],
                                      ReinterpretValue<SCALAR, VECTOR_LENGTH>(
                                          ReadImage<scalar>(matA, sampler,
-                                                           idx,
-                                                           blockHeight() * globalRow + j + pIdx * M),
+                                                           index,
+                                                           optimizeExpr()
+                                                               ? baseCoordA + j
+                                                               : blockHeight() * globalRow + j + pIdx * M),
                                          !_spQuad));
 
                 // read in values of matrix B
@@ -268,24 +313,31 @@ public:
                         os << assign(valB[j],
                                      ReinterpretValue<SCALAR, VECTOR_LENGTH>(
                                          ReadImage<scalar>(matB, sampler,
-                                                           idx,
-                                                           VECTOR_LENGTH * globalCol + j + pIdx * N),
+                                                           index,
+                                                           optimizeExpr()
+                                                               ? baseCoordB + j
+                                                               : VECTOR_LENGTH * globalCol + j + pIdx * N),
                                          !_spQuad));
                     else
                         os << assign(valB[j],
                                      ReinterpretValue<SCALAR, VECTOR_LENGTH>(
                                          ReadImage<scalar>(matB, sampler,
                                                            globalCol,
-                                                           VECTOR_LENGTH * idx + j + pIdx * K),
+                                                           VECTOR_LENGTH * index + j + pIdx * K),
                                          !_spQuad));
 
                 // inner product accumulation
                 assignMAD(os, loopOrder(), accum, valA, valB);
+            }
 
-            os << EndBlock();
+            if (! fullUnroll()) os << EndBlock();
 
             if (generalizedMatmul()) {
-                const ConstantValue<std::string> outC = matC_buf + multHeight(N) * globalRow + globalCol + pIdx * M * N / VECTOR_LENGTH;
+                Var< scalarN* const > ptrMatC("ptrMatC", GLOBAL);
+                const ConstantValue<std::string> outC
+                    = hoist(os, ptrMatC,
+                            matC_buf + multHeight(N) * globalRow + globalCol + pIdx * M * N / VECTOR_LENGTH,
+                            optimizeExpr());
                 for (size_t i = 0; i < blockHeight(); i++)
                     os << assign(*(outC + i * (N / VECTOR_LENGTH)),
                                  true // isfloat<scalar>()
@@ -300,10 +352,15 @@ public:
                 const ConstantValue<std::string> valueGlobalRow = globalID()
                                                                       ? globalRow
                                                                       : groupSize() * blockRow + row;
+                Var< const int > coordC("coordC");
+                const ConstantValue<std::string> baseCoordC
+                    = hoist(os, coordC, blockHeight() * valueGlobalRow + pIdx * M, optimizeExpr());
                 for (size_t i = 0; i < blockHeight(); i++)
                     os << WriteImage<scalar>(matC_img,
                                              valueGlobalCol,
-                                             blockHeight() * valueGlobalRow + i + pIdx * M,
+                                             optimizeExpr()
+                                                 ? baseCoordC + i
+                                                 : blockHeight() * valueGlobalRow + i + pIdx * M,
                                              ReinterpretValue<uint, 4>(accum[i], !_spQuad));
             }
 
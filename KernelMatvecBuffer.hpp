@@ -25,7 +25,11 @@
 // matrix vector multiply using memory buffers
 template <typename SCALAR, size_t VECTOR_LENGTH>
 class KernelMatvecBuffer : public KernelBaseMatvec,
-                           protected MatvecParamInlineMN
+                           protected MatvecParamInlineMN,
+                           protected MatvecParamOptimizeExpr,
+                           protected MatvecParamGroupSizeAttr,
+                           protected MatvecParamBuildOptions,
+                           protected MatvecParamUnroll
 {
     typedef SCALAR scalar;
     typedef VecType< SCALAR, VECTOR_LENGTH > scalarN;
@@ -38,10 +42,21 @@ class KernelMatvecBuffer : public KernelBaseMatvec,
     bool _paranoidCheck;
     scalar *_paranoidC;
 
+    // long loops can not be fully unrolled
+    bool validExtraParam() const {
+        return MatvecParamOptimizeExpr::validParam(getSearchOptimizeExpr()) &&
+               MatvecParamGroupSizeAttr::validParam(getSearchGroupSizeAttr()) &&
+               validUnroll(dimN() / VECTOR_LENGTH, getSearchUnroll());
+    }
+
 public:
     KernelMatvecBuffer()
         : KernelBaseMatvec(),
           MatvecParamInlineMN(getExtraParameter()),
+          MatvecParamOptimizeExpr(getExtraParameter()),
+          MatvecParamGroupSizeAttr(getExtraParameter()),
+          MatvecParamBuildOptions(getExtraParameter()),
+          MatvecParamUnroll(getExtraParameter()),
           _handleA(-1),
           _handleB(-1),
           _handleC(-1),
@@ -59,6 +74,10 @@ public:
         return ss.str();
     }
 
+    std::string buildOptions() const { return buildOptionSet(); }
+
+    size_t elementSize() const { return sizeof(SCALAR); }
+
     void paranoidCheck() {
         _paranoidCheck = true;
         delete[] _paranoidC;
@@ -69,6 +88,26 @@ public:
         return syncBufferFromDevice(oclApp, _handleC);
     }
 
+    std::vector<size_t> inputBuffers() const {
+        std::vector<size_t> handles;
+        handles.push_back(_handleA);
+        handles.push_back(_handleB);
+        return handles;
+    }
+
+    std::vector<size_t> outputBuffers() const {
+        return std::vector<size_t>(1, _handleC);
+    }
+
+    bool setBufferArgs(OCLApp& oclApp,
+                       const size_t kernelHandle,
+                       const std::vector<size_t>& inputs,
+                       const std::vector<size_t>& outputs) {
+        return setArgGlobal(oclApp, kernelHandle, 0, outputs[0], "vecC") &&
+               setArgGlobal(oclApp, kernelHandle, 1, inputs[0], "matA") &&
+               setArgGlobal(oclApp, kernelHandle, 2, inputs[1], "vecB");
+    }
+
     bool checkOutput(OCLApp& oclApp, const bool printOutput) {
         if (_paranoidCheck) {
             return checkBuffer<scalar>(oclApp, _handleC, packedCalc() * dimM(), _paranoidC, printOutput);
@@ -82,7 +121,10 @@ public:
 
         // buffer allocation
         if (-1 == _handleA || -1 == _handleB || -1 == _handleC || dimChanged() || packedChanged()) {
-            oclApp.releaseBuffers();
+            // return old buffers to the pool, new ones may reuse them
+            if (-1 != _handleA) oclApp.releaseBuffer(_handleA);
+            if (-1 != _handleB) oclApp.releaseBuffer(_handleB);
+            if (-1 != _handleC) oclApp.releaseBuffer(_handleC);
             _handleA = createBufferR<scalar, VECTOR_LENGTH>(oclApp, packedCalc() * dimM() * dimN(), "matA", 1);
             _handleB = createBufferR<scalar, VECTOR_LENGTH>(oclApp, packedCalc() * dimN(), "vecB", 1);
             _handleC = generalizedMatvec()
@@ -179,14 +221,21 @@ public:
     // prints the kernel source
     std::ostream& print(std::ostream& os) const {
 
+        // constant folding of index arithmetic
+        ExprFoldingScope folding(optimizeExpr());
+
         pragma_extension<scalar>(os);
 
         // kernel function attributes
         AutoVectorize< scalarN > attrAutoVec;
+        RequiredWorkGroupSize attrReqdSize(localWorkItems());
+        WorkGroupSizeHint attrSizeHint(localWorkItems());
         FunctionDeclaration kernelDecl(kernelName());
         kernelDecl.returnType<void>();
         kernelDecl.qualify(KERNEL);
         if (getUseAttrAutoVec()) kernelDecl.qualify(attrAutoVec);
+        if (reqdWorkGroupSize()) kernelDecl.qualify(attrReqdSize);
+        if (workGroupSizeHint()) kernelDecl.qualify(attrSizeHint);
 
         // kernel arguments
         Var< scalarN* >       vecC("vecC", GLOBAL, kernelDecl);
@@ -265,11 +314,26 @@ public:
         os << LocalBarrier();
  */
 
-            // outer loop over vector B
+            // row stride of A in vector elements, the multiplies by this are
+            // repeated for every unrolled row
+            Var< const int > strideA("strideA");
+            const ConstantValue<std::string> rowA
+                = hoist(os, strideA, (transposeA() ? M : N) / VECTOR_LENGTH, optimizeExpr() && ! inlineMN());
+
+            // packed vector B is invariant over the outer loop
+            Var< const scalarN* const > ptrVecB("ptrVecB", GLOBAL);
+            const ConstantValue<std::string> baseVecB
+                = hoist(os, ptrVecB, vecB + pIdx * N / VECTOR_LENGTH, optimizeExpr() && 1 != packedCalc());
+
+            // outer loop over vector B, unrolled on the host by repeating the body
             Var< int > idx("idx");
-            os << ForLoop(idx, N / VECTOR_LENGTH, 1);
+            const size_t unroll = unrollFactor(dimN() / VECTOR_LENGTH);
+            if (! fullUnroll()) os << ForLoop(idx, N / VECTOR_LENGTH, unroll);
 
-                // read value from vector B
+                for (size_t u = 0; u < unroll; u++) {
+                    const ConstantValue<std::string> column = unrolledIndex(idx, u);
+
+                    // read value from vector B
 /*
  * copying global vector B to local memory causes failures with
  * vector elements on ATI and as scalars are slow, is bad
@@ -278,34 +342,45 @@ public:
  *
             os << assign(valB, *(tmpB + idx));
  */
-                os << assign(valB, *(vecB + idx
-                                          + pIdx * N / VECTOR_LENGTH));
-
-                // inner loop over matrix A
-                for (size_t j = 0; j < blockHeight(); j++) {
-                    const size_t blockNum = j / VECTOR_LENGTH;
-                    const size_t blockIdx = j % VECTOR_LENGTH;
-                    if (transposeA()) {
-                        os << assign(valA, *(ptrMatA + blockNum + blockIdx * M / VECTOR_LENGTH));
-                        for (size_t k = 0; k < VECTOR_LENGTH; k++)
-                            os << assignMAD(accum[blockNum], valA, valB, blockIdx, k);
-                    } else {
-                        os << assign(valA, *(ptrMatA + j * N / VECTOR_LENGTH));
-                        for (size_t k = 0; k < VECTOR_LENGTH; k++)
-                            os << assignMAD(accum[blockNum], valA, valB, blockIdx, k);
+                    if (optimizeExpr())
+                        os << assign(valB, *(baseVecB + column));
+                    else
+                        os << assign(valB, *(vecB + column
+                                                  + pIdx * N / VECTOR_LENGTH));
+
+                    // inner loop over matrix A
+                    for (size_t j = 0; j < blockHeight(); j++) {
+                        const size_t blockNum = j / VECTOR_LENGTH;
+                        const size_t blockIdx = j % VECTOR_LENGTH;
+                        if (transposeA()) {
+                            os << assign(valA, optimizeExpr()
+                                                   ? *(ptrMatA + blockNum + blockIdx * rowA)
+                                                   : *(ptrMatA + blockNum + blockIdx * M / VECTOR_LENGTH));
+                            for (size_t k = 0; k < VECTOR_LENGTH; k++)
+                                os << assignMAD(accum[blockNum], valA, valB, blockIdx, k);
+                        } else {
+                            os << assign(valA, optimizeExpr()
+                                                   ? *(ptrMatA + j * rowA)
+                                                   : *(ptrMatA + j * N / VECTOR_LENGTH));
+                            for (size_t k = 0; k < VECTOR_LENGTH; k++)
+                                os << assignMAD(accum[blockNum], valA, valB, blockIdx, k);
+                        }
                     }
-                }
 
-                // next block column of A
-                if (transposeA())
-                    os << increment(ptrMatA, M);
-                else
-                    os << increment(ptrMatA, 1);
+                    // next block column of A
+                    if (transposeA())
+                        os << increment(ptrMatA, M);
+                    else
+                        os << increment(ptrMatA, 1);
+                }
 
-            os << EndBlock();
+            if (! fullUnroll()) os << EndBlock();
 
-            const ConstantValue<std::string> outC = vecC + wholeHeight() * globalRow
-                                                         + pIdx * M / VECTOR_LENGTH;
+            Var< scalarN* const > ptrVecC("ptrVecC", GLOBAL);
+            const ConstantValue<std::string> outC
+                = hoist(os, ptrVecC,
+                        vecC + wholeHeight() * globalRow + pIdx * M / VECTOR_LENGTH,
+                        optimizeExpr());
 
             for (size_t i = 0; i < wholeHeight(); i++)
                 if (generalizedMatvec())
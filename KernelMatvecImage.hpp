@@ -26,7 +26,11 @@
 template <typename SCALAR, size_t VECTOR_LENGTH>
 class KernelMatvecImage : public KernelBaseMatvec,
                           protected MatvecParamInlineMN,
-                          protected MatvecParamGlobalID
+                          protected MatvecParamGlobalID,
+                          protected MatvecParamOptimizeExpr,
+                          protected MatvecParamGroupSizeAttr,
+                          protected MatvecParamBuildOptions,
+                          protected MatvecParamUnroll
 {
     typedef SCALAR scalar;
     typedef VecType< SCALAR, VECTOR_LENGTH > scalarN;
@@ -41,11 +45,22 @@ class KernelMatvecImage : public KernelBaseMatvec,
     bool _paranoidCheck;
     scalar *_paranoidC;
 
+    // long loops can not be fully unrolled
+    bool validExtraParam() const {
+        return MatvecParamOptimizeExpr::validParam(getSearchOptimizeExpr()) &&
+               MatvecParamGroupSizeAttr::validParam(getSearchGroupSizeAttr()) &&
+               validUnroll(dimN() / VECTOR_LENGTH, getSearchUnroll());
+    }
+
 public:
     KernelMatvecImage()
         : KernelBaseMatvec(),
           MatvecParamInlineMN(getExtraParameter()),
           MatvecParamGlobalID(getExtraParameter()),
+          MatvecParamOptimizeExpr(getExtraParameter()),
+          MatvecParamGroupSizeAttr(getExtraParameter()),
+          MatvecParamBuildOptions(getExtraParameter()),
+          MatvecParamUnroll(getExtraParameter()),
           _spQuad(isfloat<SCALAR>() && 4 == VECTOR_LENGTH),
           _handleA(-1),
           _handleB(-1),
@@ -64,6 +79,10 @@ public:
         return ss.str();
     }
 
+    std::string buildOptions() const { return buildOptionSet(); }
+
+    size_t elementSize() const { return sizeof(SCALAR); }
+
     void paranoidCheck() {
         _paranoidCheck = true;
         delete[] _paranoidC;
@@ -187,14 +206,21 @@ public:
     // prints the kernel source
     std::ostream& print(std::ostream& os) const {
 
+        // constant folding of index arithmetic
+        ExprFoldingScope folding(optimizeExpr());
+
         pragma_extension<scalar>(os);
 
         // kernel function attributes
         AutoVectorize< scalarN > attrAutoVec;
+        RequiredWorkGroupSize attrReqdSize(localWorkItems());
+        WorkGroupSizeHint attrSizeHint(localWorkItems());
         FunctionDeclaration kernelDecl(kernelName());
         kernelDecl.returnType<void>();
         kernelDecl.qualify(KERNEL);
         if (getUseAttrAutoVec()) kernelDecl.qualify(attrAutoVec);
+        if (reqdWorkGroupSize()) kernelDecl.qualify(attrReqdSize);
+        if (workGroupSizeHint()) kernelDecl.qualify(attrSizeHint);
 
         // kernel arguments
         Var< image2d_t > vecC_img("vecC", WRITEONLY, kernelDecl, !generalizedMatvec());
@@ -232,47 +258,68 @@ public:
             // set accumulators to zero
             os << assign(accum, CastValue<scalarN>(ConstantValue<scalar>(0)));
 
-            // outer loop over vector B
+            // image coordinate of matrix A is invariant over the outer loop
+            Var< const int > coordA("coordA");
+            const ConstantValue<std::string> baseCoordA
+                = hoist(os, coordA, transposeA()
+                                        ? wholeHeight() * globalRow
+                                        : blockHeight() * globalRow + pIdx * M,
+                        optimizeExpr());
+
+            // outer loop over vector B, unrolled on the host by repeating the body
             Var< int > idx("idx");
-            os << ForLoop(idx, N / VECTOR_LENGTH, 1);
-
-                // read value from vector B
-                os << assign(valB,
-                             ReinterpretValue<SCALAR, VECTOR_LENGTH>(
-                                 ReadImage<scalar>(vecB, sampler,
-                                                   idx,
-                                                   pIdx),
-                                 !_spQuad));
-
-                // inner loop over matrix A
-                for (size_t j = 0; j < blockHeight(); j++) {
-                    const size_t blockNum = j / VECTOR_LENGTH;
-                    const size_t blockIdx = j % VECTOR_LENGTH;
-                    if (transposeA()) {
-                        os << assign(valA,
-                                     ReinterpretValue<SCALAR, VECTOR_LENGTH>(
-                                         ReadImage<scalar>(matA, sampler,
-                                                           wholeHeight() * globalRow + blockNum,
-                                                           VECTOR_LENGTH * idx + blockIdx + pIdx * N),
-                                         !_spQuad));
-                        for (size_t k = 0; k < VECTOR_LENGTH; k++)
-                            os << assignMAD(accum[blockNum], valA, valB, blockIdx, k);
-                    } else {
-                        os << assign(valA,
-                                     ReinterpretValue<SCALAR, VECTOR_LENGTH>(
-                                         ReadImage<scalar>(matA, sampler,
-                                                           idx,
-                                                           blockHeight() * globalRow + j + pIdx * M),
-                                         !_spQuad));
-                        for (size_t k = 0; k < VECTOR_LENGTH; k++)
-                            os << assignMAD(accum[blockNum], valA, valB, blockIdx, k);
+            const size_t unroll = unrollFactor(dimN() / VECTOR_LENGTH);
+            if (! fullUnroll()) os << ForLoop(idx, N / VECTOR_LENGTH, unroll);
+
+                for (size_t u = 0; u < unroll; u++) {
+                    const ConstantValue<std::string> column = unrolledIndex(idx, u);
+
+                    // read value from vector B
+                    os << assign(valB,
+                                 ReinterpretValue<SCALAR, VECTOR_LENGTH>(
+                                     ReadImage<scalar>(vecB, sampler,
+                                                       column,
+                                                       pIdx),
+                                     !_spQuad));
+
+                    // inner loop over matrix A
+                    for (size_t j = 0; j < blockHeight(); j++) {
+                        const size_t blockNum = j / VECTOR_LENGTH;
+                        const size_t blockIdx = j % VECTOR_LENGTH;
+                        if (transposeA()) {
+                            os << assign(valA,
+                                         ReinterpretValue<SCALAR, VECTOR_LENGTH>(
+                                             ReadImage<scalar>(matA, sampler,
+                                                               optimizeExpr()
+                                                                   ? baseCoordA + blockNum
+                                                                   : wholeHeight() * globalRow + blockNum,
+                                                               VECTOR_LENGTH * column + blockIdx + pIdx * N),
+                                             !_spQuad));
+                            for (size_t k = 0; k < VECTOR_LENGTH; k++)
+                                os << assignMAD(accum[blockNum], valA, valB, blockIdx, k);
+                        } else {
+                            os << assign(valA,
+                                         ReinterpretValue<SCALAR, VECTOR_LENGTH>(
+                                             ReadImage<scalar>(matA, sampler,
+                                                               column,
+                                                               optimizeExpr()
+                                                                   ? baseCoordA + j
+                                                                   : blockHeight() * globalRow + j + pIdx * M),
+                                             !_spQuad));
+                            for (size_t k = 0; k < VECTOR_LENGTH; k++)
+                                os << assignMAD(accum[blockNum], valA, valB, blockIdx, k);
+                        }
                     }
                 }
 
-            os << EndBlock();
+            if (! fullUnroll()) os << EndBlock();
 
             if (generalizedMatvec()) {
-                const ConstantValue<std::string> outC = vecC_buf + wholeHeight() * globalRow + pIdx * M / VECTOR_LENGTH;
+                Var< scalarN* const > ptrVecC("ptrVecC", GLOBAL);
+                const ConstantValue<std::string> outC
+                    = hoist(os, ptrVecC,
+                            vecC_buf + wholeHeight() * globalRow + pIdx * M / VECTOR_LENGTH,
+                            optimizeExpr());
                 for (size_t i = 0; i < wholeHeight(); i++)
                     os << assign(*(outC + i),
                                  MADValue(CastValue<scalarN>(alpha),
@@ -282,9 +329,12 @@ public:
                 const ConstantValue<std::string> valueGlobalRow = globalID()
                                                                       ? globalRow
                                                                       : groupSize() * blockRow + row;
+                Var< const int > coordC("coordC");
+                const ConstantValue<std::string> baseCoordC
+                    = hoist(os, coordC, wholeHeight() * valueGlobalRow, optimizeExpr());
                 for (size_t i = 0; i < wholeHeight(); i++)
                     os << WriteImage<scalar>(vecC_img,
-                                             wholeHeight() * valueGlobalRow + i,
+                                             baseCoordC + i,
                                              pIdx,
                                              ReinterpretValue<uint, 4>(accum[i], !_spQuad));
             }
@@ -38,6 +38,8 @@ public:
     std::string kernelName() const { return "KernelProbeAutoVectorize"; }
 
     size_t numberFlops() const { return 0; }
+    size_t bytesMoved() const { return 0; }
+    size_t elementSize() const { return sizeof(SCALAR); }
 
     void setParams(const std::vector<size_t>& args) {
         _useAttrAutoVec = (1 == args[0]);
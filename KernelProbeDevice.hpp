@@ -0,0 +1,415 @@
+#ifndef _GATLAS_KERNEL_PROBE_DEVICE_HPP_
+#define _GATLAS_KERNEL_PROBE_DEVICE_HPP_
+
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "OCLAppUtil.hpp"
+#include "GatlasBenchmark.hpp"
+#include "GatlasCodeText.hpp"
+#include "GatlasFormatting.hpp"
+#include "GatlasQualifier.hpp"
+#include "GatlasType.hpp"
+
+#include "declare_namespace"
+
+// device characterization microbenchmarks, kernel parameters are:
+// test, number of work items, work group size, loop count
+template <typename SCALAR, size_t VECTOR_LENGTH>
+class KernelProbeDevice : public KernelInterface
+{
+    typedef SCALAR scalar;
+    typedef VecType< SCALAR, VECTOR_LENGTH > scalarN;
+
+public:
+    enum DeviceTest { EMPTY_KERNEL   = 0, // launch latency
+                      GLOBAL_READ    = 1, // coalesced reads
+                      GLOBAL_WRITE   = 2, // coalesced writes
+                      GLOBAL_COPY    = 3, // coalesced reads and writes
+                      LOCAL_READ     = 4, // consecutive work items read consecutive elements
+                      LOCAL_CONFLICT = 5, // consecutive work items read the same bank
+                      IMAGE_READ     = 6, // one pixel is one vector element
+                      MAD_THROUGHPUT = 7, // independent multiply-add chains
+                      NUMBER_TESTS   = 8 };
+
+    // image width in pixels
+    static const size_t IMAGE_WIDTH = 4096;
+
+    // loop body is unrolled this many times, loop counts must be a multiple
+    static const size_t UNROLL = 4;
+
+    // independent multiply-add chains, enough to hide pipeline latency
+    static const size_t MAD_CHAINS = 8;
+
+    // local memory array, small enough for every device
+    static size_t localElements() { return 2048 / VECTOR_LENGTH; }
+
+    // elements between work items for bank conflicts (32 banks of 4 bytes)
+    static size_t conflictStride() {
+        return sizeof(scalar) * VECTOR_LENGTH >= 128 ? 1 : 128 / (sizeof(scalar) * VECTOR_LENGTH);
+    }
+
+    static std::string testName(const size_t test) {
+        switch (test) {
+            case (EMPTY_KERNEL) : return "launch";
+            case (GLOBAL_READ) : return "read";
+            case (GLOBAL_WRITE) : return "write";
+            case (GLOBAL_COPY) : return "copy";
+            case (LOCAL_READ) : return "local";
+            case (LOCAL_CONFLICT) : return "localConflict";
+            case (IMAGE_READ) : return "image";
+            case (MAD_THROUGHPUT) : return "mad";
+        }
+        return "";
+    }
+
+private:
+    size_t _test;
+    size_t _workItems;
+    size_t _groupSize;
+    size_t _loopCount;
+
+    int _handleIn;
+    int _handleOut;
+    size_t _sizeIn;  // vector elements or pixels
+    size_t _sizeOut;
+
+    bool   _imageIn;
+
+    size_t inputElements() const {
+        switch (_test) {
+            case (GLOBAL_READ) :
+            case (GLOBAL_COPY) :
+            case (IMAGE_READ) : return _workItems * _loopCount;
+            case (LOCAL_READ) :
+            case (LOCAL_CONFLICT) : return localElements();
+            case (MAD_THROUGHPUT) : return _workItems;
+        }
+        return 0;
+    }
+
+    size_t outputElements() const {
+        switch (_test) {
+            case (GLOBAL_WRITE) :
+            case (GLOBAL_COPY) : return _workItems * _loopCount;
+            case (GLOBAL_READ) :
+            case (LOCAL_READ) :
+            case (LOCAL_CONFLICT) :
+            case (IMAGE_READ) :
+            case (MAD_THROUGHPUT) : return _workItems;
+        }
+        return 0;
+    }
+
+    // value of every output element when the kernel ran correctly
+    scalar expectedOutput() const {
+        switch (_test) {
+            case (GLOBAL_WRITE) :
+            case (GLOBAL_COPY) : return 1;
+            case (MAD_THROUGHPUT) : return MAD_CHAINS;
+        }
+        return _loopCount;
+    }
+
+public:
+    KernelProbeDevice()
+        : _test(EMPTY_KERNEL),
+          _workItems(1),
+          _groupSize(1),
+          _loopCount(0),
+          _handleIn(-1),
+          _handleOut(-1),
+          _sizeIn(0),
+          _sizeOut(0),
+          _imageIn(false)
+    { }
+
+    std::string kernelName() const {
+        std::stringstream ss;
+        ss << "probedevice" << nameof<SCALAR>() << VECTOR_LENGTH;
+        return ss.str();
+    }
+
+    size_t elementSize() const { return sizeof(SCALAR); }
+
+    size_t numberFlops() const {
+        return MAD_THROUGHPUT == _test
+                   ? _workItems * _loopCount * MAD_CHAINS * 2 * VECTOR_LENGTH
+                   : 0;
+    }
+
+    size_t bytesMoved() const {
+        const size_t elemSize = sizeof(scalar) * VECTOR_LENGTH;
+        switch (_test) {
+            case (GLOBAL_READ) :
+            case (IMAGE_READ) : return elemSize * _workItems * _loopCount;
+            case (GLOBAL_WRITE) : return elemSize * _workItems * _loopCount;
+            case (GLOBAL_COPY) : return 2 * elemSize * _workItems * _loopCount;
+        }
+        return 0;
+    }
+
+    size_t bytesMovedLocal() const {
+        return LOCAL_READ == _test || LOCAL_CONFLICT == _test
+                   ? sizeof(scalar) * VECTOR_LENGTH * _workItems * _loopCount
+                   : 0;
+    }
+
+    bool validParams() const {
+        return
+            _test < NUMBER_TESTS &&
+            0 != _groupSize &&
+            0 == _workItems % _groupSize &&
+            0 == _loopCount % UNROLL &&
+            (EMPTY_KERNEL == _test || 0 != _loopCount) &&
+            (IMAGE_READ != _test || (16 == sizeof(scalar) * VECTOR_LENGTH &&
+                                     0 == _workItems % IMAGE_WIDTH)) &&
+            ((LOCAL_READ != _test && LOCAL_CONFLICT != _test) || 0 == localElements() % _groupSize);
+    }
+
+    bool getParams(std::vector<size_t>& params) const {
+        if (! validParams()) return false;
+        params.clear();
+        params.push_back(_test);
+        params.push_back(_workItems);
+        params.push_back(_groupSize);
+        params.push_back(_loopCount);
+        return true;
+    }
+
+    void setParams(const std::vector<size_t>& params) {
+        _test = params[0];
+        _workItems = params[1];
+        _groupSize = params[2];
+        _loopCount = params[3];
+    }
+
+    void setTest(const size_t test, const size_t workItems, const size_t groupSize, const size_t loopCount) {
+        _test = test;
+        _workItems = workItems;
+        _groupSize = groupSize;
+        _loopCount = loopCount;
+    }
+
+    std::vector<size_t> extraParamDetail() const {
+        return std::vector<size_t>(1, _test);
+    }
+
+    bool setArgs(OCLApp& oclApp, const size_t kernelHandle, const bool syncInput) {
+
+        const bool imageIn = IMAGE_READ == _test;
+
+        // input is all ones, output is cleared so a kernel doing nothing fails
+        if (inputElements() != _sizeIn || imageIn != _imageIn) {
+            if (-1 != _handleIn) {
+                if (_imageIn) oclApp.releaseImages();
+                else oclApp.releaseBuffer(_handleIn);
+            }
+            _handleIn = -1;
+            _sizeIn = inputElements();
+            _imageIn = imageIn;
+            if (0 != _sizeIn) {
+                _handleIn = imageIn
+                                ? createImageR<scalar>(oclApp, IMAGE_WIDTH * VECTOR_LENGTH, _sizeIn / IMAGE_WIDTH, "in", 1)
+                                : createBufferR<scalar, VECTOR_LENGTH>(oclApp, _sizeIn * VECTOR_LENGTH, "in", 1);
+                if (-1 == _handleIn) return false; // failure
+            }
+        } else if (-1 != _handleIn && syncInput) {
+            if (! (_imageIn ? syncImageToDevice(oclApp, _handleIn) : syncBufferToDevice(oclApp, _handleIn)))
+                return false;
+        }
+
+        if (outputElements() != _sizeOut) {
+            if (-1 != _handleOut) oclApp.releaseBuffer(_handleOut);
+            _handleOut = -1;
+            _sizeOut = outputElements();
+            if (0 != _sizeOut) {
+                _handleOut = createBufferW<scalar, VECTOR_LENGTH>(oclApp, _sizeOut * VECTOR_LENGTH, "out", 0);
+                if (-1 == _handleOut) return false; // failure
+            }
+        } else if (-1 != _handleOut) {
+            if (!clearBuffer<scalar>(oclApp, _handleOut)) return false;
+        }
+
+        // set kernel arguments
+        size_t argIndex = 0;
+        bool rc = true;
+        if (-1 != _handleOut)
+            rc = rc && setArgGlobal(oclApp, kernelHandle, argIndex++, _handleOut, "out");
+        if (-1 != _handleIn)
+            rc = rc && (_imageIn
+                            ? setArgImage(oclApp, kernelHandle, argIndex++, _handleIn, "in")
+                            : setArgGlobal(oclApp, kernelHandle, argIndex++, _handleIn, "in"));
+        switch (_test) {
+            case (GLOBAL_WRITE) :
+                rc = rc && setArgValue<scalar>(oclApp, kernelHandle, argIndex++, 1, "value");
+                break;
+            case (LOCAL_READ) :
+            case (LOCAL_CONFLICT) :
+                rc = rc && setArgLocal<scalar>(oclApp, kernelHandle, argIndex++, localElements() * VECTOR_LENGTH, "tmp");
+                break;
+            case (MAD_THROUGHPUT) :
+                rc = rc &&
+                    setArgValue<scalar>(oclApp, kernelHandle, argIndex++, 1, "b") &&
+                    setArgValue<scalar>(oclApp, kernelHandle, argIndex++, 0, "c");
+                break;
+        }
+        return rc;
+    }
+
+    bool syncOutput(OCLApp& oclApp) {
+        return -1 == _handleOut || syncBufferFromDevice(oclApp, _handleOut);
+    }
+
+    bool checkOutput(OCLApp& oclApp, const bool printOutput) {
+        return -1 == _handleOut ||
+               checkBuffer<scalar>(oclApp, _handleOut, _sizeOut * VECTOR_LENGTH, expectedOutput(), printOutput);
+    }
+
+    void paranoidCheck() { }
+
+    std::vector<size_t> globalWorkItems() const {
+        return std::vector<size_t>(1, _workItems);
+    }
+
+    std::vector<size_t> localWorkItems() const {
+        return std::vector<size_t>(1, _groupSize);
+    }
+
+    // prints the kernel source
+    std::ostream& print(std::ostream& os) const {
+
+        pragma_extension<scalar>(os);
+
+        // true when an image pixel is the vector element without reinterpretation
+        const bool spQuad = isfloat<scalar>() && 4 == VECTOR_LENGTH;
+
+        FunctionDeclaration kernelDecl(kernelName());
+        kernelDecl.returnType<void>();
+        kernelDecl.qualify(KERNEL);
+
+        // kernel arguments
+        const bool hasIn = 0 != inputElements();
+        const bool hasOut = 0 != outputElements();
+        Var< scalarN* >       out("out", GLOBAL, kernelDecl, hasOut);
+        Var< const scalarN* > in("in", GLOBAL, kernelDecl, hasIn && IMAGE_READ != _test);
+        Var< image2d_t >      img("in", READONLY, kernelDecl, IMAGE_READ == _test);
+        Var< const scalar >   value("value", kernelDecl, GLOBAL_WRITE == _test);
+        Var< scalarN* >       tmp("tmp", LOCAL, kernelDecl, LOCAL_READ == _test || LOCAL_CONFLICT == _test);
+        Var< const scalar >   b("b", kernelDecl, MAD_THROUGHPUT == _test);
+        Var< const scalar >   c("c", kernelDecl, MAD_THROUGHPUT == _test);
+
+        // begin function body
+        os << kernelDecl;
+
+        // empty kernel measures launch latency
+        if (EMPTY_KERNEL == _test) return os << EndBlock();
+
+        const ConstantValue<std::string> globalID = func_string<size_t>("get_global_id", 0);
+        const ConstantValue<std::string> localID = func_string<size_t>("get_local_id", 0);
+
+        // accumulated values are written out so nothing is optimized away
+        Var< scalarN > sum("sum");
+        if (GLOBAL_WRITE != _test && GLOBAL_COPY != _test)
+            os << declare(sum, CastValue<scalarN>(ConstantValue<scalar>(0)));
+
+        Var< int > idx("idx");
+
+        switch (_test) {
+            case (GLOBAL_READ) :
+                os << ForLoop(idx, _loopCount, UNROLL);
+                    for (size_t j = 0; j < UNROLL; j++)
+                        os << assign(sum, sum + *(in + globalID + (idx + j) * _workItems));
+                os << EndBlock();
+                os << assign(*(out + globalID), sum);
+                break;
+
+            case (GLOBAL_WRITE) :
+                os << ForLoop(idx, _loopCount, UNROLL);
+                    for (size_t j = 0; j < UNROLL; j++)
+                        os << assign(*(out + globalID + (idx + j) * _workItems), CastValue<scalarN>(value));
+                os << EndBlock();
+                break;
+
+            case (GLOBAL_COPY) :
+                os << ForLoop(idx, _loopCount, UNROLL);
+                    for (size_t j = 0; j < UNROLL; j++)
+                        os << assign(*(out + globalID + (idx + j) * _workItems),
+                                     *(in + globalID + (idx + j) * _workItems));
+                os << EndBlock();
+                break;
+
+            case (LOCAL_READ) :
+            case (LOCAL_CONFLICT) :
+                {
+                // the work group fills the local array
+                for (size_t j = 0; j < localElements() / _groupSize; j++)
+                    os << assign(*(tmp + localID + j * _groupSize), *(in + localID + j * _groupSize));
+                os << LocalBarrier();
+
+                const size_t stride = LOCAL_CONFLICT == _test ? conflictStride() : 1;
+                os << ForLoop(idx, _loopCount, UNROLL);
+                    for (size_t j = 0; j < UNROLL; j++)
+                        os << assign(sum, sum + *(tmp + (localID * stride + idx + j) % localElements()));
+                os << EndBlock();
+                os << assign(*(out + globalID), sum);
+                }
+                break;
+
+            case (IMAGE_READ) :
+                {
+                Var< const sampler_t > sampler("sampler");
+                os << declare(sampler, ImageSampler());
+
+                // consecutive work items read consecutive pixels of a row
+                const ConstantValue<std::string> x = globalID % IMAGE_WIDTH;
+                const ConstantValue<std::string> y = globalID / IMAGE_WIDTH;
+                os << ForLoop(idx, _loopCount, UNROLL);
+                    for (size_t j = 0; j < UNROLL; j++)
+                        os << assign(sum, sum + ReinterpretValue<SCALAR, VECTOR_LENGTH>(
+                                                    ReadImage<scalar>(img, sampler,
+                                                                      x,
+                                                                      y + (idx + j) * (_workItems / IMAGE_WIDTH)),
+                                                    !spQuad));
+                os << EndBlock();
+                os << assign(*(out + globalID), sum);
+                }
+                break;
+
+            case (MAD_THROUGHPUT) :
+                {
+                Vector< scalarN > accum("accum", MAD_CHAINS);
+                os << declare(accum, *(in + globalID));
+                os << ForLoop(idx, _loopCount, UNROLL);
+                    for (size_t j = 0; j < UNROLL; j++)
+                        for (size_t k = 0; k < MAD_CHAINS; k++)
+                            os << assign(accum[k], MADValue(accum[k], CastValue<scalarN>(b), CastValue<scalarN>(c)));
+                os << EndBlock();
+                for (size_t k = 0; k < MAD_CHAINS; k++)
+                    os << assign(sum, sum + accum[k]);
+                os << assign(*(out + globalID), sum);
+                }
+                break;
+        }
+
+        return os << EndBlock(); // end function body
+    }
+};
+
+}; // namespace
+
+#endif
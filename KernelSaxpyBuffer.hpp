@@ -25,7 +25,10 @@
 // saxpy using memory buffers
 template <typename SCALAR, size_t VECTOR_LENGTH>
 class KernelSaxpyBuffer : public KernelBaseSaxpy,
-                          protected SaxpyParamInlineMN
+                          protected SaxpyParamInlineMN,
+                          protected SaxpyParamOptimizeExpr,
+                          protected SaxpyParamGroupSizeAttr,
+                          protected SaxpyParamBuildOptions
 {
     typedef SCALAR scalar;
     typedef VecType< SCALAR, VECTOR_LENGTH > scalarN;
@@ -42,10 +45,18 @@ class KernelSaxpyBuffer : public KernelBaseSaxpy,
         return packedCalc() * dimM() * dimN();
     }
 
+    bool validExtraParam() const {
+        return SaxpyParamOptimizeExpr::validParam(getSearchOptimizeExpr()) &&
+               SaxpyParamGroupSizeAttr::validParam(getSearchGroupSizeAttr());
+    }
+
 public:
     KernelSaxpyBuffer()
         : KernelBaseSaxpy(),
           SaxpyParamInlineMN(getExtraParameter()),
+          SaxpyParamOptimizeExpr(getExtraParameter()),
+          SaxpyParamGroupSizeAttr(getExtraParameter()),
+          SaxpyParamBuildOptions(getExtraParameter()),
           _handleX(-1),
           _handleY(-1),
           _handleZ(-1),
@@ -63,6 +74,10 @@ public:
         return ss.str();
     }
 
+    std::string buildOptions() const { return buildOptionSet(); }
+
+    size_t elementSize() const { return sizeof(SCALAR); }
+
     void paranoidCheck() {
         _paranoidCheck = true;
         delete[] _paranoidZ;
@@ -73,6 +88,26 @@ public:
         return syncBufferFromDevice(oclApp, _handleZ);
     }
 
+    std::vector<size_t> inputBuffers() const {
+        std::vector<size_t> handles;
+        handles.push_back(_handleX);
+        handles.push_back(_handleY);
+        return handles;
+    }
+
+    std::vector<size_t> outputBuffers() const {
+        return std::vector<size_t>(1, _handleZ);
+    }
+
+    bool setBufferArgs(OCLApp& oclApp,
+                       const size_t kernelHandle,
+                       const std::vector<size_t>& inputs,
+                       const std::vector<size_t>& outputs) {
+        return setArgGlobal(oclApp, kernelHandle, 0, outputs[0], "Z") &&
+               setArgGlobal(oclApp, kernelHandle, 1, inputs[0], "X") &&
+               setArgGlobal(oclApp, kernelHandle, 2, inputs[1], "Y");
+    }
+
     bool checkOutput(OCLApp& oclApp, const bool printOutput) {
         if (_paranoidCheck) {
             return checkBuffer<scalar>(oclApp, _handleZ, bufferSize(), _paranoidZ, printOutput);
@@ -86,7 +121,10 @@ public:
 
         // buffer allocation
         if (-1 == _handleX || -1 == _handleY || -1 == _handleZ || dimChanged() || packedChanged()) {
-            oclApp.releaseBuffers();
+            // return old buffers to the pool, new ones may reuse them
+            if (-1 != _handleX) oclApp.releaseBuffer(_handleX);
+            if (-1 != _handleY) oclApp.releaseBuffer(_handleY);
+            if (-1 != _handleZ) oclApp.releaseBuffer(_handleZ);
             _handleX = createBufferR<scalar, VECTOR_LENGTH>(oclApp, bufferSize(), "X", 1);
             _handleY = createBufferR<scalar, VECTOR_LENGTH>(oclApp, bufferSize(), "Y", 1);
             _handleZ = createBufferW<scalar, VECTOR_LENGTH>(oclApp, bufferSize(), "Z", 0);
@@ -142,14 +180,21 @@ public:
     // prints the kernel source
     std::ostream& print(std::ostream& os) const {
 
+        // constant folding of index arithmetic
+        ExprFoldingScope folding(optimizeExpr());
+
         pragma_extension<scalar>(os);
 
         // kernel function attributes
         AutoVectorize< scalarN > attrAutoVec;
+        RequiredWorkGroupSize attrReqdSize(localWorkItems());
+        WorkGroupSizeHint attrSizeHint(localWorkItems());
         FunctionDeclaration kernelDecl(kernelName());
         kernelDecl.returnType<void>();
         kernelDecl.qualify(KERNEL);
         if (getUseAttrAutoVec()) kernelDecl.qualify(attrAutoVec);
+        if (reqdWorkGroupSize()) kernelDecl.qualify(attrReqdSize);
+        if (workGroupSizeHint()) kernelDecl.qualify(attrSizeHint);
 
         // kernel arguments
         Var< scalarN* >       Z("Z", GLOBAL, kernelDecl);
@@ -167,21 +212,16 @@ public:
         if (1 != packedCalc()) os << ForLoop(pIdx, packedCalc(), 1);
 
             if (vectorLength() == dimN()) {
-                // 1D work groups
-                const ConstantValue<std::string> outZ = Z
-                                                      + blockHeight() * groupHeight() * blockRow
-                                                      + row
-                                                      + pIdx * M;
-
-                const ConstantValue<std::string> inX = X
-                                                     + blockHeight() * groupHeight() * blockRow
-                                                     + row
-                                                     + pIdx * M;
-
-                const ConstantValue<std::string> inY = Y
-                                                     + blockHeight() * groupHeight() * blockRow
-                                                     + row
-                                                     + pIdx * M;
+                // 1D work groups, offset is common to all three vectors
+                Var< const int > offset("offset");
+                const ConstantValue<std::string> index
+                    = hoist(os, offset,
+                            blockHeight() * groupHeight() * blockRow + row + pIdx * M,
+                            optimizeExpr());
+
+                const ConstantValue<std::string> outZ = Z + index;
+                const ConstantValue<std::string> inX = X + index;
+                const ConstantValue<std::string> inY = Y + index;
 
                 for (size_t i = 0; i < blockHeight(); i++)
                     os << assign(*(outZ + i * groupHeight()),
@@ -189,27 +229,20 @@ public:
                                           *(inX + i * groupHeight()),
                                           *(inY + i * groupHeight())));
             } else {
-                // 2D work groups
-                const ConstantValue<std::string> outZ = Z
-                                                      + multHeight(N) * groupHeight() * blockRow
-                                                      + wholeWidth() * groupWidth() * blockCol
-                                                      + row * N / VECTOR_LENGTH
-                                                      + col
-                                                      + pIdx * M * N / VECTOR_LENGTH;
-
-                const ConstantValue<std::string> inX = X
-                                                     + multHeight(N) * groupHeight() * blockRow
-                                                     + wholeWidth() * groupWidth() * blockCol
-                                                     + row * N / VECTOR_LENGTH
-                                                     + col
-                                                     + pIdx * M * N / VECTOR_LENGTH;
-
-                const ConstantValue<std::string> inY = Y
-                                                     + multHeight(N) * groupHeight() * blockRow
-                                                     + wholeWidth() * groupWidth() * blockCol
-                                                     + row * N / VECTOR_LENGTH
-                                                     + col
-                                                     + pIdx * M * N / VECTOR_LENGTH;
+                // 2D work groups, offset is common to all three vectors
+                Var< const int > offset("offset");
+                const ConstantValue<std::string> index
+                    = hoist(os, offset,
+                            multHeight(N) * groupHeight() * blockRow
+                                + wholeWidth() * groupWidth() * blockCol
+                                + row * N / VECTOR_LENGTH
+                                + col
+                                + pIdx * M * N / VECTOR_LENGTH,
+                            optimizeExpr());
+
+                const ConstantValue<std::string> outZ = Z + index;
+                const ConstantValue<std::string> inX = X + index;
+                const ConstantValue<std::string> inY = Y + index;
 
                 for (size_t i = 0; i < blockHeight(); i++)
                     for (size_t j = 0; j < wholeWidth(); j++)
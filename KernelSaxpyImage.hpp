@@ -26,7 +26,10 @@
 template <typename SCALAR, size_t VECTOR_LENGTH>
 class KernelSaxpyImage : public KernelBaseSaxpy,
                          protected SaxpyParamInlineMN,
-                         protected SaxpyParamGlobalID
+                         protected SaxpyParamGlobalID,
+                         protected SaxpyParamOptimizeExpr,
+                         protected SaxpyParamGroupSizeAttr,
+                         protected SaxpyParamBuildOptions
 {
     typedef SCALAR scalar;
     typedef VecType< SCALAR, VECTOR_LENGTH > scalarN;
@@ -45,11 +48,19 @@ class KernelSaxpyImage : public KernelBaseSaxpy,
         return packedCalc() * dimM() * dimN();
     }
 
+    bool validExtraParam() const {
+        return SaxpyParamOptimizeExpr::validParam(getSearchOptimizeExpr()) &&
+               SaxpyParamGroupSizeAttr::validParam(getSearchGroupSizeAttr());
+    }
+
 public:
     KernelSaxpyImage()
         : KernelBaseSaxpy(),
           SaxpyParamInlineMN(getExtraParameter()),
           SaxpyParamGlobalID(getExtraParameter()),
+          SaxpyParamOptimizeExpr(getExtraParameter()),
+          SaxpyParamGroupSizeAttr(getExtraParameter()),
+          SaxpyParamBuildOptions(getExtraParameter()),
           _spQuad(isfloat<SCALAR>() && 4 == VECTOR_LENGTH),
           _handleX(-1),
           _handleY(-1),
@@ -68,6 +79,10 @@ public:
         return ss.str();
     }
 
+    std::string buildOptions() const { return buildOptionSet(); }
+
+    size_t elementSize() const { return sizeof(SCALAR); }
+
     void paranoidCheck() {
         _paranoidCheck = true;
         delete[] _paranoidZ;
@@ -147,14 +162,21 @@ public:
     // prints the kernel source
     std::ostream& print(std::ostream& os) const {
 
+        // constant folding of index arithmetic
+        ExprFoldingScope folding(optimizeExpr());
+
         pragma_extension<scalar>(os);
 
         // kernel function attributes
         AutoVectorize< scalarN > attrAutoVec;
+        RequiredWorkGroupSize attrReqdSize(localWorkItems());
+        WorkGroupSizeHint attrSizeHint(localWorkItems());
         FunctionDeclaration kernelDecl(kernelName());
         kernelDecl.returnType<void>();
         kernelDecl.qualify(KERNEL);
         if (getUseAttrAutoVec()) kernelDecl.qualify(attrAutoVec);
+        if (reqdWorkGroupSize()) kernelDecl.qualify(attrReqdSize);
+        if (workGroupSizeHint()) kernelDecl.qualify(attrSizeHint);
 
         // kernel arguments
         Var< image2d_t > Z("Z", WRITEONLY, kernelDecl);
@@ -181,21 +203,30 @@ public:
                                                                       ? globalRow
                                                                       : groupHeight() * blockRow + row;
 
-                for (size_t i = 0; i < blockHeight(); i++)
+                // row coordinate is common to all three images
+                Var< const int > coordRow("coordRow");
+                const ConstantValue<std::string> baseRow
+                    = hoist(os, coordRow, blockHeight() * valueGlobalRow + pIdx * M, optimizeExpr());
+
+                for (size_t i = 0; i < blockHeight(); i++) {
+                    const ConstantValue<std::string> y = optimizeExpr()
+                                                             ? baseRow + i
+                                                             : blockHeight() * valueGlobalRow + i + pIdx * M;
                     os << WriteImage<scalar>(Z,
                                              ConstantValue<const int>(0),
-                                             blockHeight() * valueGlobalRow + i + pIdx * M,
+                                             y,
                                              ReinterpretValue<uint, 4>(
                                                  MADValue(CastValue<scalarN>(alpha),
                                                           ReinterpretValue<SCALAR, VECTOR_LENGTH>(
                                                               ReadImage<scalar>(X, sampler,
-                                                                                ConstantValue<const int>(0), blockHeight() * valueGlobalRow + i + pIdx * M),
+                                                                                ConstantValue<const int>(0), y),
                                                               !_spQuad),
                                                           ReinterpretValue<SCALAR, VECTOR_LENGTH>(
                                                               ReadImage<scalar>(Y, sampler,
-                                                                                ConstantValue<const int>(0), blockHeight() * valueGlobalRow + i + pIdx * M),
+                                                                                ConstantValue<const int>(0), y),
                                                               !_spQuad)),
                                                  !_spQuad));
+                }
 
             } else {
                 // 2D work groups
@@ -207,24 +238,36 @@ public:
                                                                       ? globalRow
                                                                       : groupHeight() * blockRow + row;
 
+                // coordinates are common to all three images
+                Var< const int > coordCol("coordCol");
+                Var< const int > coordRow("coordRow");
+                const ConstantValue<std::string> baseCol
+                    = hoist(os, coordCol, blockWidth() * valueGlobalCol, optimizeExpr());
+                const ConstantValue<std::string> baseRow
+                    = hoist(os, coordRow, blockHeight() * valueGlobalRow + pIdx * M, optimizeExpr());
+
                 for (size_t j = 0; j < blockWidth(); j++)
-                for (size_t i = 0; i < blockHeight(); i++)
+                for (size_t i = 0; i < blockHeight(); i++) {
+                    const ConstantValue<std::string> y = optimizeExpr()
+                                                             ? baseRow + i
+                                                             : blockHeight() * valueGlobalRow + i + pIdx * M;
                     os << WriteImage<scalar>(Z,
-                                             blockWidth() * valueGlobalCol + j,
-                                             blockHeight() * valueGlobalRow + i + pIdx * M,
+                                             baseCol + j,
+                                             y,
                                              ReinterpretValue<uint, 4>(
                                                  MADValue(CastValue<scalarN>(alpha),
                                                           ReinterpretValue<SCALAR, VECTOR_LENGTH>(
                                                               ReadImage<scalar>(X, sampler,
-                                                                                blockWidth() * valueGlobalCol + j,
-                                                                                blockHeight() * valueGlobalRow + i + pIdx * M),
+                                                                                baseCol + j,
+                                                                                y),
                                                               !_spQuad),
                                                           ReinterpretValue<SCALAR, VECTOR_LENGTH>(
                                                               ReadImage<scalar>(Y, sampler,
-                                                                                blockWidth() * valueGlobalCol + j,
-                                                                                blockHeight() * valueGlobalRow + i + pIdx * M),
+                                                                                baseCol + j,
+                                                                                y),
                                                               !_spQuad)),
                                                  !_spQuad));
+                }
             }
 
         if (1 != packedCalc()) os << EndBlock();
@@ -24,6 +24,232 @@ using namespace std;
 
 #include "declare_namespace"
 
+int
+OCLApp::insertEvent(const cl_event event, const char *name)
+{
+    const int event_index = events.insert(event);
+
+    if (OCLTrace::enabled() && -1 != event_index) {
+        traced_events.push_back(event_index);
+        traced_names.push_back(name);
+        traced_queues.push_back(queue_index);
+        traced_enqueued.push_back(OCLTrace::now());
+    }
+
+    return event_index;
+}
+
+void
+OCLApp::traceCommands()
+{
+    if (traced_events.empty()) return;
+
+    // events may have been released when the ring wrapped
+    vec_size_t valid_events;
+    for (size_t i = 0; i < traced_events.size(); i++)
+        if (events.valid(traced_events[i]))
+            valid_events.push_back(traced_events[i]);
+    events.wait(valid_events);
+
+    for (size_t i = 0; i < traced_events.size(); i++)
+        if (events.valid(traced_events[i]))
+            OCLTrace::device(traced_names[i],
+                             device_index,
+                             traced_queues[i],
+                             traced_enqueued[i],
+                             events.profile(traced_events[i]));
+
+    traced_events.clear();
+    traced_names.clear();
+    traced_queues.clear();
+    traced_enqueued.clear();
+}
+
+int
+OCLApp::storeBuffer(const cl_mem buffer,
+                    void *ptr,
+                    const bool own_memptr,
+                    const size_t sizeoftype,
+                    const size_t n,
+                    const cl_mem_flags flags,
+                    const bool pooled)
+{
+    // reuse the first slot left by a released buffer
+    size_t buffer_index = 0;
+    while (buffer_index < membuffers.size() && NULL != membuffers[buffer_index])
+        buffer_index++;
+
+    if (membuffers.size() == buffer_index)
+    {
+        membuffers.push_back(buffer);
+        memptrs.push_back(ptr);
+        memownptrs.push_back(own_memptr);
+        memsizeoftype.push_back(sizeoftype);
+        memsize.push_back(n);
+        memflags.push_back(flags);
+        memmapped.push_back(NULL);
+        mempooled.push_back(pooled);
+    }
+    else
+    {
+        membuffers[buffer_index] = buffer;
+        memptrs[buffer_index] = ptr;
+        memownptrs[buffer_index] = own_memptr;
+        memsizeoftype[buffer_index] = sizeoftype;
+        memsize[buffer_index] = n;
+        memflags[buffer_index] = flags;
+        memmapped[buffer_index] = NULL;
+        mempooled[buffer_index] = pooled;
+    }
+
+    return buffer_index;
+}
+
+int
+OCLApp::acquirePooledBuffer(const size_t sizeoftype,
+                            const size_t n,
+                            const cl_mem_flags flags)
+{
+    const size_t nbytes = sizeclass(n * sizeoftype);
+
+    // most recently released buffer of the same size class and flags
+    for (size_t i = poolbuffers.size(); i > 0; i--)
+    {
+        if (nbytes == poolbytes[i - 1] && flags == poolflags[i - 1])
+        {
+            const cl_mem buffer = poolbuffers[i - 1];
+            void *ptr = poolptrs[i - 1];
+
+            poolbuffers.erase(poolbuffers.begin() + (i - 1));
+            poolptrs.erase(poolptrs.begin() + (i - 1));
+            poolflags.erase(poolflags.begin() + (i - 1));
+            poolbytes.erase(poolbytes.begin() + (i - 1));
+            pool_total -= nbytes;
+
+            return storeBuffer(buffer, ptr, false, sizeoftype, n, flags, true);
+        }
+    }
+
+    // nothing suitable in the pool, allocate new host and device memory
+    void *ptr = alloc_memalign<char>(nbytes, POOL_ALIGNMENT);
+    if (!ptr) return -1; // failure, could not allocate aligned memory
+
+    // zero-copy buffers are backed by the host shadow array
+    void *host_ptr = (CL_MEM_USE_HOST_PTR & flags) ? ptr : NULL;
+
+    cl_int status;
+    cl_mem buffer = clCreateBuffer(oclBase.getContext(device_index),
+                                   flags,
+                                   nbytes,
+                                   host_ptr,
+                                   &status);
+
+    // device memory may be tied up in the pool, empty it and try again
+    if (CL_SUCCESS != status && !poolbuffers.empty())
+    {
+        releaseBufferPool();
+        buffer = clCreateBuffer(oclBase.getContext(device_index),
+                                flags,
+                                nbytes,
+                                host_ptr,
+                                &status);
+    }
+
+    // check for failure
+    if (checkFail(status, "create pooled buffer ", nbytes))
+    {
+        free(ptr);
+        return -1;
+    }
+
+    return storeBuffer(buffer, ptr, false, sizeoftype, n, flags, true);
+}
+
+bool
+OCLApp::recycleBuffer(const size_t buffer_index)
+{
+    // already released
+    if (NULL == membuffers[buffer_index]) return true;
+
+    // pooled buffers keep device and host memory for the next candidate
+    if (mempooled[buffer_index])
+    {
+        const size_t nbytes = sizeclass(memsize[buffer_index] * memsizeoftype[buffer_index]);
+        poolbuffers.push_back(membuffers[buffer_index]);
+        poolptrs.push_back(memptrs[buffer_index]);
+        poolflags.push_back(memflags[buffer_index]);
+        poolbytes.push_back(nbytes);
+        pool_total += nbytes;
+        return true;
+    }
+
+    bool allOk = true;
+
+    if (checkFail(clReleaseMemObject(membuffers[buffer_index]), "release buffer", buffer_index))
+        allOk = false;
+
+    if (memownptrs[buffer_index]) free(memptrs[buffer_index]);
+
+    return allOk;
+}
+
+bool
+OCLApp::trimBufferPool(const size_t max_bytes)
+{
+    bool allOk = true;
+
+    // oldest buffers are released first
+    size_t count = 0;
+    while (count < poolbuffers.size() && pool_total > max_bytes)
+    {
+        if (checkFail(clReleaseMemObject(poolbuffers[count]), "release pooled buffer", count))
+            allOk = false;
+
+        free(poolptrs[count]);
+        pool_total -= poolbytes[count];
+        count++;
+    }
+
+    poolbuffers.erase(poolbuffers.begin(), poolbuffers.begin() + count);
+    poolptrs.erase(poolptrs.begin(), poolptrs.begin() + count);
+    poolflags.erase(poolflags.begin(), poolflags.begin() + count);
+    poolbytes.erase(poolbytes.begin(), poolbytes.begin() + count);
+
+    return allOk;
+}
+
+bool
+OCLApp::releaseBuffer(const size_t buffer_index)
+{
+    if (buffer_index >= membuffers.size()) return false; // invalid handle
+
+    bool allOk = recycleBuffer(buffer_index);
+
+    membuffers[buffer_index] = NULL;
+    memptrs[buffer_index] = NULL;
+    memownptrs[buffer_index] = false;
+    memsize[buffer_index] = 0;
+    mempooled[buffer_index] = false;
+
+    // drop released slots at the end so handles stay small
+    while (!membuffers.empty() && NULL == membuffers.back())
+    {
+        membuffers.pop_back();
+        memptrs.pop_back();
+        memownptrs.pop_back();
+        memsizeoftype.pop_back();
+        memsize.pop_back();
+        memflags.pop_back();
+        memmapped.pop_back();
+        mempooled.pop_back();
+    }
+
+    // pool is limited to the largest single allocation on the device
+    if (!trimBufferPool(maxMemAlloc())) allOk = false;
+
+    return allOk;
+}
+
 bool
 OCLApp::releaseBuffers()
 {
@@ -31,10 +257,8 @@ OCLApp::releaseBuffers()
 
     for (size_t i = 0; i < membuffers.size(); i++)
     {
-        if (checkFail(clReleaseMemObject(membuffers[i]), "release buffer", i))
+        if (!recycleBuffer(i))
             allOk = false;
-
-        if (memownptrs[i]) free(memptrs[i]);
     }
 
     membuffers.clear();
@@ -42,10 +266,22 @@ OCLApp::releaseBuffers()
     memownptrs.clear();
     memsizeoftype.clear();
     memsize.clear();
+    memflags.clear();
+    memmapped.clear();
+    mempooled.clear();
+
+    // pool is limited to the largest single allocation on the device
+    if (!trimBufferPool(maxMemAlloc())) allOk = false;
 
     return allOk;
 }
 
+bool
+OCLApp::releaseBufferPool()
+{
+    return trimBufferPool(0);
+}
+
 bool
 OCLApp::releaseImages()
 {
@@ -151,27 +387,69 @@ OCLApp::memsetImage(const size_t image_index, const float value)
            imgwidth[image_index] * imgheight[image_index] * 4 * sizeof(float));
 }
 
-OCLApp::OCLApp(OCLBase& ocl_base, const size_t index)
+OCLApp::OCLApp(OCLBase& ocl_base, const size_t index, const size_t numq)
     : oclBase(ocl_base),
       device_index(index),
+      number_queues(numq > 0 ? numq : 1),
+      queue_index(COMPUTE_QUEUE),
       program(NULL),
-      events_pending(0)
+      pool_total(0),
+      zero_copy(ocl_base.hostUnifiedMemory(index))
+{
+    // create all queues now so enqueueing never allocates them
+    for (size_t i = 0; i < number_queues; i++)
+        oclBase.getQueue(device_index, i);
+}
+
+cl_command_queue&
+OCLApp::queue()
+{
+    return oclBase.getQueue(device_index, queue_index);
+}
+
+size_t
+OCLApp::numberQueues() const
+{
+    return number_queues;
+}
+
+size_t
+OCLApp::currentQueue() const
+{
+    return queue_index;
+}
+
+bool
+OCLApp::selectQueue(const size_t index)
 {
+    if (index >= number_queues || ! oclBase.getQueue(device_index, index))
+        return false;
+
+    // commands already enqueued should start while others are queued
+    if (index != queue_index &&
+        checkFail(clFlush(queue()), "flush queue ", queue_index))
+        return false;
+
+    queue_index = index;
+    return true;
 }
 
 OCLApp::~OCLApp()
 {
-    wait();            // events
-    releaseProgram();  // programs and kernels
-    releaseBuffers();  // buffers
-    releaseImages();   // images
-    releaseSamplers(); // image samplers
+    wait();              // events
+    releaseProgram();    // programs and kernels
+    releaseBuffers();    // buffers
+    releaseBufferPool(); // pooled buffers
+    releaseImages();     // images
+    releaseSamplers();   // image samplers
 }
 
 bool
 OCLApp::buildProgram(const vector<string>& program_source,
                      const string& options)
 {
+    OCLTraceScope trace("build program");
+
     // release any pre-existing program and kernels
     if (!releaseProgram()) return false; // failure
 
@@ -230,16 +508,8 @@ OCLApp::buildLog() const
 }
 
 int
-OCLApp::createKernel(const string& kernel_name)
+OCLApp::storeKernel(const cl_kernel kernel, const string& kernel_name)
 {
-    // create the kernel object
-    cl_int status;
-    const cl_kernel kernel = clCreateKernel(program, kernel_name.c_str(), &status);
-
-    // check for failure
-    if (checkFail(status, "create kernel ", kernel_name))
-        return -1; // failure
-
     // store the kernel handle
     const int kernel_index = kernels.size();
     kernels.push_back(kernel);
@@ -261,6 +531,65 @@ OCLApp::createKernel(const string& kernel_name)
     return kernel_index;
 }
 
+int
+OCLApp::createKernel(const string& kernel_name)
+{
+    OCLTraceScope trace("create kernel");
+
+    // create the kernel object
+    cl_int status;
+    const cl_kernel kernel = clCreateKernel(program, kernel_name.c_str(), &status);
+
+    // check for failure
+    if (checkFail(status, "create kernel ", kernel_name))
+        return -1; // failure
+
+    return storeKernel(kernel, kernel_name);
+}
+
+int
+OCLApp::createKernelsInProgram(vector<string>& kernel_names)
+{
+    OCLTraceScope trace("create kernels");
+
+    kernel_names.clear();
+
+    // number of kernels in the program
+    cl_uint num_kernels = 0;
+    if (checkFail(clCreateKernelsInProgram(program, 0, NULL, &num_kernels),
+                  "count kernels in program") ||
+        0 == num_kernels)
+        return -1; // failure
+
+    // create all kernel objects at once
+    vector<cl_kernel> new_kernels(num_kernels);
+    if (checkFail(clCreateKernelsInProgram(program, num_kernels, &new_kernels[0], NULL),
+                  "create kernels in program"))
+        return -1; // failure
+
+    // kernel handles are consecutive in the same order as the names
+    const int first_index = kernels.size();
+    for (size_t i = 0; i < new_kernels.size(); i++)
+    {
+        size_t namesize = 0;
+        char namebuf[1024];
+        memset(namebuf, 0, sizeof(namebuf));
+
+        checkFail(
+            clGetKernelInfo(new_kernels[i],
+                            CL_KERNEL_FUNCTION_NAME,
+                            sizeof(namebuf) - 1,
+                            namebuf,
+                            &namesize),
+            "get kernel function name ", i);
+
+        kernel_names.push_back(namebuf);
+        storeKernel(new_kernels[i], kernel_names.back());
+    }
+
+    return first_index;
+}
+
 bool
 OCLApp::setArgImage(const size_t kernel_index,
                     const size_t kernel_arg_index,
@@ -326,7 +655,8 @@ OCLApp::enqueueKernel(const size_t kernel_index,
     return enqueueKernel(kernel_index,
                          global_dim,
                          local_dim,
-                         idxlist(event_index));
+                         &event_index,
+                         1);
 }
 
 int
@@ -336,11 +666,13 @@ OCLApp::enqueueKernel(const size_t kernel_index,
                       const size_t event_index_0,
                       const size_t event_index_1)
 {
+    const size_t event_indexes[] = { event_index_0,
+                                     event_index_1 };
     return enqueueKernel(kernel_index,
                          global_dim,
                          local_dim,
-                         idxlist(event_index_0,
-                                 event_index_1));
+                         event_indexes,
+                         2);
 }
 
 int
@@ -351,12 +683,14 @@ OCLApp::enqueueKernel(const size_t kernel_index,
                       const size_t event_index_1,
                       const size_t event_index_2)
 {
+    const size_t event_indexes[] = { event_index_0,
+                                     event_index_1,
+                                     event_index_2 };
     return enqueueKernel(kernel_index,
                          global_dim,
                          local_dim,
-                         idxlist(event_index_0,
-                                 event_index_1,
-                                 event_index_2));
+                         event_indexes,
+                         3);
 }
 
 int
@@ -365,29 +699,39 @@ OCLApp::enqueueKernel(const size_t kernel_index,
                       const vector<size_t>& local_dim,
                       const vector<size_t>& event_indexes)
 {
-    cl_event event, event_wait_list[event_indexes.size()];
+    return enqueueKernel(kernel_index,
+                         global_dim,
+                         local_dim,
+                         event_indexes.empty() ? NULL : &event_indexes[0],
+                         event_indexes.size());
+}
 
-    for (size_t i = 0; i < event_indexes.size(); i++)
-        event_wait_list[i] = events[event_indexes[i]];
+int
+OCLApp::enqueueKernel(const size_t kernel_index,
+                      const vector<size_t>& global_dim,
+                      const vector<size_t>& local_dim,
+                      const size_t *event_indexes,
+                      const size_t num_events)
+{
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes,
+                                                      num_events,
+                                                      num_wait);
 
     if (checkFail(
-        clEnqueueNDRangeKernel(oclBase.getQueue(device_index),
+        clEnqueueNDRangeKernel(queue(),
                                kernels[kernel_index],
                                global_dim.size(),
                                NULL, // global work offset must be null
                                &global_dim[0],
                                &local_dim[0],
-                               event_indexes.size(),
-                               event_indexes.empty() ? NULL : event_wait_list,
+                               num_wait,
+                               event_wait_list,
                                &event),
         "enqueue kernel ", kernel_index)) return -1; // failure
 
-    const size_t event_index = events.size();
-    events.push_back(event);
-    events_waited.push_back(false);
-    events_pending++;
-
-    return event_index;
+    return insertEvent(event, "kernel");
 }
 
 int
@@ -419,31 +763,25 @@ OCLApp::enqueueReadBuffer(const size_t buffer_index,
                           const size_t n,
                           const vector<size_t>& event_indexes)
 {
-    cl_event event, event_wait_list[event_indexes.size()];
-
-    for (size_t i = 0; i < event_indexes.size(); i++)
-        event_wait_list[i] = events[event_indexes[i]];
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes, num_wait);
 
     if (checkFail(
-        clEnqueueReadBuffer(oclBase.getQueue(device_index),
+        clEnqueueReadBuffer(queue(),
                             membuffers[buffer_index],
                             CL_FALSE, // non-blocking
                             offset,
                             n * memsizeoftype[buffer_index],
                             memptrs[buffer_index],
-                            event_indexes.size(),
-                            event_indexes.empty() ? NULL : event_wait_list,
+                            num_wait,
+                            event_wait_list,
                             &event),
         "enqueue read buffer ", buffer_index,
         " offset ", offset,
         " n ", n)) return -1; // failure
 
-    const size_t event_index = events.size();
-    events.push_back(event);
-    events_waited.push_back(false);
-    events_pending++;
-
-    return event_index;
+    return insertEvent(event, "read buffer");
 }
 
 int
@@ -475,31 +813,69 @@ OCLApp::enqueueWriteBuffer(const size_t buffer_index,
                            const size_t n,
                            const vector<size_t>& event_indexes)
 {
-    cl_event event, event_wait_list[event_indexes.size()];
-
-    for (size_t i = 0; i < event_indexes.size(); i++)
-        event_wait_list[i] = events[event_indexes[i]];
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes, num_wait);
 
     if (checkFail(
-        clEnqueueWriteBuffer(oclBase.getQueue(device_index),
+        clEnqueueWriteBuffer(queue(),
                              membuffers[buffer_index],
                              CL_FALSE, // non-blocking
                              offset,
                              n * memsizeoftype[buffer_index],
                              memptrs[buffer_index],
-                             event_indexes.size(),
-                             event_indexes.empty() ? NULL : event_wait_list,
+                             num_wait,
+                             event_wait_list,
                              &event),
         "enqueue write buffer ", buffer_index,
         " offset ", offset,
         " n ", n)) return -1; // failure
 
-    const size_t event_index = events.size();
-    events.push_back(event);
-    events_waited.push_back(false);
-    events_pending++;
+    return insertEvent(event, "write buffer");
+}
 
-    return event_index;
+int
+OCLApp::enqueueReadBuffer(const size_t buffer_index,
+                          void *host_ptr)
+{
+    cl_event event;
+
+    if (checkFail(
+        clEnqueueReadBuffer(queue(),
+                            membuffers[buffer_index],
+                            CL_FALSE, // non-blocking
+                            0,
+                            memsize[buffer_index] * memsizeoftype[buffer_index],
+                            host_ptr,
+                            0,
+                            NULL,
+                            &event),
+        "enqueue read buffer ", buffer_index,
+        " to host pointer ", host_ptr)) return -1; // failure
+
+    return insertEvent(event, "read buffer");
+}
+
+int
+OCLApp::enqueueWriteBuffer(const size_t buffer_index,
+                           const void *host_ptr)
+{
+    cl_event event;
+
+    if (checkFail(
+        clEnqueueWriteBuffer(queue(),
+                             membuffers[buffer_index],
+                             CL_FALSE, // non-blocking
+                             0,
+                             memsize[buffer_index] * memsizeoftype[buffer_index],
+                             host_ptr,
+                             0,
+                             NULL,
+                             &event),
+        "enqueue write buffer ", buffer_index,
+        " from host pointer ", host_ptr)) return -1; // failure
+
+    return insertEvent(event, "write buffer");
 }
 
 int
@@ -550,31 +926,139 @@ OCLApp::enqueueCopyBuffer(const size_t src_buffer_index,
                           const size_t n,
                           const vector<size_t>& event_indexes)
 {
-    cl_event event, event_wait_list[event_indexes.size()];
-
-    for (size_t i = 0; i < event_indexes.size(); i++)
-        event_wait_list[i] = events[event_indexes[i]];
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes, num_wait);
 
     if (checkFail(
-        clEnqueueCopyBuffer(oclBase.getQueue(device_index),
+        clEnqueueCopyBuffer(queue(),
                             membuffers[src_buffer_index],
                             membuffers[dest_buffer_index],
                             src_offset,
                             dest_offset,
                             // type size is always from source buffer
                             n * memsizeoftype[src_buffer_index],
-                            event_indexes.size(),
-                            event_indexes.empty() ? NULL : event_wait_list,
+                            num_wait,
+                            event_wait_list,
                             &event),
         "enqueue copy buffer from ", src_buffer_index,
         " to ", dest_buffer_index)) return -1; // failure
 
-    const size_t event_index = events.size();
-    events.push_back(event);
-    events_waited.push_back(false);
-    events_pending++;
+    return insertEvent(event, "copy buffer");
+}
 
-    return event_index;
+int
+OCLApp::enqueueMapBuffer(const size_t buffer_index,
+                         BUFFER_FLAGS mode)
+{
+    return enqueueMapBuffer(buffer_index, mode, vector<size_t>());
+}
+
+int
+OCLApp::enqueueMapBuffer(const size_t buffer_index,
+                         BUFFER_FLAGS mode,
+                         const vector<size_t>& event_indexes)
+{
+    cl_map_flags flags;
+
+    switch (mode)
+    {
+        case (READ) : flags = CL_MAP_READ; break;
+#ifdef CL_MAP_WRITE_INVALIDATE_REGION
+        case (WRITE) : flags = CL_MAP_WRITE_INVALIDATE_REGION; break;
+#else
+        case (WRITE) : flags = CL_MAP_WRITE; break;
+#endif
+        case (READWRITE) : flags = CL_MAP_READ | CL_MAP_WRITE; break;
+        default :
+            cerr << "error: map buffer " << buffer_index << " with invalid mode " << mode << endl;
+            return -1; // failure
+    }
+
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes, num_wait);
+
+    cl_int status;
+    void *ptr = clEnqueueMapBuffer(queue(),
+                                   membuffers[buffer_index],
+                                   CL_FALSE, // non-blocking
+                                   flags,
+                                   0,
+                                   memsize[buffer_index] * memsizeoftype[buffer_index],
+                                   num_wait,
+                                   event_wait_list,
+                                   &event,
+                                   &status);
+
+    if (checkFail(status, "enqueue map buffer ", buffer_index))
+        return -1; // failure
+
+    // pointer is not safe to use until the event completes
+    memmapped[buffer_index] = ptr;
+
+    return insertEvent(event, "map buffer");
+}
+
+int
+OCLApp::enqueueUnmapBuffer(const size_t buffer_index)
+{
+    return enqueueUnmapBuffer(buffer_index, vector<size_t>());
+}
+
+int
+OCLApp::enqueueUnmapBuffer(const size_t buffer_index,
+                           const vector<size_t>& event_indexes)
+{
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes, num_wait);
+
+    if (checkFail(
+        clEnqueueUnmapMemObject(queue(),
+                                membuffers[buffer_index],
+                                memmapped[buffer_index],
+                                num_wait,
+                                event_wait_list,
+                                &event),
+        "enqueue unmap buffer ", buffer_index)) return -1; // failure
+
+    memmapped[buffer_index] = NULL;
+
+    return insertEvent(event, "unmap buffer");
+}
+
+void*
+OCLApp::mappedPtr(const size_t buffer_index) const
+{
+    return memmapped[buffer_index];
+}
+
+size_t
+OCLApp::bufferBytes(const size_t buffer_index) const
+{
+    return memsize[buffer_index] * memsizeoftype[buffer_index];
+}
+
+bool
+OCLApp::zeroCopy() const
+{
+    return zero_copy;
+}
+
+void
+OCLApp::zeroCopy(const bool enable)
+{
+    // only affects buffers created afterwards
+    zero_copy = enable;
+}
+
+bool
+OCLApp::zeroCopyBuffer(const size_t buffer_index) const
+{
+    // buffers using host memory are only free to map when the device
+    // shares memory with the host, otherwise mapping also copies
+    return zero_copy && (CL_MEM_USE_HOST_PTR & memflags[buffer_index]);
 }
 
 int
@@ -617,10 +1101,9 @@ OCLApp::enqueueReadImage(const size_t buffer_index,
                          const size_t region_height,
                          const std::vector<size_t>& event_indexes)
 {
-    cl_event event, event_wait_list[event_indexes.size()];
-
-    for (size_t i = 0; i < event_indexes.size(); i++)
-        event_wait_list[i] = events[event_indexes[i]];
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes, num_wait);
 
     size_t origin[3], region[3];
     origin[0] = origin_x;
@@ -631,7 +1114,7 @@ OCLApp::enqueueReadImage(const size_t buffer_index,
     region[2] = 1;
 
     if (checkFail(
-        clEnqueueReadImage(oclBase.getQueue(device_index),
+        clEnqueueReadImage(queue(),
                            imgbuffers[buffer_index],
                            CL_FALSE, // non-blocking
                            origin,
@@ -639,19 +1122,14 @@ OCLApp::enqueueReadImage(const size_t buffer_index,
                            0,
                            0,
                            imgptrs[buffer_index],
-                           event_indexes.size(),
-                           event_indexes.empty() ? NULL : event_wait_list,
+                           num_wait,
+                           event_wait_list,
                            &event),
         "enqueue read image ", buffer_index,
         " origin_x ", origin_x,
         " origin_y ", origin_y)) return -1; // failure
 
-    const size_t event_index = events.size();
-    events.push_back(event);
-    events_waited.push_back(false);
-    events_pending++;
-
-    return event_index;
+    return insertEvent(event, "read image");
 }
 
 int
@@ -694,10 +1172,9 @@ OCLApp::enqueueWriteImage(const size_t image_index,
                           const size_t region_height,
                           const vector<size_t>& event_indexes)
 {
-    cl_event event, event_wait_list[event_indexes.size()];
-
-    for (size_t i = 0; i < event_indexes.size(); i++)
-        event_wait_list[i] = events[event_indexes[i]];
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes, num_wait);
 
     size_t origin[3], region[3];
     origin[0] = origin_x;
@@ -708,7 +1185,7 @@ OCLApp::enqueueWriteImage(const size_t image_index,
     region[2] = 1;
 
     if (checkFail(
-        clEnqueueWriteImage(oclBase.getQueue(device_index),
+        clEnqueueWriteImage(queue(),
                             imgbuffers[image_index],
                             CL_FALSE, // non-blocking
                             origin,
@@ -716,19 +1193,14 @@ OCLApp::enqueueWriteImage(const size_t image_index,
                             0,
                             0,
                             imgptrs[image_index],
-                            event_indexes.size(),
-                            event_indexes.empty() ? NULL : event_wait_list,
+                            num_wait,
+                            event_wait_list,
                             &event),
         "enqueue write image ", image_index,
         " origin_x ", origin_x,
         " origin_y ", origin_y)) return -1; // failure
 
-    const size_t event_index = events.size();
-    events.push_back(event);
-    events_waited.push_back(false);
-    events_pending++;
-
-    return event_index;
+    return insertEvent(event, "write image");
 }
 
 int
@@ -787,10 +1259,9 @@ OCLApp::enqueueCopyImage(const size_t src_image_index,
                          const size_t region_height,
                          const std::vector<size_t>& event_indexes)
 {
-    cl_event event, event_wait_list[event_indexes.size()];
-
-    for (size_t i = 0; i < event_indexes.size(); i++)
-        event_wait_list[i] = events[event_indexes[i]];
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes, num_wait);
 
     size_t src_origin[3], dest_origin[3], region[3];
     src_origin[0] = src_origin_x;
@@ -804,24 +1275,19 @@ OCLApp::enqueueCopyImage(const size_t src_image_index,
     region[2] = 1;
 
     if (checkFail(
-        clEnqueueCopyImage(oclBase.getQueue(device_index),
+        clEnqueueCopyImage(queue(),
                            imgbuffers[src_image_index],
                            imgbuffers[dest_image_index],
                            src_origin,
                            dest_origin,
                            region,
-                           event_indexes.size(),
-                           event_indexes.empty() ? NULL : event_wait_list,
+                           num_wait,
+                           event_wait_list,
                            &event),
         "enqueue copy image from ", src_image_index,
         " to ", dest_image_index)) return -1; // failure
 
-    const size_t event_index = events.size();
-    events.push_back(event);
-    events_waited.push_back(false);
-    events_pending++;
-
-    return event_index;
+    return insertEvent(event, "copy image");
 }
 
 int
@@ -876,10 +1342,9 @@ OCLApp::enqueueCopyBufferToImage(const size_t src_buffer_index,
                                  const size_t region_height,
                                  const std::vector<size_t>& event_indexes)
 {
-    cl_event event, event_wait_list[event_indexes.size()];
-
-    for (size_t i = 0; i < event_indexes.size(); i++)
-        event_wait_list[i] = events[event_indexes[i]];
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes, num_wait);
 
     size_t dest_origin[3], region[3];
     dest_origin[0] = dest_origin_x;
@@ -890,24 +1355,19 @@ OCLApp::enqueueCopyBufferToImage(const size_t src_buffer_index,
     region[2] = 1;
 
     if (checkFail(
-        clEnqueueCopyBufferToImage(oclBase.getQueue(device_index),
+        clEnqueueCopyBufferToImage(queue(),
                                    membuffers[src_buffer_index],
                                    imgbuffers[dest_image_index],
                                    src_offset,
                                    dest_origin,
                                    region,
-                                   event_indexes.size(),
-                                   event_indexes.empty() ? NULL : event_wait_list,
+                                   num_wait,
+                                   event_wait_list,
                                    &event),
         "enqueue copy buffer to image from ", src_buffer_index,
         " to ", dest_image_index)) return -1; // failure
 
-    const size_t event_index = events.size();
-    events.push_back(event);
-    events_waited.push_back(false);
-    events_pending++;
-
-    return event_index;
+    return insertEvent(event, "copy buffer to image");
 }
 
 int
@@ -962,10 +1422,9 @@ OCLApp::enqueueCopyImageToBuffer(const size_t src_image_index,
                                  const size_t region_height,
                                  const std::vector<size_t>& event_indexes)
 {
-    cl_event event, event_wait_list[event_indexes.size()];
-
-    for (size_t i = 0; i < event_indexes.size(); i++)
-        event_wait_list[i] = events[event_indexes[i]];
+    cl_event event;
+    cl_uint num_wait;
+    const cl_event *event_wait_list = events.waitList(event_indexes, num_wait);
 
     size_t src_origin[3], region[3];
     src_origin[0] = src_origin_x;
@@ -976,70 +1435,45 @@ OCLApp::enqueueCopyImageToBuffer(const size_t src_image_index,
     region[2] = 1;
 
     if (checkFail(
-        clEnqueueCopyImageToBuffer(oclBase.getQueue(device_index),
+        clEnqueueCopyImageToBuffer(queue(),
                                    imgbuffers[src_image_index],
                                    membuffers[dest_buffer_index],
                                    src_origin,
                                    region,
                                    dest_offset,
-                                   event_indexes.size(),
-                                   event_indexes.empty() ? NULL : event_wait_list,
+                                   num_wait,
+                                   event_wait_list,
                                    &event),
         "enqueue copy image to buffer from ", src_image_index,
         " to ", dest_buffer_index)) return -1; // failure
 
-    const size_t event_index = events.size();
-    events.push_back(event);
-    events_waited.push_back(false);
-    events_pending++;
-
-    return event_index;
+    return insertEvent(event, "copy image to buffer");
 }
 
 bool
 OCLApp::wait()
 {
-    vec_event event_list;
-
-    // make list of all active events
-    for (size_t i = 0; i < events.size(); i++)
-        if (!events_waited[i])
-            event_list.push_back(events[i]);
-
-    bool isOk = true;
-
-    // wait for everything
-    if (!event_list.empty())
-        isOk = ! checkFail(
-            clWaitForEvents(event_list.size(), &event_list[0]),
-            "wait for ", event_list.size(), " events");
-
-    // release events
-    //for (size_t i = 0; i < event_list.size(); i++)
-    for (size_t i = 0; i < events.size(); i++)
-        clReleaseEvent(events[i]); // events are explicitly released
-                                   // when wait() is called, never
-                                   // as a side-effect of waiting on
-                                   // specific events
+    OCLTraceScope trace("wait");
 
-    events.clear();
-    events_waited.clear();
-    events_pending = 0;
+    // traced commands must be profiled before their events are released
+    traceCommands();
 
-    return isOk;
+    // wait for everything and release all events
+    return events.waitAll();
 }
 
 bool
 OCLApp::wait(const size_t event_index)
 {
-    return wait(idxlist(event_index));
+    return wait(&event_index, 1);
 }
 
 bool
 OCLApp::wait(const size_t event_index_0,
              const size_t event_index_1)
 {
-    return wait(idxlist(event_index_0, event_index_1));
+    const size_t event_indexes[] = { event_index_0, event_index_1 };
+    return wait(event_indexes, 2);
 }
 
 bool
@@ -1047,75 +1481,73 @@ OCLApp::wait(const size_t event_index_0,
              const size_t event_index_1,
              const size_t event_index_2)
 {
-    return wait(idxlist(event_index_0, event_index_1, event_index_2));
+    const size_t event_indexes[] = { event_index_0, event_index_1, event_index_2 };
+    return wait(event_indexes, 3);
 }
 
 bool
 OCLApp::wait(const vector<size_t>& event_indexes)
 {
-    vec_event event_list;
-
-    for (size_t i = 0; i < event_indexes.size(); i++)
-    {
-        // just to be safe, check that event has not been waited on before
-        if (! events_waited[event_indexes[i]])
-            event_list.push_back(events[event_indexes[i]]);
-    }
-
-    const bool isOk = ! checkFail(
-        clWaitForEvents(event_list.size(), &event_list[0]),
-        "wait for ", event_list.size(), " events");
-
-    for (size_t i = 0; i < event_indexes.size(); i++)
-    {
-        // do not release events here as profiling information will be lost
-        //clReleaseEvent(events[event_indexes[i]]);
-        events_waited[event_indexes[i]] = true;
-        events_pending--;
-    }
+    // events are released here only if already profiled
+    return events.wait(event_indexes);
+}
 
-    //if (0 == events_pending)
-    //{
-    //    events.clear();
-    //    events_waited.clear();
-    //}
+bool
+OCLApp::wait(const size_t *event_indexes, const size_t num_events)
+{
+    return events.wait(event_indexes, num_events);
+}
 
-    return isOk;
+bool
+OCLApp::flush()
+{
+    bool rc = true;
+    for (size_t i = 0; i < number_queues; i++)
+        if (checkFail(clFlush(oclBase.getQueue(device_index, i)),
+                      "flush queue ", i, " for device ", device_index))
+            rc = false;
+    return rc;
 }
 
 bool
-OCLApp::finish() const
+OCLApp::finish()
 {
-    return ! checkFail(clFinish(oclBase.getQueue(device_index)),
-                       "finish queue ", device_index);
+    bool rc = true;
+    for (size_t i = 0; i < number_queues; i++)
+        if (checkFail(clFinish(oclBase.getQueue(device_index, i)),
+                      "finish queue ", i, " for device ", device_index))
+            rc = false;
+    return rc;
 }
 
 vector<unsigned long>
 OCLApp::profileEvent(const size_t event_index)
 {
-    vector<unsigned long> event_times;
+    // events already waited on are released after profiling
+    return events.profile(event_index);
+}
 
-    const cl_profiling_info params[] = { CL_PROFILING_COMMAND_QUEUED,
-                                         CL_PROFILING_COMMAND_SUBMIT,
-                                         CL_PROFILING_COMMAND_START,
-                                         CL_PROFILING_COMMAND_END };
+int
+OCLApp::createUserEvent()
+{
+#ifdef CL_VERSION_1_1
+    cl_int status;
+    const cl_event event = clCreateUserEvent(oclBase.getContext(device_index), &status);
 
-    cl_ulong value;
+    if (checkFail(status, "create user event"))
+        return -1; // failure
 
-    for (size_t i = 0; i < sizeof(params)/sizeof(cl_profiling_info); i++)
-    {
-        event_times.push_back(
-            checkFail(clGetEventProfilingInfo(events[event_index],
-                                              params[i],
-                                              sizeof(value),
-                                              &value,
-                                              NULL),
-                      "get event profiling info")
-            ? 0 // failure
-            : value);
-    }
+    return events.insertUserEvent(event);
+#else
+    cerr << "user events require OpenCL 1.1" << endl;
+    return -1; // failure
+#endif
+}
 
-    return event_times;
+bool
+OCLApp::completeUserEvent(const size_t event_index)
+{
+    return events.completeUserEvent(event_index);
 }
 
 size_t
@@ -1154,12 +1586,49 @@ OCLApp::globalMemory()
     return oclBase.globalMemory(device_index);
 }
 
+size_t
+OCLApp::maxClockFrequency()
+{
+    return oclBase.maxClockFrequency(device_index);
+}
+
+size_t
+OCLApp::preferredVectorWidthFloat()
+{
+    return oclBase.preferredVectorWidthFloat(device_index);
+}
+
+size_t
+OCLApp::preferredVectorWidthDouble()
+{
+    return oclBase.preferredVectorWidthDouble(device_index);
+}
+
+string
+OCLApp::deviceVendor()
+{
+    return oclBase.deviceVendor(device_index);
+}
+
+string
+OCLApp::deviceName()
+{
+    return oclBase.deviceName(device_index);
+}
+
+string
+OCLApp::driverVersion()
+{
+    return oclBase.driverVersion(device_index);
+}
+
 void
 OCLApp::print()
 {
     cout
         << "device " << device_index
         << "\tprogram " << program
+        << "\tqueue " << queue_index << " of " << number_queues
         << endl;
 
     for (size_t i = 0; i < kernels.size(); i++)
@@ -1179,9 +1648,19 @@ OCLApp::print()
             << "\thost ptr " << memptrs[i];
 
         if (memownptrs[i]) cout << "\town";
+        if (mempooled[i]) cout << "\tpooled";
 
         cout << endl;
     }
+
+    for (size_t i = 0; i < poolbuffers.size(); i++)
+    {
+        cout
+            << "\tpool[" << i << "] = " << poolbuffers[i]
+            << "\t" << poolbytes[i] << " bytes"
+            << "\thost ptr " << poolptrs[i]
+            << endl;
+    }
 }
 
 } // namespace
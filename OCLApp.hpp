@@ -24,6 +24,8 @@
 #include <string.h>
 #include "OCLSTL.hpp"
 #include "OCLBase.hpp"
+#include "OCLEventRing.hpp"
+#include "OCLTrace.hpp"
 #include "OCLUtil.hpp"
 
 #include "declare_namespace"
@@ -36,6 +38,11 @@ class OCLApp
     // the device this program is for
     const size_t device_index;
 
+    // commands are enqueued on the selected queue of the device
+    const size_t number_queues;
+    size_t       queue_index;
+    cl_command_queue& queue();
+
     cl_program   program;       // program object may contain multiple kernels
     vec_kernel   kernels;       // kernel objects from the program
     vec_size_t   kernel_wgsize; // maximum work group size for each kernel
@@ -45,6 +52,16 @@ class OCLApp
     vec_bool     memownptrs;    // does OCLApp have ownership of memory?
     vec_size_t   memsizeoftype; // sizeof(type) for the buffers
     vec_size_t   memsize;       // size of the memory buffer
+    vec_bool     mempooled;     // buffer and host memory belong to the pool
+    std::vector<cl_mem_flags> memflags; // flags the buffer was created with
+    vec_voidptr  memmapped;     // mapped pointer while buffer is mapped
+
+    // size-class pool of released buffers, reused between kernel candidates
+    vec_mem      poolbuffers;   // memory buffer objects not in use
+    vec_voidptr  poolptrs;      // host shadow arrays for the pooled buffers
+    std::vector<cl_mem_flags> poolflags; // flags buffers were created with
+    vec_size_t   poolbytes;     // size class of the pooled buffers in bytes
+    size_t       pool_total;    // total bytes held in the pool
 
     vec_mem      imgbuffers;    // image objects
     vec_floatptr imgptrs;       // host pointers to allocated arrays for images
@@ -54,13 +71,39 @@ class OCLApp
 
     vec_sampler  imgsamplers;   // sampler objects
 
-    vec_event    events;        // command queue events to wait for
-    vec_bool     events_waited; // keep track of events already waited on
-    size_t       events_pending;// number of events not waited on yet
+    bool         zero_copy;     // device shares memory with the host
+
+    OCLEventRing events;        // command queue events to wait for
 
+    // commands on the device timeline of the trace, profiled when waited on
+    vec_size_t   traced_events;
+    std::vector<const char*> traced_names;
+    vec_size_t   traced_queues;
+    std::vector<unsigned long> traced_enqueued;
+
+    int insertEvent(const cl_event event, const char *name);
+    void traceCommands();
+
+    int storeKernel(const cl_kernel kernel, const std::string& kernel_name);
     bool releaseKernels();
     bool releaseProgram();
 
+    // host shadow memory alignment for pooled buffers (large enough for double16)
+    static const size_t POOL_ALIGNMENT = 128;
+
+    int storeBuffer(const cl_mem buffer,
+                    void *ptr,
+                    const bool own_memptr,
+                    const size_t sizeoftype,
+                    const size_t n,
+                    const cl_mem_flags flags,
+                    const bool pooled);
+    int acquirePooledBuffer(const size_t sizeoftype,
+                            const size_t n,
+                            const cl_mem_flags flags);
+    bool recycleBuffer(const size_t buffer_index);
+    bool trimBufferPool(const size_t max_bytes);
+
     template <typename T> int createBufferWithPointer(const size_t n,
                                                       const cl_mem_flags,
                                                       T *ptr,
@@ -81,9 +124,17 @@ class OCLApp
 
 public:
 
-    OCLApp(OCLBase&, const size_t);
+    OCLApp(OCLBase&, const size_t, const size_t number_queues = 1);
     ~OCLApp();
 
+    // multiple command queues per device, e.g. one for kernels and others
+    // for copying so transfers may overlap computation on hardware with
+    // separate DMA engines
+    enum QUEUE_ROLES { COMPUTE_QUEUE = 0, COPY_QUEUE = 1 };
+    size_t numberQueues() const;
+    size_t currentQueue() const;
+    bool selectQueue(const size_t queue_index); // flushes the current queue
+
     // build program
     bool buildProgram(const std::vector<std::string>& program_source,
                       const std::string& options = "");
@@ -92,6 +143,10 @@ public:
     // create kernels
     int createKernel(const std::string& kernel_name);
 
+    // create every kernel in the program, returns the first kernel handle
+    // (the others follow in the order of the names) or -1 if failure
+    int createKernelsInProgram(std::vector<std::string>& kernel_names);
+
     // create and release memory buffers
     enum BUFFER_FLAGS { READ, WRITE, READWRITE };
     template <typename T> int createBuffer(const size_t n,
@@ -104,6 +159,9 @@ public:
                                            BUFFER_FLAGS mode,
                                            T *ptr,
                                            bool pinned = false);
+    template <typename T> int createPooledBuffer(const size_t n,
+                                                 BUFFER_FLAGS mode,
+                                                 bool pinned = false);
     template <typename T> int createImage(const size_t width,
                                           const size_t height,
                                           BUFFER_FLAGS mode,
@@ -114,13 +172,17 @@ public:
                                           T *ptr,
                                           bool pinned = false);
     int createSampler();
+    bool releaseBuffer(const size_t buffer_index);
     bool releaseBuffers();
+    bool releaseBufferPool();
     bool releaseImages();
     bool releaseSamplers();
     template <typename T> void memsetBuffer(const size_t buffer_index,
                                             const T value);
     void memsetImage(const size_t image_index, const float value);
     template <typename T> T* bufferPtr(const size_t buffer_index) const;
+    void* mappedPtr(const size_t buffer_index) const;
+    size_t bufferBytes(const size_t buffer_index) const;
     template <typename T> T* imagePtr(const size_t image_index) const;
     void ownBuffer(const size_t buffer_index);
     void ownImage(const size_t image_index);
@@ -145,6 +207,8 @@ public:
                      const T value);
 
     // enqueue kernel, returns handle to event
+    // (all enqueue calls use the selected queue, events returned from any
+    //  queue of this device may be passed as dependencies to any other)
     int enqueueKernel(const size_t kernel_index,
                       const std::vector<size_t>& global_dim,
                       const std::vector<size_t>& local_dim);
@@ -167,6 +231,11 @@ public:
                       const std::vector<size_t>& global_dim,
                       const std::vector<size_t>& local_dim,
                       const std::vector<size_t>& event_indexes);
+    int enqueueKernel(const size_t kernel_index,
+                      const std::vector<size_t>& global_dim,
+                      const std::vector<size_t>& local_dim,
+                      const size_t *event_indexes,
+                      const size_t num_events);
 
     // asynchronous buffer copying, returns handle to event
     int enqueueReadBuffer(const size_t buffer_index);
@@ -189,6 +258,14 @@ public:
                            const size_t offset,
                            const size_t n,
                            const std::vector<size_t>& event_indexes);
+
+    // transfer between a buffer and other host memory, e.g. the mapped
+    // pointer of a pinned staging buffer, returns handle to event
+    int enqueueReadBuffer(const size_t buffer_index,
+                          void *host_ptr);
+    int enqueueWriteBuffer(const size_t buffer_index,
+                           const void *host_ptr);
+
     int enqueueCopyBuffer(const size_t src_buffer_index,
                           const size_t dest_buffer_index);
     int enqueueCopyBuffer(const size_t src_buffer_index,
@@ -206,6 +283,22 @@ public:
                           const size_t n,
                           const std::vector<size_t>& event_indexes);
 
+    // zero-copy buffer access, returns handle to event (the whole buffer is
+    // mapped, mapping to write discards its contents where supported)
+    int enqueueMapBuffer(const size_t buffer_index,
+                         BUFFER_FLAGS mode);
+    int enqueueMapBuffer(const size_t buffer_index,
+                         BUFFER_FLAGS mode,
+                         const std::vector<size_t>& event_indexes);
+    int enqueueUnmapBuffer(const size_t buffer_index);
+    int enqueueUnmapBuffer(const size_t buffer_index,
+                           const std::vector<size_t>& event_indexes);
+
+    // device works directly on the host arrays of pooled buffers
+    bool zeroCopy() const;
+    void zeroCopy(const bool enable);
+    bool zeroCopyBuffer(const size_t buffer_index) const;
+
     // asynchronous image copying, returns handle to event
     int enqueueReadImage(const size_t image_index);
     int enqueueReadImage(const size_t image_index,
@@ -309,13 +402,20 @@ public:
               const size_t event_index_1,
               const size_t event_index_2);
     bool wait(const std::vector<size_t>& event_indexes);
-    bool finish() const; // ATI OpenCL SDK v2.0 does not support
-                         // out of order execution so queues are
-                         // inherently serialized anyway
+    bool wait(const size_t *event_indexes, const size_t num_events);
+    bool flush(); // submit commands on all queues without waiting
+    bool finish(); // ATI OpenCL SDK v2.0 does not support
+                   // out of order execution so queues are
+                   // inherently serialized anyway
 
     // return time of: enqueue, submit, start, end
+    // (releases the event if it has been waited on)
     std::vector<unsigned long> profileEvent(const size_t event_index);
 
+    // user events, enqueued commands may depend on them
+    int createUserEvent();
+    bool completeUserEvent(const size_t event_index);
+
     // device properties
     size_t maxWorkGroupSize();
     size_t maxComputeUnits();
@@ -323,6 +423,12 @@ public:
     size_t maxConstBuffer();
     size_t localMemory();
     size_t globalMemory();
+    size_t maxClockFrequency();
+    size_t preferredVectorWidthFloat();
+    size_t preferredVectorWidthDouble();
+    std::string deviceVendor();
+    std::string deviceName();
+    std::string driverVersion();
 
     // debugging
     void print();
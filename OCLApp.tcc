@@ -35,14 +35,7 @@ OCLApp::createBufferWithPointer(const size_t n,
         return -1;
 
     // success
-    const int buffer_index = membuffers.size();
-    membuffers.push_back(buffer);
-    memptrs.push_back(ptr);
-    memownptrs.push_back(own_memptr);
-    memsizeoftype.push_back(sizeof(T));
-    memsize.push_back(n);
-
-    return buffer_index;
+    return storeBuffer(buffer, ptr, own_memptr, sizeof(T), n, flags, false);
 }
 
 template <typename T>
@@ -173,6 +166,31 @@ OCLApp::createBuffer(const size_t n,
     return createBufferWithPointer<T>(n, flags, ptr, false);
 }
 
+template <typename T>
+int
+OCLApp::createPooledBuffer(const size_t n,
+                           BUFFER_FLAGS mode,
+                           bool pinned)
+{
+    cl_mem_flags flags;
+
+    switch (mode)
+    {
+        case (READ) : flags = CL_MEM_READ_ONLY; break;
+        case (WRITE) : flags = CL_MEM_WRITE_ONLY; break;
+        case (READWRITE) : flags = CL_MEM_READ_WRITE; break;
+    }
+
+    // zero-copy buffers use the host shadow array as device memory
+    if (zero_copy)
+        flags |= CL_MEM_USE_HOST_PTR;
+    else if (pinned)
+        flags |= CL_MEM_ALLOC_HOST_PTR;
+
+    // host shadow array contents are undefined, caller must fill and sync
+    return acquirePooledBuffer(sizeof(T), n, flags);
+}
+
 template <typename T>
 int
 OCLApp::createImage(const size_t width,  // pixel dimensions, so multiply by 4 for number of floats
@@ -17,6 +17,7 @@
 
 #include <iostream>
 #include <string>
+#include <string.h>
 #include "OCLAppUtil.hpp"
 
 #include "declare_namespace"
@@ -32,7 +33,28 @@ bool clearImage(OCLApp& oclApp, const size_t imageIndex) {
 }
 
 bool syncBufferToDevice(OCLApp& oclApp, const size_t bufferIndex) {
-    // retrieve output
+    // zero-copy buffer, map and unmap so the device sees the host array
+    if (oclApp.zeroCopyBuffer(bufferIndex)) {
+        const int mapBuf = oclApp.enqueueMapBuffer(bufferIndex, OCLApp::WRITE);
+        if (-1 == mapBuf || !oclApp.wait(mapBuf)) {
+            std::cerr << "error: map input buffer " << bufferIndex << std::endl;
+            return false;
+        }
+
+        // nothing to write if the device maps the host array itself
+        const char *hostPtr = oclApp.bufferPtr<char>(bufferIndex);
+        void *mappedPtr = oclApp.mappedPtr(bufferIndex);
+        if (mappedPtr != hostPtr) memcpy(mappedPtr, hostPtr, oclApp.bufferBytes(bufferIndex));
+
+        const int unmapBuf = oclApp.enqueueUnmapBuffer(bufferIndex);
+        if (-1 == unmapBuf || !oclApp.wait(unmapBuf)) {
+            std::cerr << "error: unmap input buffer " << bufferIndex << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // send input
     const int syncBuf = oclApp.enqueueWriteBuffer(bufferIndex);
     if (-1 == syncBuf || !oclApp.wait(syncBuf)) {
         std::cerr << "error: send input buffer " << bufferIndex << std::endl;
@@ -42,6 +64,21 @@ bool syncBufferToDevice(OCLApp& oclApp, const size_t bufferIndex) {
 }
 
 bool syncBufferFromDevice(OCLApp& oclApp, const size_t bufferIndex) {
+    // zero-copy buffer, host array is up to date once mapped
+    if (oclApp.zeroCopyBuffer(bufferIndex)) {
+        const int mapBuf = oclApp.enqueueMapBuffer(bufferIndex, OCLApp::READ);
+        if (-1 == mapBuf || !oclApp.wait(mapBuf)) {
+            std::cerr << "error: map output buffer " << bufferIndex << std::endl;
+            return false;
+        }
+        const int unmapBuf = oclApp.enqueueUnmapBuffer(bufferIndex);
+        if (-1 == unmapBuf || !oclApp.wait(unmapBuf)) {
+            std::cerr << "error: unmap output buffer " << bufferIndex << std::endl;
+            return false;
+        }
+        return true;
+    }
+
     // retrieve output
     const int syncBuf = oclApp.enqueueReadBuffer(bufferIndex);
     if (-1 == syncBuf || !oclApp.wait(syncBuf)) {
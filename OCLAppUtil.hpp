@@ -60,11 +60,15 @@ bool checkArray(const T *ptr, const size_t length, const T testValue) {
     return goodElements;
 }
 
+bool syncBufferToDevice(OCLApp& oclApp, const size_t bufferIndex);
+bool syncBufferFromDevice(OCLApp& oclApp, const size_t bufferIndex);
+bool syncImageToDevice(OCLApp& oclApp, const size_t imageIndex);
+bool syncImageFromDevice(OCLApp& oclApp, const size_t imageIndex);
+
 template <typename T>
 bool clearBuffer(OCLApp& oclApp, const size_t bufferIndex, const T value = 0) {
     oclApp.memsetBuffer<T>(bufferIndex, value);
-    const int syncBuf = oclApp.enqueueWriteBuffer(bufferIndex);
-    if (-1 == syncBuf || !oclApp.wait(syncBuf)) {
+    if (!syncBufferToDevice(oclApp, bufferIndex)) {
         std::cerr << "error: reset output buffer " << bufferIndex << std::endl;
         return false;
     }
@@ -77,8 +81,7 @@ template <typename T>
 bool fillrandBuffer(OCLApp& oclApp, const size_t bufferIndex, const size_t length) {
     T *ptr = oclApp.bufferPtr<T>(bufferIndex);
     fillrand<T>(ptr, length);
-    const int syncBuf = oclApp.enqueueWriteBuffer(bufferIndex);
-    if (-1 == syncBuf || !oclApp.wait(syncBuf)) {
+    if (!syncBufferToDevice(oclApp, bufferIndex)) {
         std::cerr << "error: random fill buffer " << bufferIndex << std::endl;
         return false;
     }
@@ -336,17 +339,16 @@ template <typename SCALAR_TYPE, size_t VECTOR_LENGTH>
 int createBufferR(OCLApp& oclApp, const size_t bufSize,
                   const std::string& argName,
                   const SCALAR_TYPE value = 0, const bool pinned = false) {
-    SCALAR_TYPE *ptr = alloc_memalign<SCALAR_TYPE, VECTOR_LENGTH>(bufSize);
-    if (NULL == ptr) {
+    const int bufHandle = oclApp.createPooledBuffer<SCALAR_TYPE>(bufSize, OCLApp::READ, pinned);
+    if (-1 == bufHandle) {
         std::cerr << "error: OCL create buffer for " << argName << std::endl;
         return -1;
     }
-    fillconst<SCALAR_TYPE>(ptr, value, bufSize);
-    const int bufHandle = oclApp.createBuffer<SCALAR_TYPE>(bufSize, OCLApp::READ, ptr, pinned);
-    if (-1 == bufHandle) {
+    fillconst<SCALAR_TYPE>(oclApp.bufferPtr<SCALAR_TYPE>(bufHandle), value, bufSize);
+    if (!syncBufferToDevice(oclApp, bufHandle)) {
         std::cerr << "error: OCL create buffer for " << argName << std::endl;
-    } else {
-        oclApp.ownBuffer(bufHandle);
+        oclApp.releaseBuffer(bufHandle);
+        return -1;
     }
     return bufHandle;
 }
@@ -355,17 +357,16 @@ template <typename SCALAR_TYPE, size_t VECTOR_LENGTH>
 int createBufferW(OCLApp& oclApp, const size_t bufSize,
                   const std::string& argName,
                   const SCALAR_TYPE value = 0, const bool pinned = false) {
-    SCALAR_TYPE *ptr = alloc_memalign<SCALAR_TYPE, 1>(bufSize);
-    if (NULL == ptr) {
+    const int bufHandle = oclApp.createPooledBuffer<SCALAR_TYPE>(bufSize, OCLApp::WRITE, pinned);
+    if (-1 == bufHandle) {
         std::cerr << "error: OCL create buffer for " << argName << std::endl;
         return -1;
     }
-    fillconst<SCALAR_TYPE>(ptr, value, bufSize);
-    const int bufHandle = oclApp.createBuffer<SCALAR_TYPE>(bufSize, OCLApp::WRITE, ptr, pinned);
-    if (-1 == bufHandle) {
+    fillconst<SCALAR_TYPE>(oclApp.bufferPtr<SCALAR_TYPE>(bufHandle), value, bufSize);
+    if (!syncBufferToDevice(oclApp, bufHandle)) {
         std::cerr << "error: OCL create buffer for " << argName << std::endl;
-    } else {
-        oclApp.ownBuffer(bufHandle);
+        oclApp.releaseBuffer(bufHandle);
+        return -1;
     }
     return bufHandle;
 }
@@ -374,26 +375,20 @@ template <typename SCALAR_TYPE, size_t VECTOR_LENGTH>
 int createBufferRW(OCLApp& oclApp, const size_t bufSize,
                    const std::string& argName,
                    const SCALAR_TYPE value = 0, const bool pinned = false) {
-    SCALAR_TYPE *ptr = alloc_memalign<SCALAR_TYPE, VECTOR_LENGTH>(bufSize);
-    if (NULL == ptr) {
+    const int bufHandle = oclApp.createPooledBuffer<SCALAR_TYPE>(bufSize, OCLApp::READWRITE, pinned);
+    if (-1 == bufHandle) {
         std::cerr << "error: OCL create buffer for " << argName << std::endl;
         return -1;
     }
-    fillconst<SCALAR_TYPE>(ptr, value, bufSize);
-    const int bufHandle = oclApp.createBuffer<SCALAR_TYPE>(bufSize, OCLApp::READWRITE, ptr, pinned);
-    if (-1 == bufHandle) {
+    fillconst<SCALAR_TYPE>(oclApp.bufferPtr<SCALAR_TYPE>(bufHandle), value, bufSize);
+    if (!syncBufferToDevice(oclApp, bufHandle)) {
         std::cerr << "error: OCL create buffer for " << argName << std::endl;
-    } else {
-        oclApp.ownBuffer(bufHandle);
+        oclApp.releaseBuffer(bufHandle);
+        return -1;
     }
     return bufHandle;
 }
 
-bool syncBufferToDevice(OCLApp& oclApp, const size_t bufferIndex);
-bool syncBufferFromDevice(OCLApp& oclApp, const size_t bufferIndex);
-bool syncImageToDevice(OCLApp& oclApp, const size_t imageIndex);
-bool syncImageFromDevice(OCLApp& oclApp, const size_t imageIndex);
-
 bool setArgGlobal(OCLApp& oclApp, const size_t kernelHandle, const size_t argIndex, const size_t bufHandle,
                   const std::string& argName);
 
@@ -17,7 +17,11 @@
 
 #include "OCLBase.hpp"
 #include "OCLUtil.hpp"
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
 
 using namespace std;
 
@@ -76,6 +80,66 @@ void printDeviceInfoParams(std::map<cl_device_info, std::vector<T> >& mapDevInfo
     }
 }
 
+// device info cache values by (device index, parameter)
+typedef std::map<std::pair<size_t, cl_device_info>, cl_ulong>    cache_info_values;
+typedef std::map<std::pair<size_t, cl_device_info>, std::string> cache_string_values;
+
+template <typename T>
+void saveDeviceInfoParams(std::ostream& os,
+                          std::map<cl_device_info, std::vector<T> >& mapDevInfo,
+                          const cl_device_info *listParams,
+                          const size_t numParams,
+                          const size_t device_index) {
+    for (size_t i = 0; i < numParams; i++)
+    {
+        const cl_device_info key = listParams[i];
+
+        os << "info\t" << device_index
+           << "\t" << key
+           << "\t" << static_cast<cl_ulong>(mapDevInfo[key][device_index])
+           << endl;
+    }
+}
+
+template <typename T>
+bool loadDeviceInfoParams(std::map<cl_device_info, std::vector<T> >& mapDevInfo,
+                          const cl_device_info *listParams,
+                          const size_t numParams,
+                          const cache_info_values& cacheValues,
+                          const size_t device_index) {
+    for (size_t i = 0; i < numParams; i++)
+    {
+        const cl_device_info key = listParams[i];
+
+        const cache_info_values::const_iterator iter
+            = cacheValues.find(std::make_pair(device_index, key));
+
+        // cache is missing a parameter
+        if (cacheValues.end() == iter)
+            return false;
+
+        mapDevInfo[key].push_back(static_cast<T>(iter->second));
+    }
+
+    return true;
+}
+
+static string deviceString(const cl_device_id device_id,
+                           const cl_device_info key) {
+    char buffer[512]; // arbitrary length
+
+    return checkFail(
+               clGetDeviceInfo(device_id,
+                               key,
+                               sizeof(buffer),
+                               buffer,
+                               NULL),
+               "get device info ",
+               devinfo(key))
+               ? ""
+               : buffer;
+}
+
 
 // cl_device_type valued cl_device_info parameters
 static const cl_device_info cl_device_type_params[] = {
@@ -186,6 +250,19 @@ OCLBase::init_platforms()
     for (size_t i = 0; i < num_platforms; i++)
     {
         platforms.push_back(platform_ids[i]);
+
+        // version validates the device info cache
+        char buffer[512]; // arbitrary length
+        platform_version.push_back(
+            checkFail(
+                clGetPlatformInfo(platform_ids[i],
+                                  CL_PLATFORM_VERSION,
+                                  sizeof(buffer),
+                                  buffer,
+                                  NULL),
+                "get platform version")
+                ? ""
+                : buffer);
     }
 }
 
@@ -204,6 +281,18 @@ OCLBase::insert_device(const cl_device_id device_id,
     devices.push_back(device_id);
     device_platform.push_back(platform_index); // keep track of parent platform
 
+    // enough to tell if the device info cache is for this device
+    device_name.push_back(deviceString(device_id, CL_DEVICE_NAME));
+    device_driver.push_back(deviceString(device_id, CL_DRIVER_VERSION));
+
+    return insert_index;
+}
+
+void
+OCLBase::query_device(const size_t device_index)
+{
+    const cl_device_id device_id = devices[device_index];
+
     // only cl_device_type valued device info parameters
     storeDeviceInfoParams<cl_device_type>(
         device_info_cl_device_type,
@@ -243,7 +332,7 @@ OCLBase::insert_device(const cl_device_id device_id,
     storeDeviceInfoParams<cl_device_fp_config>(
         device_info_cl_device_fp_config,
         cl_device_fp_config_params,
-        sizeof(cl_device_fp_config)/sizeof(cl_device_info),
+        sizeof(cl_device_fp_config_params)/sizeof(cl_device_info),
         device_id);
 
     // only cl_device_mem_cache_type valued device info parameters
@@ -272,19 +361,7 @@ OCLBase::insert_device(const cl_device_id device_id,
     {
         const cl_device_info key = string_params[i];
 
-        char buffer[512]; // arbitrary length
-
-        device_stringinfo[key].push_back(
-            checkFail(
-                clGetDeviceInfo(device_id,
-                                key,
-                                sizeof(buffer),
-                                buffer,
-                                NULL),
-                "get device info ",
-                devinfo(key))
-                ? ""
-                : buffer);
+        device_stringinfo[key].push_back(deviceString(device_id, key));
     }
 
     // work item dimensions handled as a special case
@@ -315,8 +392,6 @@ OCLBase::insert_device(const cl_device_id device_id,
 
         device_workdim.push_back(work_item_dim);
     }
-
-    return insert_index;
 }
 
 void
@@ -372,85 +447,403 @@ OCLBase::init_devices()
             }
         }
     }
+
+    // contexts and queues are created on first use
+    contexts.resize(devices.size(), NULL);
+    queues.resize(devices.size());
+
+    // querying every device parameter is slow, use the cache if still valid
+    if (! load_cache())
+    {
+        for (size_t i = 0; i < devices.size(); i++)
+            query_device(i);
+
+        save_cache();
+    }
 }
 
-void
-OCLBase::init_contexts()
+bool
+OCLBase::load_cache()
 {
-    // every device has one context
+    if (cache_file.empty())
+        return false;
+
+    ifstream cache(cache_file.c_str());
+    if (! cache.is_open())
+        return false;
+
+    vector<string>         cache_platform;
+    vector<size_t>         cache_device_platform;
+    vector<string>         cache_device_name, cache_device_driver;
+    cache_info_values      cache_info;
+    cache_string_values    cache_string;
+    map<size_t, vec_size_t> cache_workdim;
+
+    // tab separated records, strings are the rest of the line
+    string line;
+    while (getline(cache, line))
+    {
+        stringstream ss(line);
+        string tag;
+        getline(ss, tag, '\t');
+
+        if ("platform" == tag)
+        {
+            string version;
+            getline(ss, version);
+            cache_platform.push_back(version);
+        }
+        else if ("device" == tag)
+        {
+            size_t platform_index;
+            string name, driver;
+            ss >> platform_index;
+            ss.ignore();
+            getline(ss, name, '\t');
+            getline(ss, driver);
+            cache_device_platform.push_back(platform_index);
+            cache_device_name.push_back(name);
+            cache_device_driver.push_back(driver);
+        }
+        else if ("info" == tag)
+        {
+            size_t device_index;
+            cl_device_info key;
+            cl_ulong value;
+            if (ss >> device_index >> key >> value)
+                cache_info[make_pair(device_index, key)] = value;
+        }
+        else if ("string" == tag)
+        {
+            size_t device_index;
+            cl_device_info key;
+            string value;
+            ss >> device_index >> key;
+            ss.ignore();
+            getline(ss, value);
+            cache_string[make_pair(device_index, key)] = value;
+        }
+        else if ("workdim" == tag)
+        {
+            size_t device_index, dim;
+            ss >> device_index;
+            vec_size_t& work_item_dim = cache_workdim[device_index];
+            while (ss >> dim)
+                work_item_dim.push_back(dim);
+        }
+    }
+
+    // stale if anything about the platforms or devices changed
+    if (cache_platform != platform_version ||
+        cache_device_platform != device_platform ||
+        cache_device_name != device_name ||
+        cache_device_driver != device_driver)
+        return false;
+
     for (size_t i = 0; i < devices.size(); i++)
     {
-        // fails to compile for NVIDIA OpenCL SDK if declared const
-        cl_context_properties props[] = {
-            CL_CONTEXT_PLATFORM,
-            (cl_context_properties)
-                platforms[device_platform[i]],
-            0 };
-
-        // create context for device
-        cl_int status;
-        contexts.push_back(
-            clCreateContext(props,
-                            1,
-                            &devices[i],
-                            NULL,
-                            NULL,
-                            &status));
-
-        // just print an error message if context creation fails
-        checkFail(status, "create context for device ", i);
+        bool rc =
+            loadDeviceInfoParams<cl_device_type>(
+                device_info_cl_device_type,
+                cl_device_type_params,
+                sizeof(cl_device_type_params)/sizeof(cl_device_info),
+                cache_info,
+                i) &&
+            loadDeviceInfoParams<cl_uint>(
+                device_info_cl_uint,
+                cl_uint_params,
+                sizeof(cl_uint_params)/sizeof(cl_device_info),
+                cache_info,
+                i) &&
+            loadDeviceInfoParams<size_t>(
+                device_info_size_t,
+                size_t_params,
+                sizeof(size_t_params)/sizeof(cl_device_info),
+                cache_info,
+                i) &&
+            loadDeviceInfoParams<cl_ulong>(
+                device_info_cl_ulong,
+                cl_ulong_params,
+                sizeof(cl_ulong_params)/sizeof(cl_device_info),
+                cache_info,
+                i) &&
+            loadDeviceInfoParams<cl_bool>(
+                device_info_cl_bool,
+                cl_bool_params,
+                sizeof(cl_bool_params)/sizeof(cl_device_info),
+                cache_info,
+                i) &&
+            loadDeviceInfoParams<cl_device_fp_config>(
+                device_info_cl_device_fp_config,
+                cl_device_fp_config_params,
+                sizeof(cl_device_fp_config_params)/sizeof(cl_device_info),
+                cache_info,
+                i) &&
+            loadDeviceInfoParams<cl_device_mem_cache_type>(
+                device_info_cl_device_mem_cache_type,
+                cl_device_mem_cache_type_params,
+                sizeof(cl_device_mem_cache_type_params)/sizeof(cl_device_info),
+                cache_info,
+                i) &&
+            loadDeviceInfoParams<cl_device_local_mem_type>(
+                device_info_cl_device_local_mem_type,
+                cl_device_local_mem_type_params,
+                sizeof(cl_device_local_mem_type_params)/sizeof(cl_device_info),
+                cache_info,
+                i) &&
+            loadDeviceInfoParams<cl_device_exec_capabilities>(
+                device_info_cl_device_exec_capabilities,
+                cl_device_exec_capabilities_params,
+                sizeof(cl_device_exec_capabilities_params)/sizeof(cl_device_info),
+                cache_info,
+                i);
+
+        for (size_t j = 0; rc && j < sizeof(string_params)/sizeof(cl_device_info); j++)
+        {
+            const cl_device_info key = string_params[j];
+
+            const cache_string_values::const_iterator iter
+                = cache_string.find(make_pair(i, key));
+
+            if (cache_string.end() == iter)
+                rc = false;
+            else
+                device_stringinfo[key].push_back(iter->second);
+        }
+
+        if (rc && cache_workdim.count(i))
+            device_workdim.push_back(cache_workdim[i]);
+        else
+            rc = false;
+
+        // incomplete cache, discard anything loaded
+        if (! rc)
+        {
+            clear_device_info();
+            return false;
+        }
     }
+
+    return true;
 }
 
-void
-OCLBase::init_queues()
+bool
+OCLBase::save_cache()
 {
-    // devery device has a command queue
+    if (cache_file.empty())
+        return false;
+
+    // write to a temporary file first so readers never see a partial cache
+    const string tmp_file = cache_file + ".tmp";
+
+    ofstream cache(tmp_file.c_str());
+    if (! cache.is_open())
+        return false;
+
+    for (size_t i = 0; i < platform_version.size(); i++)
+        cache << "platform\t" << platform_version[i] << endl;
+
+    for (size_t i = 0; i < devices.size(); i++)
+        cache << "device\t" << device_platform[i]
+              << "\t" << device_name[i]
+              << "\t" << device_driver[i]
+              << endl;
+
     for (size_t i = 0; i < devices.size(); i++)
     {
-        // check if device has an associated context
-        if (contexts[i])
+        saveDeviceInfoParams<cl_device_type>(
+            cache,
+            device_info_cl_device_type,
+            cl_device_type_params,
+            sizeof(cl_device_type_params)/sizeof(cl_device_info),
+            i);
+        saveDeviceInfoParams<cl_uint>(
+            cache,
+            device_info_cl_uint,
+            cl_uint_params,
+            sizeof(cl_uint_params)/sizeof(cl_device_info),
+            i);
+        saveDeviceInfoParams<size_t>(
+            cache,
+            device_info_size_t,
+            size_t_params,
+            sizeof(size_t_params)/sizeof(cl_device_info),
+            i);
+        saveDeviceInfoParams<cl_ulong>(
+            cache,
+            device_info_cl_ulong,
+            cl_ulong_params,
+            sizeof(cl_ulong_params)/sizeof(cl_device_info),
+            i);
+        saveDeviceInfoParams<cl_bool>(
+            cache,
+            device_info_cl_bool,
+            cl_bool_params,
+            sizeof(cl_bool_params)/sizeof(cl_device_info),
+            i);
+        saveDeviceInfoParams<cl_device_fp_config>(
+            cache,
+            device_info_cl_device_fp_config,
+            cl_device_fp_config_params,
+            sizeof(cl_device_fp_config_params)/sizeof(cl_device_info),
+            i);
+        saveDeviceInfoParams<cl_device_mem_cache_type>(
+            cache,
+            device_info_cl_device_mem_cache_type,
+            cl_device_mem_cache_type_params,
+            sizeof(cl_device_mem_cache_type_params)/sizeof(cl_device_info),
+            i);
+        saveDeviceInfoParams<cl_device_local_mem_type>(
+            cache,
+            device_info_cl_device_local_mem_type,
+            cl_device_local_mem_type_params,
+            sizeof(cl_device_local_mem_type_params)/sizeof(cl_device_info),
+            i);
+        saveDeviceInfoParams<cl_device_exec_capabilities>(
+            cache,
+            device_info_cl_device_exec_capabilities,
+            cl_device_exec_capabilities_params,
+            sizeof(cl_device_exec_capabilities_params)/sizeof(cl_device_info),
+            i);
+
+        for (size_t j = 0; j < sizeof(string_params)/sizeof(cl_device_info); j++)
         {
-            // create command queue for device
-            cl_int status;
-            queues.push_back(
-                clCreateCommandQueue(contexts[i],
-                                     devices[i],
-                // Note: ATI SDK device info returns profiling support only
-                // for both Core i7 CPU and Radeon 5870 GPU but queue creation
-                // still succeeds when passing out of order mode enable flag.
-                // From AMD support forums, as of SDK v2.0, the Catalyst driver
-                // does not support concurrent kernel execution although the
-                // hardware has the capability (i.e. Eyefinity).
-                                     CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE |
-                                     CL_QUEUE_PROFILING_ENABLE,
-                                     &status));
-
-            // just print an error message if queue creation fails
-            checkFail(status, "create command queue for device ", i);
+            const cl_device_info key = string_params[j];
+
+            cache << "string\t" << i
+                  << "\t" << key
+                  << "\t" << device_stringinfo[key][i]
+                  << endl;
         }
+
+        cache << "workdim\t" << i;
+        for (size_t j = 0; j < device_workdim[i].size(); j++)
+            cache << "\t" << device_workdim[i][j];
+        cache << endl;
     }
+
+    cache.close();
+    if (cache.fail() || 0 != rename(tmp_file.c_str(), cache_file.c_str()))
+    {
+        remove(tmp_file.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void
+OCLBase::clear_device_info()
+{
+    device_info_cl_device_type.clear();
+    device_info_cl_uint.clear();
+    device_info_size_t.clear();
+    device_info_cl_ulong.clear();
+    device_info_cl_bool.clear();
+    device_info_cl_device_fp_config.clear();
+    device_info_cl_device_mem_cache_type.clear();
+    device_info_cl_device_local_mem_type.clear();
+    device_info_cl_device_exec_capabilities.clear();
+    device_stringinfo.clear();
+    device_workdim.clear();
+}
+
+cl_context
+OCLBase::create_context(const size_t device_index)
+{
+    // fails to compile for NVIDIA OpenCL SDK if declared const
+    cl_context_properties props[] = {
+        CL_CONTEXT_PLATFORM,
+        (cl_context_properties)
+            platforms[device_platform[device_index]],
+        0 };
+
+    // create context for device
+    cl_int status;
+    cl_context context =
+        clCreateContext(props,
+                        1,
+                        &devices[device_index],
+                        NULL,
+                        NULL,
+                        &status);
+
+    // just print an error message if context creation fails
+    if (checkFail(status, "create context for device ", device_index))
+        return NULL;
+
+    return context;
+}
+
+cl_command_queue
+OCLBase::create_queue(const size_t device_index)
+{
+    // check if device has an associated context
+    if (! getContext(device_index))
+        return NULL;
+
+    cl_int status;
+    cl_command_queue queue =
+        clCreateCommandQueue(contexts[device_index],
+                             devices[device_index],
+        // Note: ATI SDK device info returns profiling support only
+        // for both Core i7 CPU and Radeon 5870 GPU but queue creation
+        // still succeeds when passing out of order mode enable flag.
+        // From AMD support forums, as of SDK v2.0, the Catalyst driver
+        // does not support concurrent kernel execution although the
+        // hardware has the capability (i.e. Eyefinity).
+                             CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE |
+                             CL_QUEUE_PROFILING_ENABLE,
+                             &status);
+
+    // just print an error message if queue creation fails
+    if (checkFail(status, "create command queue for device ", device_index))
+        return NULL;
+
+    return queue;
 }
 
 OCLBase::OCLBase()
+    : cache_file(defaultCacheFile())
+{
+    init_platforms();
+    init_devices();
+}
+
+OCLBase::OCLBase(const string& file)
+    : cache_file(file)
 {
     init_platforms();
     init_devices();
-    init_contexts();
-    init_queues();
 }
 
 OCLBase::~OCLBase()
 {
     for (size_t i = 0; i < queues.size(); i++)
-        if (queues[i])
-            checkFail(clReleaseCommandQueue(queues[i]), "release queue ", i);
+        for (size_t j = 0; j < queues[i].size(); j++)
+            if (queues[i][j])
+                checkFail(clReleaseCommandQueue(queues[i][j]),
+                          "release queue ", j, " for device ", i);
 
     for (size_t i = 0; i < contexts.size(); i++)
         if (contexts[i])
             checkFail(clReleaseContext(contexts[i]), "release context ", i);
 }
 
+string
+OCLBase::defaultCacheFile()
+{
+    const char *env_file = getenv("GATLAS_DEVICE_CACHE");
+    if (env_file)
+        return env_file; // empty disables the cache
+
+    const char *home_dir = getenv("HOME");
+    if (home_dir)
+        return string(home_dir) + "/.gatlas_device_cache";
+
+    return "";
+}
+
 cl_device_id&
 OCLBase::getDevice(const size_t index)
 {
@@ -460,13 +853,34 @@ OCLBase::getDevice(const size_t index)
 cl_context&
 OCLBase::getContext(const size_t index)
 {
+    // programs only use one device, do not create contexts for the others
+    if (! contexts[index])
+        contexts[index] = create_context(index);
+
     return contexts[index];
 }
 
 cl_command_queue&
 OCLBase::getQueue(const size_t index)
 {
-    return queues[index];
+    return getQueue(index, 0);
+}
+
+cl_command_queue&
+OCLBase::getQueue(const size_t device_index, const size_t queue_index)
+{
+    // queues on the same device share the context so events from one
+    // may be used as dependencies for commands enqueued on another
+    while (queues[device_index].size() <= queue_index)
+        queues[device_index].push_back(create_queue(device_index));
+
+    return queues[device_index][queue_index];
+}
+
+size_t
+OCLBase::numberQueues(const size_t device_index) const
+{
+    return queues[device_index].size();
 }
 
 vector<size_t>
@@ -539,6 +953,60 @@ OCLBase::globalMemory(const size_t device_index)
     return device_info_cl_ulong[CL_DEVICE_GLOBAL_MEM_SIZE][device_index];
 }
 
+size_t
+OCLBase::maxClockFrequency(const size_t device_index)
+{
+    return device_info_cl_uint[CL_DEVICE_MAX_CLOCK_FREQUENCY][device_index];
+}
+
+size_t
+OCLBase::preferredVectorWidthFloat(const size_t device_index)
+{
+    return device_info_cl_uint[CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT][device_index];
+}
+
+size_t
+OCLBase::preferredVectorWidthDouble(const size_t device_index)
+{
+    return device_info_cl_uint[CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE][device_index];
+}
+
+string
+OCLBase::deviceVendor(const size_t device_index)
+{
+    return device_stringinfo[CL_DEVICE_VENDOR][device_index];
+}
+
+string
+OCLBase::deviceName(const size_t device_index)
+{
+    return device_stringinfo[CL_DEVICE_NAME][device_index];
+}
+
+string
+OCLBase::driverVersion(const size_t device_index)
+{
+    return device_stringinfo[CL_DRIVER_VERSION][device_index];
+}
+
+bool
+OCLBase::hostUnifiedMemory(const size_t device_index)
+{
+#ifdef CL_DEVICE_HOST_UNIFIED_MEMORY
+    // OpenCL 1.1 reports this directly, 1.0 platforms fail the query
+    cl_bool value;
+    if (CL_SUCCESS == clGetDeviceInfo(devices[device_index],
+                                      CL_DEVICE_HOST_UNIFIED_MEMORY,
+                                      sizeof(value),
+                                      &value,
+                                      NULL))
+        return value;
+#endif
+
+    // CPU devices always share memory with the host
+    return CL_DEVICE_TYPE_CPU & device_info_cl_device_type[CL_DEVICE_TYPE][device_index];
+}
+
 void
 OCLBase::print(const size_t device_index, const char *prepend)
 {
@@ -546,8 +1014,10 @@ OCLBase::print(const size_t device_index, const char *prepend)
         << prepend
         << "device[" << device_index << "] = " << devices[device_index]
         << "\tcontext " << contexts[device_index]
-        << "\tqueue " << queues[device_index]
-        << endl;
+        << "\tqueue";
+    for (size_t i = 0; i < queues[device_index].size(); i++)
+        cout << " " << queues[device_index][i];
+    cout << endl;
 
     // only cl_device_type valued device info parameters
     printDeviceInfoParams<cl_device_type>(
@@ -19,6 +19,8 @@
 //    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <CL/cl.h>
+#include <string>
+#include <vector>
 #include "OCLSTL.hpp"
 #include "OCLUtil.hpp"
 
@@ -29,12 +31,15 @@ class OCLBase
     // platforms
     vec_platform_id    platforms;         // platform index -> platform id
     map_setindex       platform_devices;  // platform index -> set of dev idx
+    std::vector<std::string> platform_version; // platform index -> version
     void init_platforms();
 
     // devices
     vec_device_id      devices;           // device index -> device id
     vec_size_t         device_platform;   // device index -> platform index
     vec_vec_size_t     device_workdim;    // device index -> work item dims
+    std::vector<std::string> device_name;   // device index -> name
+    std::vector<std::string> device_driver; // device index -> driver version
 
     // info type -> device index -> value
     map_devinfo_cl_device_type              device_info_cl_device_type;
@@ -51,26 +56,42 @@ class OCLBase
     map_devinfo_string                      device_stringinfo;
 
     int insert_device(const cl_device_id, const size_t);
+    void query_device(const size_t device_index);
     void init_devices();
 
-    // contexts, one-to-one correspondence with devices
+    // device info cache file, valid while the platform and driver versions,
+    // device names and order stay the same (empty file name disables)
+    const std::string  cache_file;
+    bool load_cache();
+    bool save_cache();
+    void clear_device_info();
+
+    // contexts, one-to-one correspondence with devices, created on first use
     vec_context        contexts; // device index -> context handle
-    void init_contexts();
+    cl_context create_context(const size_t device_index);
 
-    // command queues, one-to-one correspondence with devices
-    vec_command_queue  queues;   // device index -> queue handle
-    void init_queues();
+    // command queues, created on first use (more than one per device allows
+    // copying concurrently with kernels)
+    std::vector<vec_command_queue> queues; // device index -> queue handles
+    cl_command_queue create_queue(const size_t device_index);
 
     vec_size_t deviceIndexes(const cl_device_type);
 
 public:
 
-    OCLBase();
+    OCLBase(); // default device info cache file
+    OCLBase(const std::string& cache_file);
     ~OCLBase();
 
+    // $GATLAS_DEVICE_CACHE if set, otherwise in the home directory
+    static std::string defaultCacheFile();
+
     cl_device_id&     getDevice(const size_t);
     cl_context&       getContext(const size_t);
     cl_command_queue& getQueue(const size_t);
+    cl_command_queue& getQueue(const size_t device_index,
+                               const size_t queue_index);
+    size_t numberQueues(const size_t device_index) const;
 
     // returns device indexes
     std::vector<size_t> cpuIndexes(); // CPU devices
@@ -84,6 +105,13 @@ public:
     size_t maxConstBuffer(const size_t device_index);
     size_t localMemory(const size_t device_index);
     size_t globalMemory(const size_t device_index);
+    bool hostUnifiedMemory(const size_t device_index);
+    size_t maxClockFrequency(const size_t device_index);
+    size_t preferredVectorWidthFloat(const size_t device_index);
+    size_t preferredVectorWidthDouble(const size_t device_index);
+    std::string deviceVendor(const size_t device_index);
+    std::string deviceName(const size_t device_index);
+    std::string driverVersion(const size_t device_index);
 
     // debugging
     void print(const size_t device_index, const char *prepend = "");
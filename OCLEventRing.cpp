@@ -0,0 +1,299 @@
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "OCLEventRing.hpp"
+
+using namespace std;
+
+#include "declare_namespace"
+
+OCLEventRing::OCLEventRing()
+    : next_slot(0),
+      events_pending(0)
+{
+    for (size_t i = 0; i < RING_SIZE; i++)
+    {
+        slot_event[i] = NULL;
+        slot_generation[i] = 0;
+        slot_used[i] = false;
+        slot_waited[i] = false;
+        slot_profiled[i] = false;
+        slot_user[i] = false;
+    }
+}
+
+OCLEventRing::~OCLEventRing()
+{
+    waitAll();
+}
+
+bool
+OCLEventRing::lookup(const size_t handle, size_t& slot) const
+{
+    slot = handle % RING_SIZE;
+    return slot_used[slot] && handle / RING_SIZE == slot_generation[slot];
+}
+
+void
+OCLEventRing::release(const size_t slot)
+{
+    checkFail(clReleaseEvent(slot_event[slot]), "release event ", slot);
+
+    if (!slot_waited[slot]) events_pending--;
+
+    slot_event[slot] = NULL;
+    slot_used[slot] = false;
+    slot_waited[slot] = false;
+    slot_profiled[slot] = false;
+    slot_user[slot] = false;
+}
+
+bool
+OCLEventRing::complete(const size_t slot)
+{
+#ifdef CL_VERSION_1_1
+    const bool isOk = ! checkFail(clSetUserEventStatus(slot_event[slot], CL_COMPLETE),
+                                  "set user event status ", slot);
+#else
+    const bool isOk = false; // failure
+#endif
+
+    // commands gated by the event may run, nothing is left to wait for
+    release(slot);
+
+    return isOk;
+}
+
+int
+OCLEventRing::insert(const cl_event event)
+{
+    const size_t slot = next_slot;
+    next_slot = (next_slot + 1) % RING_SIZE;
+
+    // ring has wrapped around, the oldest event must go
+    if (slot_used[slot])
+    {
+        // waiting on a user event the host never completed would block forever
+        if (slot_user[slot])
+        {
+            complete(slot);
+        }
+        else
+        {
+            if (!slot_waited[slot])
+                checkFail(clWaitForEvents(1, &slot_event[slot]),
+                          "wait for event ", slot);
+
+            release(slot);
+        }
+    }
+
+    slot_generation[slot] = (slot_generation[slot] + 1) % GENERATION_LIMIT;
+    slot_event[slot] = event;
+    slot_used[slot] = true;
+    slot_waited[slot] = false;
+    slot_profiled[slot] = false;
+    slot_user[slot] = false;
+    events_pending++;
+
+    return slot_generation[slot] * RING_SIZE + slot;
+}
+
+const cl_event *
+OCLEventRing::waitList(const vector<size_t>& handles,
+                       cl_uint& num_events)
+{
+    return waitList(handles.empty() ? NULL : &handles[0],
+                    handles.size(),
+                    num_events);
+}
+
+const cl_event *
+OCLEventRing::waitList(const size_t *handles,
+                       const size_t num_handles,
+                       cl_uint& num_events)
+{
+    num_events = 0;
+
+    for (size_t i = 0; i < num_handles; i++)
+    {
+        size_t slot;
+
+        // released events are already complete so there is nothing to wait for
+        if (lookup(handles[i], slot))
+            wait_list[num_events++] = slot_event[slot];
+    }
+
+    return 0 == num_events ? NULL : wait_list;
+}
+
+bool
+OCLEventRing::wait(const vector<size_t>& handles)
+{
+    return wait(handles.empty() ? NULL : &handles[0], handles.size());
+}
+
+bool
+OCLEventRing::wait(const size_t *handles, const size_t num_handles)
+{
+    cl_uint num_events = 0;
+
+    for (size_t i = 0; i < num_handles; i++)
+    {
+        size_t slot;
+
+        // just to be safe, check that event has not been waited on before,
+        // user events are completed by the host and not waited on
+        if (lookup(handles[i], slot) && !slot_waited[slot] && !slot_user[slot])
+            wait_list[num_events++] = slot_event[slot];
+    }
+
+    if (0 == num_events) return true;
+
+    const bool isOk = ! checkFail(
+        clWaitForEvents(num_events, wait_list),
+        "wait for ", num_events, " events");
+
+    for (size_t i = 0; i < num_handles; i++)
+    {
+        size_t slot;
+
+        if (lookup(handles[i], slot) && !slot_waited[slot] && !slot_user[slot])
+        {
+            slot_waited[slot] = true;
+            events_pending--;
+
+            // nothing more to learn from this event
+            if (slot_profiled[slot]) release(slot);
+        }
+    }
+
+    return isOk;
+}
+
+bool
+OCLEventRing::waitAll()
+{
+    bool isOk = true;
+
+    // commands gated by user events could otherwise never finish
+    for (size_t i = 0; i < RING_SIZE; i++)
+        if (slot_used[i] && slot_user[i])
+            isOk = complete(i) && isOk;
+
+    cl_uint num_events = 0;
+
+    // make list of all active events
+    for (size_t i = 0; i < RING_SIZE; i++)
+        if (slot_used[i] && !slot_waited[i])
+            wait_list[num_events++] = slot_event[i];
+
+    // wait for everything
+    if (0 != num_events &&
+        checkFail(clWaitForEvents(num_events, wait_list),
+                  "wait for ", num_events, " events"))
+        isOk = false;
+
+    // release events
+    for (size_t i = 0; i < RING_SIZE; i++)
+    {
+        if (slot_used[i])
+        {
+            slot_waited[i] = true;
+            release(i);
+        }
+    }
+
+    events_pending = 0;
+
+    return isOk;
+}
+
+vector<unsigned long>
+OCLEventRing::profile(const size_t handle)
+{
+    vector<unsigned long> event_times;
+
+    size_t slot;
+    if (!lookup(handle, slot))
+    {
+        cerr << "profile released event " << handle << endl;
+        return vector<unsigned long>(4, 0); // failure
+    }
+
+    const cl_profiling_info params[] = { CL_PROFILING_COMMAND_QUEUED,
+                                         CL_PROFILING_COMMAND_SUBMIT,
+                                         CL_PROFILING_COMMAND_START,
+                                         CL_PROFILING_COMMAND_END };
+
+    cl_ulong value;
+
+    for (size_t i = 0; i < sizeof(params)/sizeof(cl_profiling_info); i++)
+    {
+        event_times.push_back(
+            checkFail(clGetEventProfilingInfo(slot_event[slot],
+                                              params[i],
+                                              sizeof(value),
+                                              &value,
+                                              NULL),
+                      "get event profiling info")
+            ? 0 // failure
+            : value);
+    }
+
+    // event already waited on is not needed any more
+    slot_profiled[slot] = true;
+    if (slot_waited[slot]) release(slot);
+
+    return event_times;
+}
+
+int
+OCLEventRing::insertUserEvent(const cl_event event)
+{
+    const int handle = insert(event);
+    slot_user[handle % RING_SIZE] = true;
+    return handle;
+}
+
+bool
+OCLEventRing::completeUserEvent(const size_t handle)
+{
+    size_t slot;
+    if (!lookup(handle, slot) || !slot_user[slot])
+    {
+        cerr << "complete released user event " << handle << endl;
+        return false; // failure
+    }
+
+    return complete(slot);
+}
+
+bool
+OCLEventRing::valid(const size_t handle) const
+{
+    size_t slot;
+    return lookup(handle, slot);
+}
+
+size_t
+OCLEventRing::pending() const
+{
+    return events_pending;
+}
+
+} // namespace
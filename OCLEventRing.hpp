@@ -0,0 +1,89 @@
+#ifndef _GATLAS_OCL_EVENT_RING_HPP_
+#define _GATLAS_OCL_EVENT_RING_HPP_
+
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <CL/cl.h>
+#include <vector>
+#include "OCLUtil.hpp"
+
+#include "declare_namespace"
+
+// Fixed size ring of command queue events. Handles carry a generation
+// tag along with the slot index so a handle to an event that has been
+// released and its slot reused is detected instead of aliasing the new
+// event. Events are released as soon as they are both waited on and
+// profiled. When the ring wraps, the oldest event is waited on (if
+// necessary) and released, so bookkeeping never grows.
+class OCLEventRing
+{
+    static const size_t SLOT_BITS = 10;
+    static const size_t RING_SIZE = 1 << SLOT_BITS;
+    static const size_t GENERATION_LIMIT = 1 << 20; // handles fit in an int
+
+    cl_event slot_event[RING_SIZE];
+    size_t   slot_generation[RING_SIZE];
+    bool     slot_used[RING_SIZE];     // slot holds an event
+    bool     slot_waited[RING_SIZE];   // event is known to be complete
+    bool     slot_profiled[RING_SIZE]; // profiling information was read
+    bool     slot_user[RING_SIZE];     // user event, only the host completes it
+
+    size_t   next_slot;
+    size_t   events_pending;           // number of events not waited on yet
+
+    // scratch space for event wait lists, avoids allocating on every call
+    cl_event wait_list[RING_SIZE];
+
+    bool lookup(const size_t handle, size_t& slot) const;
+    void release(const size_t slot);
+    bool complete(const size_t slot);
+
+public:
+    OCLEventRing();
+    ~OCLEventRing();
+
+    // takes ownership of the event, returns handle
+    int insert(const cl_event event);
+
+    // event wait list for enqueue calls, NULL if empty
+    const cl_event *waitList(const std::vector<size_t>& handles,
+                             cl_uint& num_events);
+    const cl_event *waitList(const size_t *handles,
+                             const size_t num_handles,
+                             cl_uint& num_events);
+
+    // blocking waits
+    bool wait(const std::vector<size_t>& handles);
+    bool wait(const size_t *handles, const size_t num_handles);
+    bool waitAll(); // also releases every event
+
+    // return time of: enqueue, submit, start, end
+    std::vector<unsigned long> profile(const size_t handle);
+
+    // user events let the host gate work in command queues, they are never
+    // waited on and are released once completed
+    int insertUserEvent(const cl_event event);
+    bool completeUserEvent(const size_t handle);
+
+    bool valid(const size_t handle) const;
+    size_t pending() const;
+};
+
+}; // namespace
+
+#endif
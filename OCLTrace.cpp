@@ -0,0 +1,229 @@
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "OCLTrace.hpp"
+
+using namespace std;
+
+#include "declare_namespace"
+
+namespace OCLTrace {
+
+struct Event
+{
+    const char    *name;
+    unsigned long  begin;    // microseconds
+    unsigned long  duration; // microseconds
+    size_t         pid;      // host process or device
+    size_t         tid;      // host thread or device queue
+};
+
+// buffers are only registered, never freed, so no lock is needed
+static const size_t MAX_THREADS = 64;
+static vector<Event> *buffers[MAX_THREADS];
+static size_t number_buffers = 0;
+
+static __thread vector<Event> *thread_buffer = NULL;
+static __thread size_t thread_index = 0;
+
+static bool trace_enabled = false;
+static string trace_file;
+static struct timeval trace_start;
+
+// device tracks are after the host process
+static const size_t HOST_PID = 0;
+static const size_t DEVICE_PID = 1;
+
+static vector<Event> *buffer()
+{
+    if (! thread_buffer) {
+        const size_t index = __sync_fetch_and_add(&number_buffers, 1);
+        if (index >= MAX_THREADS) return NULL; // too many threads, not traced
+
+        thread_buffer = new vector<Event>;
+        thread_buffer->reserve(1024);
+        thread_index = index;
+        buffers[index] = thread_buffer;
+    }
+    return thread_buffer;
+}
+
+static void record(const char *name,
+                   const unsigned long begin,
+                   const unsigned long end,
+                   const size_t pid,
+                   const size_t tid)
+{
+    vector<Event> *events = buffer();
+    if (! events) return;
+
+    Event e;
+    e.name = name;
+    e.begin = begin;
+    e.duration = end > begin ? end - begin : 0;
+    e.pid = pid;
+    e.tid = tid;
+    events->push_back(e);
+}
+
+static void dumpAtExit()
+{
+    if (! dump())
+        cerr << "error: could not write trace file " << trace_file << endl;
+    summary(cerr);
+}
+
+void enable(const string& traceFile)
+{
+    if (trace_enabled) return;
+
+    trace_file = traceFile;
+    gettimeofday(&trace_start, 0);
+    trace_enabled = true;
+    atexit(dumpAtExit);
+}
+
+bool enabled()
+{
+    return trace_enabled;
+}
+
+unsigned long now()
+{
+    struct timeval t;
+    gettimeofday(&t, 0);
+    return 1000000UL * (t.tv_sec - trace_start.tv_sec) + t.tv_usec - trace_start.tv_usec;
+}
+
+void host(const char *name,
+          const unsigned long begin,
+          const unsigned long end)
+{
+    if (trace_enabled) record(name, begin, end, HOST_PID, buffer() ? thread_index : 0);
+}
+
+void device(const char *name,
+            const size_t device_index,
+            const size_t queue_index,
+            const unsigned long enqueued,
+            const vector<unsigned long>& device_times)
+{
+    if (! trace_enabled || device_times.size() < 4 || 0 == device_times[0]) return;
+
+    // device clock is in nanoseconds with an arbitrary origin
+    const long offset = static_cast<long>(enqueued) - static_cast<long>(device_times[0] / 1000);
+    const unsigned long start = device_times[2] / 1000 + offset;
+    const unsigned long end = device_times[3] / 1000 + offset;
+
+    record(name, start, end, DEVICE_PID + device_index, queue_index);
+}
+
+bool dump()
+{
+    ofstream os(trace_file.c_str());
+    if (! os.is_open()) return false;
+
+    os << "{\"traceEvents\":[" << endl;
+
+    bool first = true;
+    map<size_t, bool> devices;
+    for (size_t i = 0; i < number_buffers && i < MAX_THREADS; i++) {
+        const vector<Event>& events = *buffers[i];
+        for (size_t j = 0; j < events.size(); j++) {
+            const Event& e = events[j];
+            if (DEVICE_PID <= e.pid) devices[e.pid] = true;
+            os << (first ? "" : ",\n")
+               << "{\"name\":\"" << e.name << "\",\"ph\":\"X\""
+               << ",\"ts\":" << e.begin << ",\"dur\":" << e.duration
+               << ",\"pid\":" << e.pid << ",\"tid\":" << e.tid << "}";
+            first = false;
+        }
+    }
+
+    // name the tracks
+    os << (first ? "" : ",\n")
+       << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << HOST_PID
+       << ",\"args\":{\"name\":\"host\"}}";
+    for (map<size_t, bool>::const_iterator iter = devices.begin();
+         iter != devices.end();
+         iter++)
+        os << ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << (*iter).first
+           << ",\"args\":{\"name\":\"device " << ((*iter).first - DEVICE_PID) << "\"}}";
+
+    os << "\n]}" << endl;
+
+    return ! os.fail();
+}
+
+void summary(ostream& os)
+{
+    const unsigned long session = now();
+
+    // phases nest so times are inclusive and do not add up to the session
+    map<string, unsigned long> phaseTime;
+    map<string, size_t> phaseCount;
+    for (size_t i = 0; i < number_buffers && i < MAX_THREADS; i++) {
+        const vector<Event>& events = *buffers[i];
+        for (size_t j = 0; j < events.size(); j++) {
+            const Event& e = events[j];
+            const string name = DEVICE_PID <= e.pid
+                                    ? string("device ") + e.name
+                                    : string(e.name);
+            phaseTime[name] += e.duration;
+            phaseCount[name]++;
+        }
+    }
+
+    multimap<unsigned long, string> byTime;
+    for (map<string, unsigned long>::const_iterator iter = phaseTime.begin();
+         iter != phaseTime.end();
+         iter++)
+        byTime.insert(pair<unsigned long, string>((*iter).second, (*iter).first));
+
+    os << "trace " << trace_file << " session " << session << " usec" << endl;
+    for (multimap<unsigned long, string>::const_reverse_iterator iter = byTime.rbegin();
+         iter != byTime.rend();
+         iter++) {
+        const double percent = 0 == session ? 0 : 100.0 * (*iter).first / session;
+        os << "\t" << setw(24) << left << (*iter).second << right
+           << setw(12) << (*iter).first << " usec"
+           << setw(8) << phaseCount[(*iter).second] << " calls"
+           << setw(8) << fixed << setprecision(1) << percent << "%" << endl;
+    }
+}
+
+}; // namespace OCLTrace
+
+OCLTraceScope::OCLTraceScope(const char *name)
+    : name(name),
+      begin(OCLTrace::enabled() ? OCLTrace::now() : 0)
+{ }
+
+OCLTraceScope::~OCLTraceScope()
+{
+    if (OCLTrace::enabled()) OCLTrace::host(name, begin, OCLTrace::now());
+}
+
+}; // namespace
@@ -0,0 +1,75 @@
+#ifndef _OCL_TRACE_HPP_
+#define _OCL_TRACE_HPP_
+
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "declare_namespace"
+
+// Low overhead tracing of a tuning session. Host phases and device
+// commands are recorded as complete events (begin and duration) in a
+// buffer owned by each thread, then written as Chrome trace event JSON
+// (open with chrome://tracing or Perfetto) when the process exits, along
+// with a summary of time spent in each phase. Tracing is off unless
+// enabled, so a disabled scope costs one branch.
+namespace OCLTrace
+{
+    // start tracing, the trace file is written at exit
+    void enable(const std::string& traceFile);
+    bool enabled();
+
+    // microseconds since tracing was enabled
+    unsigned long now();
+
+    // host phase on the calling thread (name must be a string literal)
+    void host(const char *name,
+              const unsigned long begin,
+              const unsigned long end);
+
+    // command on a device queue, device timestamps (queued, submit, start,
+    // end in nanoseconds) are aligned to the host clock when it was enqueued
+    void device(const char *name,
+                const size_t device_index,
+                const size_t queue_index,
+                const unsigned long enqueued,
+                const std::vector<unsigned long>& device_times);
+
+    // write the trace file, false on failure
+    bool dump();
+
+    // total time, calls and share of the session for each phase
+    void summary(std::ostream& os);
+}
+
+// records a host phase from construction to destruction
+class OCLTraceScope
+{
+    const char    *name;
+    unsigned long  begin;
+
+public:
+    OCLTraceScope(const char *name);
+    ~OCLTraceScope();
+};
+
+}; // namespace
+
+#endif
@@ -149,6 +149,17 @@ idxlist(const int v0,
     return l;
 }
 
+size_t
+sizeclass(const size_t nbytes)
+{
+    // round up to a quarter step between powers of two, so at most
+    // one fifth of an allocation is wasted
+    size_t base = 1;
+    while (2 * base <= nbytes) base *= 2;
+    const size_t step = base < 4 ? 1 : base / 4;
+    return ((nbytes + step - 1) / step) * step;
+}
+
 template <> bool isfloat<double>() { return false; }
 template <> bool isfloat<float>() { return true; }
 template <> bool isfloat<unsigned int>() { return false; }
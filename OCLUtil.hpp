@@ -66,6 +66,8 @@ std::vector<size_t> idxlist(const int v0 = -1,
                             const int v1 = -1,
                             const int v2 = -1);
 
+size_t sizeclass(const size_t nbytes);
+
 template <typename T> T* alloc_memalign(const size_t);
 template <typename T> T* alloc_memalign(const size_t, const size_t ALIGNMENT);
 template <typename SCALAR, size_t N> SCALAR* alloc_memalign(const size_t);
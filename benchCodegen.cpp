@@ -0,0 +1,250 @@
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "KernelMatmulBuffer.hpp"
+#include "KernelMatmulImage.hpp"
+#include "KernelMatvecBuffer.hpp"
+#include "KernelMatvecImage.hpp"
+#include "KernelSaxpyBuffer.hpp"
+#include "KernelSaxpyImage.hpp"
+
+#include "using_namespace"
+
+using namespace std;
+
+bool parseOpts(int argc, char *argv[],
+               size_t& dimension,
+               size_t& numberRepeats,
+               string& outputFile) {
+    int opt;
+    while ((opt = getopt(argc, argv, "hn:r:o:")) != -1) {
+        switch (opt) {
+            case ('h') :
+                cerr << "usage: " << argv[0]
+                     << " [-n dimension] [-r numberRepeats] [-o outputFile] [-h]" << endl
+                     << "\t-n matrix and vector dimensions (default is 1024)" << endl
+                     << "\t-r generate every kernel this many times (default is 10)" << endl
+                     << "\t-o write the source of every kernel to this file once (default no)" << endl
+                     << "\t-h help" << endl;
+                exit(1);
+            case ('n') : dimension = atoi(optarg); break;
+            case ('r') : numberRepeats = atoi(optarg); break;
+            case ('o') : outputFile = optarg; break;
+        }
+    }
+
+    bool rc = true;
+    if (0 == dimension || 0 != dimension % 64) {
+        cerr << "error: dimension must be a multiple of 64" << endl;
+        rc = false;
+    }
+    if (0 == numberRepeats) {
+        cerr << "error: number of repeats must be at least one" << endl;
+        rc = false;
+    }
+    return rc;
+}
+
+// the same parameter sweeps as the bench tools, without device limits
+vector< vector<size_t> > getParams(KernelBaseMatmul& kernel,
+                                   const size_t vectorLength,
+                                   const size_t dim) {
+    vector< vector<size_t> > pargs;
+    vector<size_t> a;
+    kernel.setMatrixDimensions(dim, dim, dim);
+    for (size_t wg = 1; wg <= 16; wg++) {
+        kernel.setWorkGroup(wg);
+        for (size_t bh = vectorLength; bh <= 8; bh++) {
+            kernel.setInnerBlocking(bh, vectorLength);
+            for (size_t xp = 0; xp < kernel.totalVariations(); xp++) {
+                kernel.setExtraParameter(xp);
+                if (kernel.getParams(a)) pargs.push_back(a);
+            }
+        }
+    }
+    return pargs;
+}
+
+vector< vector<size_t> > getParams(KernelBaseMatvec& kernel,
+                                   const size_t vectorLength,
+                                   const size_t dim) {
+    vector< vector<size_t> > pargs;
+    vector<size_t> a;
+    kernel.setMatrixDimensions(dim, dim);
+    for (size_t wg = 64; wg <= 256; wg += 64) {
+        kernel.setWorkGroup(wg);
+        for (size_t bh = vectorLength; bh <= 8; bh++) {
+            kernel.setInnerBlocking(bh, vectorLength);
+            for (size_t xp = 0; xp < kernel.totalVariations(); xp++) {
+                kernel.setExtraParameter(xp);
+                if (kernel.getParams(a)) pargs.push_back(a);
+            }
+        }
+    }
+    return pargs;
+}
+
+vector< vector<size_t> > getParams(KernelBaseSaxpy& kernel,
+                                   const size_t vectorLength,
+                                   const size_t dim) {
+    vector< vector<size_t> > pargs;
+    vector<size_t> a;
+    kernel.setSaxpyDimensions(dim, dim);
+    kernel.setVectorLength(vectorLength);
+    for (size_t wgHeight = 1; wgHeight <= 16; wgHeight *= 2)
+    for (size_t wgWidth = 1; wgWidth <= 16; wgWidth *= 2) {
+        kernel.setWorkGroup(wgHeight, wgWidth);
+        for (size_t bh = 1; bh <= 4; bh++)
+        for (size_t bw = 1; bw <= 4; bw++) {
+            kernel.setInnerBlocking(bh, bw);
+            for (size_t xp = 0; xp < kernel.totalVariations(); xp++) {
+                kernel.setExtraParameter(xp);
+                if (kernel.getParams(a)) pargs.push_back(a);
+            }
+        }
+    }
+    return pargs;
+}
+
+struct CodegenTotal
+{
+    size_t kernels;
+    size_t bytes;
+    size_t microsecs;
+
+    CodegenTotal() : kernels(0), bytes(0), microsecs(0) { }
+};
+
+// generate source for every parameter combination, as Bench does before
+// each build, and print the rate
+template <typename KERNEL>
+void generate(const string& title,
+              KERNEL& kernel,
+              const size_t vectorLength,
+              const size_t dim,
+              const size_t numberRepeats,
+              ostream *out,
+              CodegenTotal& total) {
+
+    const vector< vector<size_t> > pargs = getParams(kernel, vectorLength, dim);
+
+    size_t bytes = 0;
+    struct timeval start_time, stop_time;
+    gettimeofday(&start_time, 0);
+
+    for (size_t r = 0; r < numberRepeats; r++) {
+        for (size_t i = 0; i < pargs.size(); i++) {
+            kernel.setParams(pargs[i]);
+            stringstream ss;
+            ss << kernel;
+            bytes += ss.str().size();
+            if (out && 0 == r) *out << ss.str() << endl;
+        }
+    }
+
+    gettimeofday(&stop_time, 0);
+    const size_t microsecs = 1000000 * (stop_time.tv_sec - start_time.tv_sec)
+                           + stop_time.tv_usec - start_time.tv_usec;
+
+    const size_t count = numberRepeats * pargs.size();
+    cout << title << "\t" << pargs.size() << " kernels\t";
+    if (0 == microsecs)
+        cout << "-";
+    else
+        cout << (1000000. * count / microsecs);
+    cout << " kernels/sec\t" << (0 == count ? 0 : bytes / count) << " bytes/kernel" << endl;
+
+    total.kernels += count;
+    total.bytes += bytes;
+    total.microsecs += microsecs;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t dimension = 1024;
+    size_t numberRepeats = 10;
+    string outputFile;
+
+    if (!parseOpts(argc, argv, dimension, numberRepeats, outputFile))
+        exit(1);
+
+    ofstream outputStream;
+    ostream *out = NULL;
+    if (! outputFile.empty()) {
+        outputStream.open(outputFile.c_str());
+        if (! outputStream) {
+            cerr << "error: can not write " << outputFile << endl;
+            exit(1);
+        }
+        out = &outputStream;
+    }
+
+    CodegenTotal total;
+
+    // kernel generators in every bench tool
+    {
+        KernelMatmulBuffer<float, 1> k1;
+        KernelMatmulBuffer<float, 2> k2;
+        KernelMatmulBuffer<float, 4> k4;
+        KernelMatmulBuffer<double, 2> d2;
+        KernelMatmulImage<float, 4> i4;
+        KernelMatmulImage<double, 2> j2;
+        generate("matmul float1   ", k1, 1, dimension, numberRepeats, out, total);
+        generate("matmul float2   ", k2, 2, dimension, numberRepeats, out, total);
+        generate("matmul float4   ", k4, 4, dimension, numberRepeats, out, total);
+        generate("matmul double2  ", d2, 2, dimension, numberRepeats, out, total);
+        generate("matmul floatimg ", i4, 4, dimension, numberRepeats, out, total);
+        generate("matmul doubleimg", j2, 2, dimension, numberRepeats, out, total);
+    }
+    {
+        KernelMatvecBuffer<float, 1> k1;
+        KernelMatvecBuffer<float, 4> k4;
+        KernelMatvecBuffer<double, 2> d2;
+        KernelMatvecImage<float, 4> i4;
+        generate("matvec float1   ", k1, 1, dimension, numberRepeats, out, total);
+        generate("matvec float4   ", k4, 4, dimension, numberRepeats, out, total);
+        generate("matvec double2  ", d2, 2, dimension, numberRepeats, out, total);
+        generate("matvec floatimg ", i4, 4, dimension, numberRepeats, out, total);
+    }
+    {
+        KernelSaxpyBuffer<float, 1> k1;
+        KernelSaxpyBuffer<float, 4> k4;
+        KernelSaxpyImage<float, 4> i4;
+        generate("saxpy float1    ", k1, 1, dimension, numberRepeats, out, total);
+        generate("saxpy float4    ", k4, 4, dimension, numberRepeats, out, total);
+        generate("saxpy floatimg  ", i4, 4, dimension, numberRepeats, out, total);
+    }
+
+    cout << "total\t" << total.kernels << " kernels\t";
+    if (0 == total.microsecs)
+        cout << "-";
+    else
+        cout << (1000000. * total.kernels / total.microsecs);
+    cout << " kernels/sec\t" << (0 == total.microsecs ? 0 : total.bytes / total.microsecs)
+         << " MB/sec" << endl;
+
+    return 0;
+}
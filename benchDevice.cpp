@@ -0,0 +1,366 @@
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "GatlasAppUtil.hpp"
+#include "KernelProbeDevice.hpp"
+
+#include "using_namespace"
+
+using namespace std;
+
+bool parseOpts(int argc, char *argv[],
+               string& device,
+               string& journalFile,
+               bool& useFloat,
+               bool& useDouble,
+               size_t& numberTrials,
+               bool& printDebug) {
+    string scalar;
+    int opt;
+    while ((opt = getopt(argc, argv, "hd:j:s:t:v")) != -1) {
+        switch (opt) {
+            case ('h') :
+                cerr << "usage: " << argv[0]
+                     << " -d cpu|gpu|acc|cpuN|gpuN|accN"
+                        " [-j journalFile]"
+                        " [-s float|double]"
+                        " [-t numberTrials]"
+                        " [-v] [-h]"
+                     << endl
+                     << "\t-d cpu, gpu or accelerator device, optional N is the device number" << endl
+                     << "\t-j record results as device limits in the journal (default none)" << endl
+                     << "\t-s scalar type is float or double (default both)" << endl
+                     << "\t-t number of timed kernels for each measurement (default 10)" << endl
+                     << "\t-v print kernel source and status" << endl
+                     << "\t-h print help" << endl;
+                exit(1);
+            case ('d') : device = optarg; break;
+            case ('j') : journalFile = optarg; break;
+            case ('s') : scalar = optarg; break;
+            case ('t') : numberTrials = atoi(optarg); break;
+            case ('v') : printDebug = true; break;
+        }
+    }
+
+    bool rc = true;
+    if (0 != device.find("cpu") && 0 != device.find("gpu") && 0 != device.find("acc")) {
+        cerr << "error: invalid device " << device << endl;
+        rc = false;
+    }
+    if ("float" == scalar) { useFloat = true; useDouble = false; }
+    else if ("double" == scalar) { useFloat = false; useDouble = true; }
+    else if (! scalar.empty()) {
+        cerr << "error: invalid scalar type " << scalar << endl;
+        rc = false;
+    }
+    if (0 == numberTrials) {
+        cerr << "error: number of trials must be at least one" << endl;
+        rc = false;
+    }
+    return rc;
+}
+
+// measurements are in MB/s, MFLOPS and nanoseconds, so are also device limits
+struct DeviceProfile
+{
+    Journal*               journal;
+    map<string, size_t>    results;
+
+    DeviceProfile(Journal* j) : journal(j) { }
+
+    void take(const string& name, const size_t value) {
+        results[name] = value;
+        if (journal) journal->takeDeviceMemo(name, value);
+    }
+
+    // peaks only increase, also over the peaks of earlier runs
+    void takeMax(const string& name, const size_t value) {
+        if (results.count(name) && value <= results[name]) return;
+        results[name] = value;
+
+        const int memoValue = journal ? journal->memoDevice(name) : -1;
+        if (journal && (-1 == memoValue || value > static_cast<size_t>(memoValue)))
+            journal->takeDeviceMemo(name, value);
+    }
+};
+
+// microseconds for one kernel, 0 if the kernel failed
+template <typename SCALAR, size_t VECTOR_LENGTH>
+double timeKernel(KernelProbeDevice<SCALAR, VECTOR_LENGTH>& kernel,
+                  Bench& bench,
+                  const size_t test,
+                  const size_t workItems,
+                  const size_t groupSize,
+                  const size_t loopCount,
+                  const size_t numberTrials,
+                  const bool printDebug) {
+    kernel.setTest(test, workItems, groupSize, loopCount);
+    vector<size_t> args;
+    if (! kernel.getParams(args)) return 0;
+
+    // first run builds the kernel and checks output
+    if (0 == bench.run(1, args, false, false, printDebug)) return 0;
+
+    return static_cast<double>(bench.run(numberTrials, args, false, false)) / numberTrials;
+}
+
+template <typename SCALAR, size_t VECTOR_LENGTH>
+void probeType(OCLApp& oclApp,
+               DeviceProfile& profile,
+               const size_t numberTrials,
+               const bool printDebug) {
+
+    typedef KernelProbeDevice<SCALAR, VECTOR_LENGTH> Probe;
+
+    Probe kernel;
+    Bench bench(oclApp, kernel, printDebug);
+
+    const string typeName = nameof<SCALAR, VECTOR_LENGTH>();
+    const size_t elemSize = sizeof(SCALAR) * VECTOR_LENGTH;
+
+    // enough work items to fill the device, global tests move 32 MB
+    const size_t WORK_ITEMS = 65536;
+    size_t groupSize = 1;
+    while (2 * groupSize <= 256 && 2 * groupSize <= oclApp.maxWorkGroupSize()) groupSize *= 2;
+    const size_t localGroupSize = min(groupSize, Probe::localElements());
+    size_t globalLoop = (32 * 1024 * 1024) / (WORK_ITEMS * elemSize);
+    globalLoop -= globalLoop % Probe::UNROLL;
+    if (0 == globalLoop) globalLoop = Probe::UNROLL;
+    const size_t LOCAL_LOOP = 256;
+    const size_t MAD_LOOP = 256;
+
+    cout << typeName;
+
+    for (size_t test = Probe::GLOBAL_READ; test < Probe::NUMBER_TESTS; test++) {
+
+        // one image pixel holds the vector element
+        if (Probe::IMAGE_READ == test && 16 != elemSize) continue;
+
+        const bool isLocal = Probe::LOCAL_READ == test || Probe::LOCAL_CONFLICT == test;
+        const size_t loopCount = isLocal
+                                     ? LOCAL_LOOP
+                                     : (Probe::MAD_THROUGHPUT == test ? MAD_LOOP : globalLoop);
+
+        const double microsecs = timeKernel(kernel, bench,
+                                            test,
+                                            WORK_ITEMS,
+                                            isLocal ? localGroupSize : groupSize,
+                                            loopCount,
+                                            numberTrials,
+                                            printDebug);
+
+        const string name = Probe::testName(test);
+        if (0 == microsecs) {
+            cout << "\t" << name << ": fail";
+            continue;
+        }
+
+        if (Probe::MAD_THROUGHPUT == test) {
+            const size_t mflops = kernel.numberFlops() / microsecs;
+            cout << "\t" << name << ": " << (mflops / 1000.) << " GFLOPS";
+            profile.take(name + "MFLOPS" + typeName, mflops);
+            profile.takeMax(string("peakMFLOPS") + nameof<SCALAR>(), mflops);
+        } else {
+            const size_t bytes = isLocal ? kernel.bytesMovedLocal() : kernel.bytesMoved();
+            const size_t mbps = bytes / microsecs;
+            cout << "\t" << name << ": " << (mbps / 1000.) << " GB/s";
+            profile.take(name + "MBPS" + typeName, mbps);
+            if (Probe::GLOBAL_READ == test || Probe::GLOBAL_COPY == test)
+                profile.takeMax("peakMBPS", mbps);
+        }
+    }
+
+    cout << endl;
+}
+
+// empty kernel launch latency in nanoseconds
+void probeLaunch(OCLApp& oclApp,
+                 DeviceProfile& profile,
+                 const size_t numberTrials,
+                 const bool printDebug) {
+    KernelProbeDevice<float, 1> kernel;
+    Bench bench(oclApp, kernel, printDebug);
+
+    // many launches so the latency is not lost in timer resolution
+    const double microsecs = timeKernel(kernel, bench,
+                                        KernelProbeDevice<float, 1>::EMPTY_KERNEL,
+                                        1, 1, 0,
+                                        100 * numberTrials,
+                                        printDebug);
+    if (0 == microsecs) {
+        cout << "launch: fail" << endl;
+        return;
+    }
+
+    cout << "launch: " << microsecs << " usec" << endl;
+    profile.take("launchNanosec", static_cast<size_t>(1000 * microsecs));
+}
+
+// host to device and device to host transfer rates for increasing sizes,
+// records the largest rate and the smallest size reaching half of it
+void probeTransfers(OCLApp& oclApp,
+                    DeviceProfile& profile,
+                    const size_t numberTrials) {
+    const size_t MIN_BYTES = 4 * 1024;
+    const size_t MAX_BYTES = min(static_cast<size_t>(64 * 1024 * 1024), oclApp.maxMemAlloc());
+
+    const char *names[] = { "toDevice", "toDevicePinned", "fromDevice", "fromDevicePinned" };
+    vector<size_t> sizes;
+    vector< vector<size_t> > rates(4);
+
+    for (size_t bytes = MIN_BYTES; bytes <= MAX_BYTES; bytes *= 4) {
+        sizes.push_back(bytes);
+
+        // plain device buffer, unpinned transfers use its ordinary aligned
+        // host array
+        const int handle = oclApp.createPooledBuffer<float>(bytes / sizeof(float), OCLApp::READWRITE);
+
+        for (size_t pinned = 0; pinned < 2; pinned++) {
+
+            // pinned transfers use the mapped host memory of a staging buffer
+            int staging = -1;
+            void *hostPtr = NULL;
+            if (pinned && -1 != handle) {
+                staging = oclApp.createBuffer<float>(bytes / sizeof(float), OCLApp::READWRITE, true);
+                const int mapBuf = -1 != staging
+                                       ? oclApp.enqueueMapBuffer(staging, OCLApp::READWRITE)
+                                       : -1;
+                if (-1 != mapBuf && oclApp.wait(mapBuf))
+                    hostPtr = oclApp.mappedPtr(staging);
+            }
+
+            for (size_t fromDevice = 0; fromDevice < 2; fromDevice++) {
+                size_t mbps = 0;
+                struct timeval start_time, stop_time;
+                bool rc = -1 != handle && (!pinned || hostPtr) && -1 != gettimeofday(&start_time, 0);
+
+                // each transfer is waited on so small sizes show the latency
+                for (size_t i = 0; rc && i < numberTrials; i++) {
+                    int event;
+                    if (pinned)
+                        event = fromDevice
+                                    ? oclApp.enqueueReadBuffer(handle, hostPtr)
+                                    : oclApp.enqueueWriteBuffer(handle, hostPtr);
+                    else
+                        event = fromDevice
+                                    ? oclApp.enqueueReadBuffer(handle)
+                                    : oclApp.enqueueWriteBuffer(handle);
+                    rc = -1 != event && oclApp.wait(event);
+                }
+
+                if (rc && -1 != gettimeofday(&stop_time, 0)) {
+                    const size_t microsecs = 1000000 * (stop_time.tv_sec - start_time.tv_sec)
+                                           + stop_time.tv_usec - start_time.tv_usec;
+                    if (0 != microsecs) mbps = numberTrials * bytes / microsecs;
+                }
+
+                rates[2 * fromDevice + pinned].push_back(mbps);
+            }
+
+            if (hostPtr) {
+                const int unmapBuf = oclApp.enqueueUnmapBuffer(staging);
+                if (-1 != unmapBuf) oclApp.wait(unmapBuf);
+            }
+            if (-1 != staging) oclApp.releaseBuffer(staging);
+        }
+
+        if (-1 != handle) oclApp.releaseBuffer(handle);
+    }
+
+    cout << "bytes";
+    for (size_t j = 0; j < 4; j++) cout << "\t" << names[j];
+    cout << "\t(MB/s)" << endl;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        cout << sizes[i];
+        for (size_t j = 0; j < 4; j++) cout << "\t" << rates[j][i];
+        cout << endl;
+    }
+
+    for (size_t j = 0; j < 4; j++) {
+        size_t peak = 0;
+        for (size_t i = 0; i < sizes.size(); i++)
+            if (rates[j][i] > peak) peak = rates[j][i];
+        if (0 == peak) continue;
+
+        size_t halfBytes = 0;
+        for (size_t i = 0; i < sizes.size() && 0 == halfBytes; i++)
+            if (2 * rates[j][i] >= peak) halfBytes = sizes[i];
+
+        profile.take(string(names[j]) + "MBPS", peak);
+        profile.take(string(names[j]) + "HalfBytes", halfBytes);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    string device, journalFile;
+    bool useFloat = true, useDouble = true;
+    size_t numberTrials = 10;
+    bool printDebug = false;
+
+    if (! parseOpts(argc, argv, device, journalFile, useFloat, useDouble, numberTrials, printDebug))
+        exit(1);
+
+    OCLBase oclBase;
+    const int device_index = AppUtil::getDeviceIndex(oclBase, device);
+    if (-1 == device_index) {
+        cerr << "error: device " << device << " not found" << endl;
+        exit(1);
+    }
+    OCLApp oclApp(oclBase, device_index);
+
+    // results are device limits for the roofline report and search pruning
+    Journal journal(journalFile);
+    if (! journalFile.empty()) {
+        journal.loadMemo();
+        journal.setFingerprint(DeviceFingerprint(oclApp), false);
+    }
+    DeviceProfile profile(journalFile.empty() ? NULL : &journal);
+
+    cout << "device: " << DeviceFingerprint(oclApp).str() << endl;
+
+    probeLaunch(oclApp, profile, numberTrials, printDebug);
+
+    if (useFloat) {
+        probeType<float, 1>(oclApp, profile, numberTrials, printDebug);
+        probeType<float, 2>(oclApp, profile, numberTrials, printDebug);
+        probeType<float, 4>(oclApp, profile, numberTrials, printDebug);
+        probeType<float, 8>(oclApp, profile, numberTrials, printDebug);
+        probeType<float, 16>(oclApp, profile, numberTrials, printDebug);
+    }
+
+    // no preferred vector width means no double support
+    if (useDouble && 0 != oclApp.preferredVectorWidthDouble()) {
+        probeType<double, 1>(oclApp, profile, numberTrials, printDebug);
+        probeType<double, 2>(oclApp, profile, numberTrials, printDebug);
+        probeType<double, 4>(oclApp, profile, numberTrials, printDebug);
+        probeType<double, 8>(oclApp, profile, numberTrials, printDebug);
+        probeType<double, 16>(oclApp, profile, numberTrials, printDebug);
+    }
+
+    probeTransfers(oclApp, profile, numberTrials);
+
+    return 0;
+}
@@ -24,6 +24,7 @@
 #include <vector>
 #include <math.h>
 #include <stdlib.h>
+#include <getopt.h>
 #include <unistd.h>
 #include "GatlasAppUtil.hpp"
 #include "GatlasBenchmark.hpp"
@@ -58,21 +59,45 @@ bool parseOpts(int argc, char *argv[],
                bool& transposeA,
                bool& busTransferToDevice,
                bool& busTransferFromDevice,
+               bool& overlapTransfers,
                bool& paranoidCheck,
                bool& vectorAttributeHint,
-               bool& printDebug) {
+               bool& printDebug,
+               bool& replay,
+               string& fingerprint,
+               bool& exactDevice,
+               string& traceFile,
+               bool& latencyMode,
+               size_t& batchSize,
+               bool& searchBuildOptions,
+               bool& searchUnroll,
+               bool& searchOptimizeExpr,
+               bool& searchGroupSizeAttr) {
+    static const struct option longOpts[] = {
+        { "replay", no_argument, NULL, 'R' },
+        { "fingerprint", required_argument, NULL, 'F' },
+        { "exact-device", no_argument, NULL, 'X' },
+        { "trace", required_argument, NULL, 'P' },
+        { "latency", no_argument, NULL, 'L' },
+        { "batch", required_argument, NULL, 'B' },
+        { "build-options", no_argument, NULL, 'O' },
+        { "unroll", no_argument, NULL, 'U' },
+        { "optimize-expr", no_argument, NULL, 'E' },
+        { "group-size-attr", no_argument, NULL, 'A' },
+        { NULL, 0, NULL, 0 }
+    };
     int opt;
     string kernelType = "<unspecified>";
-    while ((opt = getopt(argc, argv, "heasrpvzGd:j:C:T:m:n:g:y:x:t:w:")) != -1) {
+    while ((opt = getopt_long(argc, argv, "heasroOUEARLpvzGd:j:C:T:m:n:g:y:x:t:w:XF:P:B:", longOpts, NULL)) != -1) {
         switch (opt) {
             case ('h') :
                 cerr << "usage: " << argv[0]
-                     << " -d cpu|gpu|acc|cpuX|gpuX|accX -j journalFile -T float1|float2|float4|double1|double2|double4|floatimg|doubleimg -n N [-m M]"
+                     << " -d cpu|gpu|acc|cpuX|gpuX|accX -j journalFile -T float1|float2|float4|float8|float16|double1|double2|double4|double8|floatimg|doubleimg -n N [-m M]"
                         " [-C numKernels]"
                         " [-g groupSize [-y blockHeight [-x extraParam]]]"
                         " [-t numberTrials]"
                         " [-w topN]"
-                        " [-G] [-e] [-a] [-s] [-r] [-p] [-v] [-z] [-h]" << endl
+                        " [-G] [-e] [-a] [-s] [-r] [-o] [-R [-F fingerprint]] [-X] [-P traceFile] [-L] [-B batchSize] [-O] [-U] [-E] [-A] [-p] [-v] [-z] [-h]" << endl
                      << "\t-d cpu, gpu or accelerator device, optional X is the device number" << endl
                      << "\t-j journal file" << endl
                      << "\t-C number of coalesced kernels (default is 1)" << endl
@@ -89,6 +114,17 @@ bool parseOpts(int argc, char *argv[],
                      << "\t-a transpose A (default no)" << endl
                      << "\t-s include PCIe bus data transfer to device in timing (default no)" << endl
                      << "\t-r include PCIe bus data transfer from device in timing (default no)" << endl
+                     << "\t-o overlap PCIe bus data transfers with kernels on separate queues (default no)" << endl
+                     << "\t-R, --replay only use times in the journal, never touch the device (default no)" << endl
+                     << "\t-F, --fingerprint device records to replay from a merged journal" << endl
+                     << "\t-X, --exact-device never use records from a similar device (default no)" << endl
+                     << "\t-P, --trace write Chrome trace events of the session to this file (default no)" << endl
+                     << "\t-L, --latency p50/p99 latency per call for sizes from 64 up to M with M = N, 100 calls per trial (default no)" << endl
+                     << "\t-B, --batch compile this many kernels together in one program (default is 1)" << endl
+                     << "\t-O, --build-options also search OpenCL compiler options, requires -p (default no)" << endl
+                     << "\t-U, --unroll also search loop unrolling, four times as many kernels (default no)" << endl
+                     << "\t-E, --optimize-expr also search folded and hoisted expressions, twice as many kernels (default no)" << endl
+                     << "\t-A, --group-size-attr also search work group size attributes, three times as many kernels (default no)" << endl
                      << "\t-p paranoid output matrix check (default no)" << endl
                      << "\t-v disable kernel vector attribute hint (default enabled)" << endl
                      << "\t-z print matrix output (default no)" << endl
@@ -111,6 +147,17 @@ bool parseOpts(int argc, char *argv[],
             case ('a') : transposeA = true; break;
             case ('s') : busTransferToDevice = true; break;
             case ('r') : busTransferFromDevice = true; break;
+            case ('o') : overlapTransfers = true; break;
+            case ('R') : replay = true; break;
+            case ('F') : fingerprint = optarg; break;
+            case ('X') : exactDevice = true; break;
+            case ('P') : traceFile = optarg; break;
+            case ('L') : latencyMode = true; break;
+            case ('B') : batchSize = atoi(optarg); break;
+            case ('O') : searchBuildOptions = true; break;
+            case ('U') : searchUnroll = true; break;
+            case ('E') : searchOptimizeExpr = true; break;
+            case ('A') : searchGroupSizeAttr = true; break;
             case ('p') : paranoidCheck = true; break;
             case ('v') : vectorAttributeHint = false; break;
             case ('z') : printDebug = true; break;
@@ -119,7 +166,7 @@ bool parseOpts(int argc, char *argv[],
 
     // minimal validation of options
     bool rc = true;
-    if (0 != device.find("cpu") && 0 != device.find("gpu") & 0 != device.find("acc")) {
+    if (!replay && 0 != device.find("cpu") && 0 != device.find("gpu") & 0 != device.find("acc")) {
         cerr << "error: invalid device " << device << endl;
         rc = false;
     }
@@ -127,6 +174,22 @@ bool parseOpts(int argc, char *argv[],
         cerr << "error: journal file must be specified" << endl;
         rc = false;
     }
+    if (latencyMode && replay) {
+        cerr << "error: latency is measured on the device and can not be replayed" << endl;
+        rc = false;
+    }
+    if (overlapTransfers && !busTransferToDevice && !busTransferFromDevice) {
+        cerr << "error: overlapped transfers require PCIe bus data transfer in timing" << endl;
+        rc = false;
+    }
+    if (searchBuildOptions && !paranoidCheck) {
+        cerr << "error: build options may trade accuracy for speed, searching them requires paranoid check" << endl;
+        rc = false;
+    }
+    if (0 == batchSize) {
+        cerr << "error: batch size must be at least one" << endl;
+        rc = false;
+    }
     if (0 == packedKernels) {
         cerr << "error: number of kernels to coalesce must be at least one" << endl;
         rc = false;
@@ -138,12 +201,18 @@ bool parseOpts(int argc, char *argv[],
         useMembufs = true; useImages = false; useFloat = true; useDouble = false; vectorLength = 2; maxBlockHeight = 64; maxGroupSize = 256;
     } else if ("float4" == kernelType) {
         useMembufs = true; useImages = false; useFloat = true; useDouble = false; vectorLength = 4; maxBlockHeight = 64; maxGroupSize = 256;
+    } else if ("float8" == kernelType) {
+        useMembufs = true; useImages = false; useFloat = true; useDouble = false; vectorLength = 8; maxBlockHeight = 64; maxGroupSize = 256;
+    } else if ("float16" == kernelType) {
+        useMembufs = true; useImages = false; useFloat = true; useDouble = false; vectorLength = 16; maxBlockHeight = 64; maxGroupSize = 256;
     } else if ("double1" == kernelType) {
         useMembufs = true; useImages = false; useFloat = false; useDouble = true; vectorLength = 1; maxBlockHeight = 64; maxGroupSize = 256;
     } else if ("double2" == kernelType) {
         useMembufs = true; useImages = false; useFloat = false; useDouble = true; vectorLength = 2; maxBlockHeight = 64; maxGroupSize = 256;
     } else if ("double4" == kernelType) {
         useMembufs = true; useImages = false; useFloat = false; useDouble = true; vectorLength = 4; maxBlockHeight = 64; maxGroupSize = 256;
+    } else if ("double8" == kernelType) {
+        useMembufs = true; useImages = false; useFloat = false; useDouble = true; vectorLength = 8; maxBlockHeight = 64; maxGroupSize = 256;
     } else if ("floatimg" == kernelType) {
         useMembufs = false; useImages = true; useFloat = true; useDouble = false; vectorLength = 4; maxBlockHeight = 64; maxGroupSize = 256;
     } else if ("doubleimg" == kernelType) {
@@ -199,7 +268,7 @@ bool parseOpts(int argc, char *argv[],
     return rc;
 }
 
-vector< vector<size_t> > getParams(OCLApp& oclApp,
+vector< vector<size_t> > getParams(const size_t maxWorkGroupSize,
                                    KernelBaseMatvec & kernel,
                                    const size_t vectorLength,
                                    const size_t maxBlockHeight,
@@ -243,7 +312,7 @@ vector< vector<size_t> > getParams(OCLApp& oclApp,
         // work group size is free, inner blocking and extra parameter may be specified
         } else {
             // maximum value of group size
-            const size_t largestPossibleGroupSize = oclApp.maxWorkGroupSize();
+            const size_t largestPossibleGroupSize = maxWorkGroupSize;
             const size_t largestGroupSize = maxGroupSize < largestPossibleGroupSize
                                                 ? maxGroupSize
                                                 : largestPossibleGroupSize;
@@ -308,12 +377,14 @@ size_t mainLoop(KernelInterface& kernel,
     vector<size_t> pargsFlops;
     vector<double> pargsVariance;
     vector< vector<size_t> > pargsExtraDetail;
+    vector<AppUtil::KernelTraffic> pargsTraffic;
 
     for (size_t i = 0; i < pargs.size(); i++) {
         pargsTime.push_back(0);
         pargsFlops.push_back(0);
         pargsVariance.push_back(0);
         pargsExtraDetail.push_back(vector<size_t>());
+        pargsTraffic.push_back(AppUtil::KernelTraffic());
     }
 
     // paranoid check
@@ -335,6 +406,7 @@ size_t mainLoop(KernelInterface& kernel,
                                              pargsAverage,
                                              pargsVariance,
                                              pargsExtraDetail,
+                                             pargsTraffic,
                                              busTransferToDevice,
                                              busTransferFromDevice,
                                              dummyRun,
@@ -346,12 +418,15 @@ size_t mainLoop(KernelInterface& kernel,
     }
 
     AppUtil::printBench(numberTrials,
+                        kernel,
+                        journal,
                         pargs,
                         pargsOk,
                         pargsTime,
                         pargsAverage,
                         pargsVariance,
-                        pargsExtraDetail);
+                        pargsExtraDetail,
+                        pargsTraffic);
 
     return goodKernelCount;
 }
@@ -406,9 +481,20 @@ int main(int argc, char *argv[])
     bool emOptimization = false;
     bool transposeA = false;
     bool busTransferToDevice = false, busTransferFromDevice = false;
+    bool overlapTransfers = false;
     bool paranoidCheck = false;
     bool vectorAttributeHint = true;
     bool printDebug = false;
+    bool replay = false;
+    string fingerprint;
+    bool exactDevice = false;
+    string traceFile;
+    bool latencyMode = false;
+    size_t batchSize = 1;
+    bool searchBuildOptions = false;
+    bool searchUnroll = false;
+    bool searchOptimizeExpr = false;
+    bool searchGroupSizeAttr = false;
 
     if (!parseOpts(argc, argv,
                    device,
@@ -429,25 +515,47 @@ int main(int argc, char *argv[])
                    emOptimization,
                    transposeA,
                    busTransferToDevice, busTransferFromDevice,
+                   overlapTransfers,
                    paranoidCheck,
                    vectorAttributeHint,
-                   printDebug)) {
+                   printDebug,
+                   replay,
+                   fingerprint,
+                   exactDevice,
+                   traceFile,
+                   latencyMode,
+                   batchSize,
+                   searchBuildOptions,
+                   searchUnroll,
+                   searchOptimizeExpr,
+                   searchGroupSizeAttr)) {
         cerr << "***DONE***" << endl; // needed for wrapper retry script
         exit(1);
     }
 
-    // initialize OpenCL
-    OCLBase oclBase;
-    const size_t device_index = AppUtil::getDeviceIndex(oclBase, device);
-    OCLApp oclApp(oclBase, device_index);
+    // trace file and phase summary are written at exit
+    if (! traceFile.empty()) OCLTrace::enable(traceFile);
+
+    // initialize OpenCL, replaying the journal never touches a device
+    OCLBase *oclBase = NULL;
+    OCLApp *oclApp = NULL;
+    if (! replay) {
+        oclBase = new OCLBase;
+        const size_t device_index = AppUtil::getDeviceIndex(*oclBase, device);
+        // overlapped transfers use a compute queue and two copy queues
+        oclApp = new OCLApp(*oclBase, device_index, overlapTransfers ? 3 : 1);
+    }
 
     // kernel generator
     KernelMatvecBuffer < float, 1 > kernel_buf_sp_1;
     KernelMatvecBuffer < float, 2 > kernel_buf_sp_2;
     KernelMatvecBuffer < float, 4 > kernel_buf_sp_4;
+    KernelMatvecBuffer < float, 8 > kernel_buf_sp_8;
+    KernelMatvecBuffer < float, 16 > kernel_buf_sp_16;
     KernelMatvecBuffer < double, 1 > kernel_buf_dp_1;
     KernelMatvecBuffer < double, 2 > kernel_buf_dp_2;
     KernelMatvecBuffer < double, 4 > kernel_buf_dp_4;
+    KernelMatvecBuffer < double, 8 > kernel_buf_dp_8;
     KernelMatvecImage < float, 4 > kernel_img_sp_4;
     KernelMatvecImage < double, 2 > kernel_img_dp_2;
     KernelBaseMatvec *ptrKernel = NULL;
@@ -456,11 +564,14 @@ int main(int argc, char *argv[])
             if (1 == vectorLength) ptrKernel = &kernel_buf_sp_1;
             if (2 == vectorLength) ptrKernel = &kernel_buf_sp_2;
             if (4 == vectorLength) ptrKernel = &kernel_buf_sp_4;
+            if (8 == vectorLength) ptrKernel = &kernel_buf_sp_8;
+            if (16 == vectorLength) ptrKernel = &kernel_buf_sp_16;
         }
         if (useDouble) {
             if (1 == vectorLength) ptrKernel = &kernel_buf_dp_1;
             if (2 == vectorLength) ptrKernel = &kernel_buf_dp_2;
             if (4 == vectorLength) ptrKernel = &kernel_buf_dp_4;
+            if (8 == vectorLength) ptrKernel = &kernel_buf_dp_8;
         }
     }
     if (useImages) {
@@ -472,17 +583,85 @@ int main(int argc, char *argv[])
     // journal and benchmark object
     Journal journal(journalFile);
     Bench bench(oclApp, kernel, journal);
+    bench.overlapTransfers(overlapTransfers);
+    bench.batchSize(batchSize);
+
+    // merged journals have records from many devices
+    if (! AppUtil::selectDevice(oclApp, journal, fingerprint, exactDevice)) {
+        cerr << "***DONE***" << endl; // needed for wrapper retry script
+        exit(1);
+    }
+
+    // device limits are recorded in the journal for replay
+    const int maxWorkGroupSize = AppUtil::maxWorkGroupSize(oclApp, journal);
+    if (-1 == maxWorkGroupSize) {
+        cerr << "error: journal has no device limits to replay" << endl
+             << "***DONE***" << endl; // needed for wrapper retry script
+        exit(1);
+    }
+
+    // device peaks for the roofline report
+    AppUtil::peakGFLOPS(oclApp, journal, useDouble);
+    AppUtil::peakBandwidth(oclApp, journal);
 
     // kernel vector attribute hint?
     kernel.setUseAttrAutoVec(vectorAttributeHint);
 
+    // compiler options are another extra parameter dimension
+    kernel.setSearchBuildOptions(searchBuildOptions);
+
+    // loop unrolling multiplies the extra parameter space, only if asked
+    kernel.setSearchUnroll(searchUnroll);
+
+    // folded and hoisted expressions double the extra parameter space
+    kernel.setSearchOptimizeExpr(searchOptimizeExpr);
+
+    // work group size attributes triple the extra parameter space
+    kernel.setSearchGroupSizeAttr(searchGroupSizeAttr);
+
     // packed kernel support
     kernel.setPackedCalc(packedKernels);
 
+    // small problem latency instead of throughput
+    if (latencyMode) {
+        vector<size_t> sizes;
+        vector< vector< vector<size_t> > > pargsBySize;
+        for (size_t dim = 64; dim <= M; dim *= 2) {
+            sizes.push_back(dim);
+            pargsBySize.push_back(getParams(maxWorkGroupSize,
+                                            kernel,
+                                            vectorLength,
+                                            maxBlockHeight,
+                                            maxGroupSize,
+                                            useGEMM,
+                                            dim, dim,
+                                            transposeA,
+                                            groupSize, blockHeight, extraParam));
+        }
+
+        AppUtil::latencySweep(kernel,
+                              bench,
+                              journal,
+                              sizes,
+                              pargsBySize,
+                              100 * numberTrials,
+                              busTransferToDevice,
+                              busTransferFromDevice,
+                              printDebug,
+                              paranoidCheck);
+
+        delete oclApp;
+        delete oclBase;
+
+        // useful for parent process manager to know not to respawn process
+        cout << "***DONE***" << endl;
+        return 0;
+    }
+
     // not using EM
     if (! emOptimization) {
         // brute force benchmark timings
-        vector< vector<size_t> > pargs = getParams(oclApp,
+        vector< vector<size_t> > pargs = getParams(maxWorkGroupSize,
                                                    kernel,
                                                    vectorLength,
                                                    maxBlockHeight,
@@ -499,7 +678,7 @@ int main(int argc, char *argv[])
             pargsAverage.push_back(0);
         }
 
-        journal.loadMemo();
+        journal.refreshMemo(); // other processes may share the journal
         mainLoop(kernel,
                  bench,
                  journal,
@@ -513,6 +692,10 @@ int main(int argc, char *argv[])
                  printDebug,
                  paranoidCheck);
 
+        AppUtil::printMissing(bench);
+        delete oclApp;
+        delete oclBase;
+
         // useful for parent process manager to know not to respawn process
         cout << "***DONE***" << endl;
         return 0;
@@ -537,7 +720,7 @@ int main(int argc, char *argv[])
                 blockHeight = (0 == emStep) ? -1 : bestBlockHeight;
                 extraParam  = (0 == emStep) ? bestExtraParam : -1;
 
-                pargs = getParams(oclApp,
+                pargs = getParams(maxWorkGroupSize,
                                   kernel,
                                   vectorLength,
                                   maxBlockHeight,
@@ -554,7 +737,7 @@ int main(int argc, char *argv[])
                     pargsAverage.push_back(0);
                 }
 
-                journal.loadMemo();
+                journal.refreshMemo();
                 mainLoop(kernel,
                          bench,
                          journal,
@@ -578,6 +761,7 @@ int main(int argc, char *argv[])
                         bestExtraParam = (bestExtraParam + 1) % kernel.totalVariations();
                         // infinite loop case if there are no kernels at all
                         if (kernel.totalVariations() == loopCount++) {
+                            AppUtil::printMissing(bench);
                             cerr << "error: no good kernels found so giving up" << endl
                                  << "***DONE***" << endl;
                             exit(1);
@@ -585,6 +769,7 @@ int main(int argc, char *argv[])
                         continue;
                     } else {
                         // if this happens during maximization, then just give up
+                        AppUtil::printMissing(bench);
                         cerr << "error: no good kernels found for group size " << bestGroupSize
                              << " and block height " << bestBlockHeight
                              << " so giving up" << endl
@@ -613,7 +798,7 @@ int main(int argc, char *argv[])
 
     // if more than one trial is specified, a final average
     if (numberTrials > 1) {
-        pargs = getParams(oclApp,
+        pargs = getParams(maxWorkGroupSize,
                           kernel,
                           vectorLength,
                           maxBlockHeight,
@@ -634,6 +819,10 @@ int main(int argc, char *argv[])
                  paranoidCheck);
     }
 
+    AppUtil::printMissing(bench);
+    delete oclApp;
+    delete oclBase;
+
     // useful for parent process manager to know not to respawn process
     cout << "***DONE***" << endl;
 
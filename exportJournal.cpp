@@ -0,0 +1,455 @@
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "GatlasBenchmark.hpp"
+
+#include "KernelMatmulBuffer.hpp"
+#include "KernelMatmulImage.hpp"
+#include "KernelMatvecBuffer.hpp"
+#include "KernelMatvecImage.hpp"
+#include "KernelSaxpyBuffer.hpp"
+#include "KernelSaxpyImage.hpp"
+
+#include "using_namespace"
+
+using namespace std;
+
+// one column of values in native byte order, no header so the file may be
+// memory mapped as an array, names and types are in the .columns file
+class ColumnFile
+{
+    static const size_t BUFFER_SIZE = 1 << 16;
+
+    const string _name;
+    const string _type;
+    ofstream     _file;
+    size_t       _rows;
+
+    // stream writes of a few bytes at a time are too slow
+    vector<char> _buffer;
+
+public:
+    ColumnFile(const string& prefix, const string& name, const string& type)
+        : _name(name),
+          _type(type),
+          _file((prefix + "." + name + ".col").c_str(), ios::binary),
+          _rows(0)
+    {
+        _buffer.reserve(BUFFER_SIZE);
+    }
+
+    ~ColumnFile() { flush(); }
+
+    bool good() const { return _file.good(); }
+
+    void flush() {
+        if (! _buffer.empty()) _file.write(&_buffer[0], _buffer.size());
+        _buffer.clear();
+    }
+
+    template <typename T> void put(const T value) {
+        const char *ptr = reinterpret_cast<const char*>(&value);
+        _buffer.insert(_buffer.end(), ptr, ptr + sizeof(T));
+        if (_buffer.size() + sizeof(T) > BUFFER_SIZE) flush();
+        _rows++;
+    }
+
+    ostream& manifest(ostream& os) const {
+        return os << _name << "\t" << _type << "\t" << _rows << endl;
+    }
+};
+
+// kernel records only, returns false for device limits and stats
+// (parsed by hand as stringstream is too slow for journals with millions of records)
+bool splitKey(const string& key,
+              string& device,
+              string& kernelName,
+              vector<size_t>& params) {
+    size_t begin = key.find('/');
+    if (string::npos == begin) {
+        device.clear();
+        begin = 0;
+    } else {
+        device.assign(key, 0, begin);
+        begin++;
+    }
+
+    if (0 == key.compare(begin, 7, "device_") || 0 == key.compare(begin, 6, "stats_") ||
+        0 == key.compare(begin, 7, "source_") || 0 == key.compare(begin, 6, "alias_")) return false;
+
+    // key is kernelName_p0_p1_..._
+    const size_t pos = key.find('_', begin);
+    if (string::npos == pos) return false;
+    kernelName.assign(key, begin, pos - begin);
+
+    params.clear();
+    const char *ptr = key.c_str() + pos + 1;
+    char *end;
+    while ('\0' != *ptr) {
+        params.push_back(strtoul(ptr, &end, 10));
+        if (end == ptr || '_' != *end) break;
+        ptr = end + 1;
+    }
+
+    return true;
+}
+
+// alias records name a kernel with the same source as the kernel whose
+// records it shares, both are returned as kernel record keys
+bool splitAlias(const string& line,
+                const size_t keyEnd,
+                string& aliasKey,
+                string& targetKey) {
+    const size_t slash = line.find('/');
+    const size_t begin = string::npos == slash || slash > keyEnd ? 0 : slash + 1;
+    if (0 != line.compare(begin, 6, "alias_")) return false;
+
+    size_t first = keyEnd;
+    while (first < line.size() && (' ' == line[first] || '\t' == line[first])) first++;
+    size_t last = first;
+    while (last < line.size() && ' ' != line[last] && '\t' != line[last]) last++;
+    if (first == last) return false;
+
+    aliasKey.assign(line, 0, begin);
+    targetKey = aliasKey;
+    aliasKey.append(line, begin + 6, keyEnd - begin - 6);
+    targetKey.append(line, first, last - first);
+    return true;
+}
+
+// end of the key, npos if the line is not a record
+size_t keyLength(const string& line) {
+    for (size_t i = 0; i < line.size(); i++)
+        if (' ' == line[i] || '\t' == line[i])
+            return i;
+    return string::npos;
+}
+
+// record value follows the key, false if there is none
+bool splitValue(const string& line, const size_t keyEnd, int& value) {
+    const char *ptr = line.c_str() + keyEnd;
+    char *end;
+    value = strtol(ptr, &end, 10);
+    return end != ptr;
+}
+
+// kernel columns of a row, an alias repeats every record of its target
+struct KernelRow
+{
+    string         kernelName;
+    int32_t        kernel32;
+    vector<size_t> params;
+    vector<size_t> extra;
+    size_t         numberFlops;
+    int32_t        aliasOf;
+
+    KernelRow(map<string, KernelInterface*>& kernels,
+              map<string, int32_t>& kernelCode,
+              const string& name,
+              const vector<size_t>& kernelParams,
+              const int32_t aliasOfCode)
+        : kernelName(name),
+          kernel32(kernelCode[name]),
+          params(kernelParams),
+          numberFlops(0),
+          aliasOf(aliasOfCode)
+    {
+        if (kernels.count(name)) {
+            KernelInterface& kernel = *kernels[name];
+            kernel.setParams(params);
+            extra = kernel.extraParamDetail();
+            numberFlops = kernel.numberFlops();
+        }
+    }
+};
+
+bool parseOpts(int argc, char *argv[], string& journalFile, string& outPrefix, bool& writeCSV) {
+    int opt;
+    while ((opt = getopt(argc, argv, "hcj:o:")) != -1) {
+        switch (opt) {
+            case ('h') :
+                cerr << "usage: " << argv[0]
+                     << " -j journalFile -o outPrefix"
+                        " [-c] [-h]" << endl
+                     << "\t-j journal file" << endl
+                     << "\t-o prefix of output files (outPrefix.columns, outPrefix.NAME.col, outPrefix.NAME.dict)" << endl
+                     << "\t-c also write outPrefix.csv (default no)" << endl
+                     << "\t-h help" << endl;
+                exit(1);
+            case ('j') : journalFile = optarg; break;
+            case ('o') : outPrefix = optarg; break;
+            case ('c') : writeCSV = true; break;
+        }
+    }
+    // minimal validation of options
+    bool rc = true;
+    if (journalFile.empty()) {
+        cerr << "error: journal file must be specified" << endl;
+        rc = false;
+    }
+    if (outPrefix.empty()) {
+        cerr << "error: output prefix must be specified" << endl;
+        rc = false;
+    }
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    string journalFile, outPrefix;
+    bool writeCSV = false;
+
+    if (!parseOpts(argc, argv, journalFile, outPrefix, writeCSV))
+        exit(1);
+
+    // kernels decode extra parameters and count flops
+    KernelMatmulBuffer < float, 1 > matmul_buf_sp_1;
+    KernelMatmulBuffer < float, 2 > matmul_buf_sp_2;
+    KernelMatmulBuffer < float, 4 > matmul_buf_sp_4;
+    KernelMatmulBuffer < float, 8 > matmul_buf_sp_8;
+    KernelMatmulBuffer < float, 16 > matmul_buf_sp_16;
+    KernelMatmulBuffer < double, 1 > matmul_buf_dp_1;
+    KernelMatmulBuffer < double, 2 > matmul_buf_dp_2;
+    KernelMatmulBuffer < double, 4 > matmul_buf_dp_4;
+    KernelMatmulBuffer < double, 8 > matmul_buf_dp_8;
+    KernelMatmulImage < float, 4 > matmul_img_sp_4;
+    KernelMatmulImage < double, 2 > matmul_img_dp_2;
+    KernelMatvecBuffer < float, 1 > matvec_buf_sp_1;
+    KernelMatvecBuffer < float, 2 > matvec_buf_sp_2;
+    KernelMatvecBuffer < float, 4 > matvec_buf_sp_4;
+    KernelMatvecBuffer < float, 8 > matvec_buf_sp_8;
+    KernelMatvecBuffer < float, 16 > matvec_buf_sp_16;
+    KernelMatvecBuffer < double, 1 > matvec_buf_dp_1;
+    KernelMatvecBuffer < double, 2 > matvec_buf_dp_2;
+    KernelMatvecBuffer < double, 4 > matvec_buf_dp_4;
+    KernelMatvecBuffer < double, 8 > matvec_buf_dp_8;
+    KernelMatvecImage < float, 4 > matvec_img_sp_4;
+    KernelMatvecImage < double, 2 > matvec_img_dp_2;
+    KernelSaxpyBuffer < float, 1 > saxpy_buf_sp_1;
+    KernelSaxpyBuffer < float, 2 > saxpy_buf_sp_2;
+    KernelSaxpyBuffer < float, 4 > saxpy_buf_sp_4;
+    KernelSaxpyBuffer < float, 8 > saxpy_buf_sp_8;
+    KernelSaxpyBuffer < float, 16 > saxpy_buf_sp_16;
+    KernelSaxpyBuffer < double, 1 > saxpy_buf_dp_1;
+    KernelSaxpyBuffer < double, 2 > saxpy_buf_dp_2;
+    KernelSaxpyBuffer < double, 4 > saxpy_buf_dp_4;
+    KernelSaxpyBuffer < double, 8 > saxpy_buf_dp_8;
+    KernelSaxpyImage < float, 4 > saxpy_img_sp_4;
+    KernelSaxpyImage < double, 2 > saxpy_img_dp_2;
+    KernelInterface* kernelList[] = {
+        &matmul_buf_sp_1, &matmul_buf_sp_2, &matmul_buf_sp_4, &matmul_buf_sp_8, &matmul_buf_sp_16,
+        &matmul_buf_dp_1, &matmul_buf_dp_2, &matmul_buf_dp_4, &matmul_buf_dp_8,
+        &matmul_img_sp_4, &matmul_img_dp_2,
+        &matvec_buf_sp_1, &matvec_buf_sp_2, &matvec_buf_sp_4, &matvec_buf_sp_8, &matvec_buf_sp_16,
+        &matvec_buf_dp_1, &matvec_buf_dp_2, &matvec_buf_dp_4, &matvec_buf_dp_8,
+        &matvec_img_sp_4, &matvec_img_dp_2,
+        &saxpy_buf_sp_1, &saxpy_buf_sp_2, &saxpy_buf_sp_4, &saxpy_buf_sp_8, &saxpy_buf_sp_16,
+        &saxpy_buf_dp_1, &saxpy_buf_dp_2, &saxpy_buf_dp_4, &saxpy_buf_dp_8,
+        &saxpy_img_sp_4, &saxpy_img_dp_2 };
+    map<string, KernelInterface*> kernels;
+    for (size_t i = 0; i < sizeof(kernelList) / sizeof(KernelInterface*); i++)
+        kernels[kernelList[i]->kernelName()] = kernelList[i];
+
+    // first pass finds the number of columns and the string dictionaries,
+    // the second writes rows as they are read so memory use is constant
+    ifstream journal(journalFile.c_str());
+    if (! journal.is_open()) {
+        cerr << "error: could not load journal file " << journalFile << endl;
+        exit(1);
+    }
+
+    map<string, int32_t> deviceCode, kernelCode, aliasOfCode;
+    vector<string> deviceDict, kernelDict, aliasOfDict;
+    size_t numberParams = 0, numberExtra = 0;
+
+    // aliases are exported with the time records of the kernel they share
+    map< string, vector<string> > aliases;
+
+    string line, key, device, kernelName, aliasKey, targetKey;
+    vector<size_t> params;
+    bool isKernel = false;
+    while (getline(journal, line)) {
+        // consecutive records usually have the same key
+        const size_t keyEnd = keyLength(line);
+        if (string::npos == keyEnd || 0 == keyEnd) continue;
+        if (0 == line.compare(0, keyEnd, key)) continue;
+        key.assign(line, 0, keyEnd);
+        if (splitAlias(line, keyEnd, aliasKey, targetKey)) {
+            aliases[targetKey].push_back(aliasKey);
+            if (0 == aliasOfCode.count(targetKey)) {
+                aliasOfCode[targetKey] = aliasOfDict.size();
+                aliasOfDict.push_back(targetKey);
+            }
+            if (! (isKernel = splitKey(aliasKey, device, kernelName, params))) continue;
+        }
+        else if (! (isKernel = splitKey(key, device, kernelName, params))) continue;
+
+        if (0 == deviceCode.count(device)) {
+            deviceCode[device] = deviceDict.size();
+            deviceDict.push_back(device);
+        }
+        if (0 == kernelCode.count(kernelName)) {
+            kernelCode[kernelName] = kernelDict.size();
+            kernelDict.push_back(kernelName);
+
+            if (kernels.count(kernelName)) {
+                kernels[kernelName]->setParams(params);
+                const size_t n = kernels[kernelName]->extraParamDetail().size();
+                if (n > numberExtra) numberExtra = n;
+            }
+        }
+        if (params.size() > numberParams) numberParams = params.size();
+    }
+
+    vector<ColumnFile*> columns;
+    columns.push_back(new ColumnFile(outPrefix, "device", "int32"));
+    columns.push_back(new ColumnFile(outPrefix, "kernel", "int32"));
+    for (size_t i = 0; i < numberParams; i++) {
+        stringstream ss;
+        ss << "p" << i;
+        columns.push_back(new ColumnFile(outPrefix, ss.str(), "int64"));
+    }
+    for (size_t i = 0; i < numberExtra; i++) {
+        stringstream ss;
+        ss << "x" << i;
+        columns.push_back(new ColumnFile(outPrefix, ss.str(), "int64"));
+    }
+    columns.push_back(new ColumnFile(outPrefix, "state", "int32"));
+    columns.push_back(new ColumnFile(outPrefix, "time", "int64"));
+    columns.push_back(new ColumnFile(outPrefix, "gflops", "float64"));
+    columns.push_back(new ColumnFile(outPrefix, "alias_of", "int32"));
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (! columns[i]->good()) {
+            cerr << "error: could not write column files with prefix " << outPrefix << endl;
+            exit(1);
+        }
+    }
+
+    ofstream csv;
+    if (writeCSV) {
+        csv.open((outPrefix + ".csv").c_str());
+        csv << "device,kernel";
+        for (size_t i = 0; i < numberParams; i++) csv << ",p" << i;
+        for (size_t i = 0; i < numberExtra; i++) csv << ",x" << i;
+        csv << ",state,time,gflops,alias_of" << endl;
+    }
+
+    journal.clear();
+    journal.seekg(0);
+
+    key.clear();
+    vector<KernelRow> rowsOfKey;
+    int32_t device32 = 0;
+
+    size_t rows = 0;
+    int value;
+    while (getline(journal, line)) {
+        const size_t keyEnd = keyLength(line);
+        if (string::npos == keyEnd || 0 == keyEnd) continue;
+        if (0 != line.compare(0, keyEnd, key)) {
+            key.assign(line, 0, keyEnd);
+            if (! (isKernel = splitKey(key, device, kernelName, params))) continue;
+
+            // the kernel itself, then every alias of it
+            device32 = deviceCode[device];
+            rowsOfKey.assign(1, KernelRow(kernels, kernelCode, kernelName, params, -1));
+            const map< string, vector<string> >::const_iterator same = aliases.find(key);
+            if (aliases.end() != same) {
+                const vector<string>& aliasKeys = (*same).second;
+                for (size_t i = 0; i < aliasKeys.size(); i++) {
+                    string aliasDevice, aliasName;
+                    vector<size_t> aliasParams;
+                    splitKey(aliasKeys[i], aliasDevice, aliasName, aliasParams);
+                    rowsOfKey.push_back(KernelRow(kernels, kernelCode, aliasName, aliasParams, aliasOfCode[key]));
+                }
+            }
+        }
+        if (! isKernel || ! splitValue(line, keyEnd, value)) continue;
+
+        // time samples are only recorded for kernels that ran ok
+        const int32_t state = value < 0 ? value : Journal::RUN_OK;
+        const int64_t microsecs = value < 0 ? -1 : value;
+
+        for (size_t r = 0; r < rowsOfKey.size(); r++) {
+            const KernelRow& row = rowsOfKey[r];
+            const double gflops = microsecs > 0 ? static_cast<double>(row.numberFlops) / microsecs / 1000 : 0;
+
+            size_t index = 0;
+            columns[index++]->put<int32_t>(device32);
+            columns[index++]->put<int32_t>(row.kernel32);
+            for (size_t i = 0; i < numberParams; i++)
+                columns[index++]->put<int64_t>(i < row.params.size() ? row.params[i] : -1);
+            for (size_t i = 0; i < numberExtra; i++)
+                columns[index++]->put<int64_t>(i < row.extra.size() ? row.extra[i] : -1);
+            columns[index++]->put<int32_t>(state);
+            columns[index++]->put<int64_t>(microsecs);
+            columns[index++]->put<double>(gflops);
+            columns[index++]->put<int32_t>(row.aliasOf);
+
+            if (writeCSV) {
+                csv << "\"" << device << "\",\"" << row.kernelName << "\"";
+                for (size_t i = 0; i < numberParams; i++) {
+                    csv << ",";
+                    if (i < row.params.size()) csv << row.params[i];
+                }
+                for (size_t i = 0; i < numberExtra; i++) {
+                    csv << ",";
+                    if (i < row.extra.size()) csv << row.extra[i];
+                }
+                csv << "," << state << ",";
+                if (microsecs >= 0) csv << microsecs;
+                csv << "," << gflops << ",";
+                if (row.aliasOf >= 0) csv << "\"" << aliasOfDict[row.aliasOf] << "\"";
+                csv << "\n";
+            }
+
+            rows++;
+        }
+    }
+
+    // column names, types and row counts
+    ofstream manifest((outPrefix + ".columns").c_str());
+    for (size_t i = 0; i < columns.size(); i++) {
+        columns[i]->manifest(manifest);
+        delete columns[i];
+    }
+
+    // device fingerprint and kernel name columns are dictionary codes
+    ofstream deviceFile((outPrefix + ".device.dict").c_str());
+    for (size_t i = 0; i < deviceDict.size(); i++)
+        deviceFile << deviceDict[i] << endl;
+    ofstream kernelFile((outPrefix + ".kernel.dict").c_str());
+    for (size_t i = 0; i < kernelDict.size(); i++)
+        kernelFile << kernelDict[i] << endl;
+    ofstream aliasOfFile((outPrefix + ".alias_of.dict").c_str());
+    for (size_t i = 0; i < aliasOfDict.size(); i++)
+        aliasOfFile << aliasOfDict[i] << endl;
+
+    cout << "journal file " << journalFile
+         << " exported " << rows << " rows, "
+         << (numberParams + numberExtra + 6) << " columns"
+         << endl;
+
+    return 0;
+}
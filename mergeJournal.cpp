@@ -0,0 +1,101 @@
+//    Copyright 2010 Chris Jang
+//
+//    This file is part of GATLAS.
+//
+//    GATLAS is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Lesser General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    GATLAS is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Lesser General Public License for more details.
+//
+//    You should have received a copy of the GNU Lesser General Public License
+//    along with GATLAS.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include "GatlasBenchmark.hpp"
+
+#include "using_namespace"
+
+using namespace std;
+
+bool parseOpts(int argc, char *argv[], string& outFile, string& fingerprint, vector<string>& journalFiles) {
+    int opt;
+    while ((opt = getopt(argc, argv, "ho:F:")) != -1) {
+        switch (opt) {
+            case ('h') :
+                cerr << "usage: " << argv[0]
+                     << " -o outFile"
+                        " [-F fingerprint] [-h] journalFile..." << endl
+                     << "\t-o merged journal file, existing records are kept" << endl
+                     << "\t-F device fingerprint for records without one (default is to leave them untagged)" << endl
+                     << "\t-h help" << endl;
+                exit(1);
+            case ('o') : outFile = optarg; break;
+            case ('F') : fingerprint = optarg; break;
+        }
+    }
+    for (int i = optind; i < argc; i++)
+        journalFiles.push_back(argv[i]);
+
+    // minimal validation of options
+    bool rc = true;
+    if (outFile.empty()) {
+        cerr << "error: merged journal file must be specified" << endl;
+        rc = false;
+    }
+    if (journalFiles.empty()) {
+        cerr << "error: at least one journal file must be specified" << endl;
+        rc = false;
+    }
+    if (!fingerprint.empty() && DeviceFingerprint(fingerprint).empty()) {
+        cerr << "error: invalid device fingerprint " << fingerprint << endl;
+        rc = false;
+    }
+    return rc;
+}
+
+int main(int argc, char *argv[])
+{
+    string outFile, fingerprint;
+    vector<string> journalFiles;
+
+    if (!parseOpts(argc, argv, outFile, fingerprint, journalFiles))
+        exit(1);
+
+    Journal merged(outFile);
+    merged.loadMemo(); // ok if there is no existing file
+
+    for (size_t i = 0; i < journalFiles.size(); i++) {
+        Journal journal(journalFiles[i]);
+        if (journal.loadMemo()) {
+            merged.mergeMemo(journal, DeviceFingerprint(fingerprint));
+        } else {
+            cerr << "error: could not load journal file " << journalFiles[i] << endl;
+            exit(1);
+        }
+    }
+
+    const int numBadKernels = merged.purgeMemo(false);
+    if (-1 == numBadKernels) {
+        cerr << "error: could not write journal file " << outFile << endl;
+        exit(1);
+    }
+
+    cout << "journal file " << outFile
+         << " has " << numBadKernels << " bad keys" << endl;
+
+    // summary of good keys for each device
+    const vector<DeviceFingerprint> devices = merged.fingerprints();
+    for (size_t i = 0; i < devices.size(); i++) {
+        merged.setFingerprint(devices[i], false);
+        cout << "\t" << devices[i].str() << " has " << merged.memoGood() << " good keys" << endl;
+    }
+
+    return 0;
+}
@@ -49,7 +49,7 @@ bool parseOpts(int argc, char *argv[],
         switch (opt) {
             case ('h') :
                 cerr << "usage: " << argv[0]
-                     << " -T float1|float2|float4|double1|double2|double4|floatimg|doubleimg -m M [-n N]"
+                     << " -T float1|float2|float4|float8|float16|double1|double2|double4|double8|floatimg|doubleimg -m M [-n N]"
                         " [-C numKernels]"
                         " -Y groupHeight -G groupWidth -y blockHeight -g blockWidth -x extraParam"
                         " [-v] [-h]" << endl
@@ -88,9 +88,12 @@ bool parseOpts(int argc, char *argv[],
     if ("float1" == kernelType) { useMembufs = true; useImages = false; useFloat = true; useDouble = false; vectorLength = 1; }
     else if ("float2" == kernelType) { useMembufs = true; useImages = false; useFloat = true; useDouble = false; vectorLength = 2; }
     else if ("float4" == kernelType) { useMembufs = true; useImages = false; useFloat = true; useDouble = false; vectorLength = 4; }
+    else if ("float8" == kernelType) { useMembufs = true; useImages = false; useFloat = true; useDouble = false; vectorLength = 8; }
+    else if ("float16" == kernelType) { useMembufs = true; useImages = false; useFloat = true; useDouble = false; vectorLength = 16; }
     else if ("double1" == kernelType) { useMembufs = true; useImages = false; useFloat = false; useDouble = true; vectorLength = 1; }
     else if ("double2" == kernelType) { useMembufs = true; useImages = false; useFloat = false; useDouble = true; vectorLength = 2; }
     else if ("double4" == kernelType) { useMembufs = true; useImages = false; useFloat = false; useDouble = true; vectorLength = 4; }
+    else if ("double8" == kernelType) { useMembufs = true; useImages = false; useFloat = false; useDouble = true; vectorLength = 8; }
     else if ("floatimg" == kernelType) { useMembufs = false; useImages = true; useFloat = true; useDouble = false; vectorLength = 4; }
     else if ("doubleimg" == kernelType) { useMembufs = false; useImages = true; useFloat = false; useDouble = true; vectorLength = 2; }
     else {
@@ -166,9 +169,12 @@ int main(int argc, char *argv[])
     KernelSaxpyBuffer < float, 1 > kernel_buf_sp_1;
     KernelSaxpyBuffer < float, 2 > kernel_buf_sp_2;
     KernelSaxpyBuffer < float, 4 > kernel_buf_sp_4;
+    KernelSaxpyBuffer < float, 8 > kernel_buf_sp_8;
+    KernelSaxpyBuffer < float, 16 > kernel_buf_sp_16;
     KernelSaxpyBuffer < double, 1 > kernel_buf_dp_1;
     KernelSaxpyBuffer < double, 2 > kernel_buf_dp_2;
     KernelSaxpyBuffer < double, 4 > kernel_buf_dp_4;
+    KernelSaxpyBuffer < double, 8 > kernel_buf_dp_8;
     KernelSaxpyImage < float, 4 > kernel_img_sp_4;
     KernelSaxpyImage < double, 2 > kernel_img_dp_2;
     KernelBaseSaxpy *ptrKernel = NULL;
@@ -177,11 +183,14 @@ int main(int argc, char *argv[])
             if (1 == vectorLength) ptrKernel = &kernel_buf_sp_1;
             if (2 == vectorLength) ptrKernel = &kernel_buf_sp_2;
             if (4 == vectorLength) ptrKernel = &kernel_buf_sp_4;
+            if (8 == vectorLength) ptrKernel = &kernel_buf_sp_8;
+            if (16 == vectorLength) ptrKernel = &kernel_buf_sp_16;
         }
         if (useDouble) {
             if (1 == vectorLength) ptrKernel = &kernel_buf_dp_1;
             if (2 == vectorLength) ptrKernel = &kernel_buf_dp_2;
             if (4 == vectorLength) ptrKernel = &kernel_buf_dp_4;
+            if (8 == vectorLength) ptrKernel = &kernel_buf_dp_8;
         }
     }
     if (useImages) {
@@ -193,6 +202,11 @@ int main(int argc, char *argv[])
     // kernel vector attribute hint?
     kernel.setUseAttrAutoVec(vectorAttributeHint);
 
+    // any extra parameter from a journal may be printed
+    kernel.setSearchBuildOptions(true);
+    kernel.setSearchOptimizeExpr(true);
+    kernel.setSearchGroupSizeAttr(true);
+
     // packed kernel support
     kernel.setPackedCalc(packedKernels);
 
@@ -203,6 +217,10 @@ int main(int argc, char *argv[])
     kernel.setInnerBlocking(blockHeight, blockWidth);
     kernel.setExtraParameter(extraParam);
     if (kernel.validParams()) {
+        // compiler options are not in the kernel source
+        if (! kernel.buildOptions().empty())
+            cout << "// build options: " << kernel.buildOptions() << endl;
+
         // print kernel source
         cout << kernel;
 
@@ -60,7 +60,18 @@ int main(int argc, char *argv[])
     Journal journal(journalFile);
 
     if (journal.loadMemo()) {
-        const size_t numGoodKernels = journal.memoGood();
+        size_t numGoodKernels = journal.memoGood();
+
+        // merged journal has good keys for each device
+        const vector<DeviceFingerprint> devices = journal.fingerprints();
+        if (devices.size() > 1) {
+            numGoodKernels = 0;
+            for (size_t i = 0; i < devices.size(); i++) {
+                journal.setFingerprint(devices[i], false);
+                numGoodKernels += journal.memoGood();
+            }
+        }
+
         const int numBadKernels = journal.purgeMemo(deleteTimes);
         cout << "journal file " << journalFile
              << " has " << numBadKernels << " bad keys, "